@@ -0,0 +1,830 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * @file
+ * Deque torture test
+ *
+ * Runs the deque with more threads than the machine has CPUs and a small
+ * size, so that every slot is reused all the time, in three uses:
+ *
+ * - fifo: pushes at the back, pops from the front;
+ * - lifo: pushes and pops at the back;
+ * - mixed: each call draws its end, and whether it pushes or pops.
+ *
+ * Pushers send sequence-numbered objects, in bulk or burst calls of random
+ * sizes, and poppers check that every object is delivered exactly once and,
+ * in fifo use, that each popper sees the objects of a pusher in increasing
+ * order. A watchdog fails the run when no call completes for a while, which
+ * catches threads waiting for each other's slots.
+ *
+ * A history run then checks linearizability: rounds of a few single-object
+ * calls by each thread on a partly filled deque, each call recorded with its
+ * start and end times, and the deque drained at the end of the round. The
+ * round passes if the calls can be ordered, each one somewhere between its
+ * start and its end, so that a sequential deque gives the same results and
+ * the same final contents.
+ *
+ * Delays can be injected between the reservation of positions and the slot
+ * accesses through rte_ring_preempt_hook (builds with RTE_RING_DEBUG_PREEMPT),
+ * or anywhere with signals.
+ *
+ * Usage: deque_stress [options], see usage(). The exit status is 1 if any
+ * run failed.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+
+#include <my_global.h>
+
+#include <rte_common.h>
+#include "rte_deque.h"
+
+#define MAX_THREADS 64
+#define MAX_BURST 16
+#define SEQ_BITS 40                  /* pusher in the bits above */
+#define MAX_ERRORS 16                /* reported per run */
+#define HIST_THREADS 4               /* threads of a history round */
+#define HIST_CALLS 3                 /* calls per thread and round */
+#define HIST_SIZE 4                  /* deque size of the history rounds */
+#define HIST_OPS (HIST_THREADS * HIST_CALLS)
+#define HIST_MEMO (1u << 14)         /* orders known not to linearize */
+
+/* injected delays */
+enum stress_inject {
+  INJECT_NONE,
+  INJECT_YIELD,            /* sched_yield() after the reservation */
+  INJECT_SIGNAL,           /* signals stalling random threads */
+};
+
+enum stress_use {
+  USE_FIFO,
+  USE_LIFO,
+  USE_MIXED,
+  USE_HISTORY,
+  USE_MAX
+};
+
+static const char * const use_names[USE_MAX] = {
+  "fifo", "lifo", "mixed", "history"
+};
+
+struct stress_config {
+  unsigned int size;
+  unsigned int pushers;
+  unsigned int poppers;
+  unsigned int seconds;
+  uint64_t max_objs;       /* per pusher */
+  unsigned int watchdog;   /* seconds without progress */
+  enum stress_inject inject;
+  unsigned int period;
+  unsigned int delay_us;
+  uint64_t seed;
+  unsigned int uses;       /* bit mask of use_names */
+};
+
+/* what a pusher sent, and what was seen of it */
+struct stress_pusher {
+  volatile uint64_t sent;
+  uint64_t *delivered;     /* bitmap of the sequence numbers */
+};
+
+/* a call of a history round */
+struct stress_call {
+  enum rte_deque_end end;
+  void *obj;               /* pushed, or popped (NULL if none) */
+  unsigned int done;       /* objects pushed or popped */
+  uint64_t start;
+  uint64_t stop;
+};
+
+/* state shared by the threads of one run */
+struct stress_run {
+  const struct stress_config *cfg;
+  struct rte_deque *d;
+  enum stress_use use;
+  volatile unsigned int stop;
+  volatile unsigned int pushers_done;
+  volatile unsigned int finished;
+  volatile unsigned int errors;
+  struct stress_pusher push[MAX_THREADS];
+  /* history rounds */
+  volatile unsigned int round;
+  volatile unsigned int round_done;
+  struct stress_call calls[HIST_OPS];
+};
+
+/* a thread of a run */
+struct stress_thread {
+  struct stress_run *run;
+  unsigned int id;
+  pthread_t tid;
+  uint64_t rng;
+  volatile uint64_t ops;   /* calls completed, for the watchdog */
+};
+
+static unsigned int inject_period;
+static unsigned int inject_delay_us;
+static __thread uint64_t inject_rng;
+static uint64_t tsc_hz;          /* rte_get_tsc_hz() takes 100 ms */
+
+static uint64_t stress_rand(uint64_t *s)
+{
+  *s ^= *s << 13;
+  *s ^= *s >> 7;
+  *s ^= *s << 17;
+  return *s;
+}
+
+#ifdef RTE_RING_DEBUG_PREEMPT
+/* stall about once every period reservations */
+static void stress_preempt_yield(const struct rte_ring_headtail *ht,
+    unsigned int enqueue)
+{
+  (void)ht;
+  (void)enqueue;
+  if (stress_rand(&inject_rng) % inject_period == 0)
+    sched_yield();
+}
+#endif
+
+/* stall the interrupted thread, wherever it was */
+static void stress_preempt_signal(int sig)
+{
+  struct timespec ts;
+
+  (void)sig;
+  ts.tv_sec = inject_delay_us / 1000000;
+  ts.tv_nsec = (inject_delay_us % 1000000) * 1000L;
+  nanosleep(&ts, NULL);
+}
+
+static void *stress_obj(unsigned int p, uint64_t seq)
+{
+  return (void *)(uintptr_t)(((uint64_t)(p + 1) << SEQ_BITS) | seq);
+}
+
+static void stress_error(struct stress_run *run, const char *fmt, ...)
+{
+  va_list ap;
+
+  if (__sync_add_and_fetch(&run->errors, 1) <= MAX_ERRORS) {
+    va_start(ap, fmt);
+    printf("  error: ");
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+  }
+  run->stop = 1;
+}
+
+/* a bit of a pusher bitmap, set atomically; returns its old value */
+static int stress_bit_set(uint64_t *map, uint64_t seq)
+{
+  const uint64_t bit = 1ULL << (seq % 64);
+
+  return (__sync_fetch_and_or(&map[seq / 64], bit) & bit) != 0;
+}
+
+/* the end a call of the run works on */
+static enum rte_deque_end stress_end(struct stress_thread *t, int push)
+{
+  switch (t->run->use) {
+    case USE_FIFO:
+      return push ? RTE_DEQUE_PUSH_BACK : RTE_DEQUE_POP_FRONT;
+    case USE_LIFO:
+      return push ? RTE_DEQUE_PUSH_BACK : RTE_DEQUE_POP_BACK;
+    default:
+      if (stress_rand(&t->rng) % 2)
+        return push ? RTE_DEQUE_PUSH_BACK : RTE_DEQUE_POP_BACK;
+      return push ? RTE_DEQUE_PUSH_FRONT : RTE_DEQUE_POP_FRONT;
+  }
+}
+
+/* push or pop at an end, in a bulk or burst call */
+static unsigned int stress_call(struct stress_thread *t, enum rte_deque_end end,
+    void **objs, unsigned int n)
+{
+  struct rte_deque *d = t->run->d;
+  const int bulk = stress_rand(&t->rng) % 2;
+
+  switch (end) {
+    case RTE_DEQUE_PUSH_BACK:
+      return bulk ? rte_deque_push_back_bulk(d, objs, n, NULL) :
+        rte_deque_push_back_burst(d, objs, n, NULL);
+    case RTE_DEQUE_PUSH_FRONT:
+      return bulk ? rte_deque_push_front_bulk(d, objs, n, NULL) :
+        rte_deque_push_front_burst(d, objs, n, NULL);
+    case RTE_DEQUE_POP_FRONT:
+      return bulk ? rte_deque_pop_front_bulk(d, objs, n, NULL) :
+        rte_deque_pop_front_burst(d, objs, n, NULL);
+    default:
+      return bulk ? rte_deque_pop_back_bulk(d, objs, n, NULL) :
+        rte_deque_pop_back_burst(d, objs, n, NULL);
+  }
+}
+
+static void *stress_pusher(void *arg)
+{
+  struct stress_thread *t = (struct stress_thread *)arg;
+  struct stress_run *run = t->run;
+  struct stress_pusher *push = &run->push[t->id];
+  void *objs[MAX_BURST];
+  uint64_t seq = 0;
+  unsigned int i, n, done;
+
+  inject_rng = t->rng + 1;
+  while (!run->stop && seq < run->cfg->max_objs) {
+    n = 1 + stress_rand(&t->rng) % MAX_BURST;
+    if (n > run->cfg->max_objs - seq)
+      n = (unsigned int)(run->cfg->max_objs - seq);
+    for (i = 0; i < n; i++)
+      objs[i] = stress_obj(t->id, seq + i);
+    done = stress_call(t, stress_end(t, 1), objs, n);
+    seq += done;
+    push->sent = seq;
+    t->ops++;
+    if (done == 0)
+      sched_yield();
+  }
+  __sync_add_and_fetch(&run->pushers_done, 1);
+  __sync_add_and_fetch(&run->finished, 1);
+  return NULL;
+}
+
+/* check the objects a popper got */
+static void stress_check(struct stress_run *run, int64_t *last,
+    void * const *objs, unsigned int n)
+{
+  uintptr_t v;
+  uint64_t seq;
+  unsigned int i, p;
+
+  for (i = 0; i < n; i++) {
+    v = (uintptr_t)objs[i];
+    p = (unsigned int)(v >> SEQ_BITS) - 1;
+    seq = v & ((1ULL << SEQ_BITS) - 1);
+    if (p >= run->cfg->pushers || seq >= run->cfg->max_objs) {
+      stress_error(run, "invalid object from %u, seq %" PRIu64 " (%"
+          PRIx64 ")", p, seq, (uint64_t)v);
+      continue;
+    }
+    if (run->use == USE_FIFO && (int64_t)seq <= last[p])
+      stress_error(run, "pusher %u: seq %" PRIu64 " after %" PRIu64,
+          p, seq, (uint64_t)last[p]);
+    last[p] = (int64_t)seq;
+    if (stress_bit_set(run->push[p].delivered, seq))
+      stress_error(run, "pusher %u: seq %" PRIu64 " delivered twice",
+          p, seq);
+  }
+}
+
+static void *stress_popper(void *arg)
+{
+  struct stress_thread *t = (struct stress_thread *)arg;
+  struct stress_run *run = t->run;
+  int64_t last[MAX_THREADS];
+  void *objs[MAX_BURST];
+  unsigned int i, n, done;
+
+  for (i = 0; i < MAX_THREADS; i++)
+    last[i] = -1;
+
+  inject_rng = t->rng + 1;
+  for (;;) {
+    /* read before popping: the pushers may be done once it is empty */
+    done = run->pushers_done == run->cfg->pushers;
+    n = stress_call(t, stress_end(t, 0), objs,
+        1 + stress_rand(&t->rng) % MAX_BURST);
+    stress_check(run, last, objs, n);
+    t->ops++;
+    if (n == 0) {
+      if (done && rte_deque_count(run->d) == 0)
+        break;
+      if (run->stop && run->errors)
+        break;
+      sched_yield();
+    }
+  }
+  __sync_add_and_fetch(&run->finished, 1);
+  return NULL;
+}
+
+/* check that every object sent was delivered, exactly once */
+static uint64_t stress_check_end(struct stress_run *run)
+{
+  const struct stress_pusher *push;
+  uint64_t w, words, full, d, total = 0;
+  unsigned int p;
+
+  words = (run->cfg->max_objs + 63) / 64;
+  for (p = 0; p < run->cfg->pushers; p++) {
+    push = &run->push[p];
+    total += push->sent;
+    for (w = 0; w < words; w++) {
+      d = push->delivered[w];
+      if (w * 64 + 64 <= push->sent)
+        full = ~0ULL;
+      else if (w * 64 >= push->sent)
+        full = 0;
+      else
+        full = (1ULL << (push->sent % 64)) - 1;
+      if ((d & ~full) != 0)
+        stress_error(run, "pusher %u: seq %" PRIu64 " delivered, only %"
+            PRIu64 " sent", p, w * 64 + __builtin_ctzll(d & ~full),
+            push->sent);
+      if ((d & full) != full)
+        stress_error(run, "pusher %u: seq %" PRIu64 " lost", p,
+            w * 64 + __builtin_ctzll(~d & full));
+    }
+  }
+  if (rte_deque_count(run->d) != 0)
+    stress_error(run, "%u objects left", rte_deque_count(run->d));
+  return total;
+}
+
+/* a sequential deque, the model of the history rounds */
+struct stress_model {
+  void *objs[2 * HIST_SIZE];
+  unsigned int first;
+  unsigned int n;
+};
+
+/* a search state found not to linearize: the calls done and the contents */
+struct stress_memo {
+  unsigned int round;
+  unsigned int done;
+  unsigned int n;
+  void *objs[HIST_SIZE];
+};
+
+static struct stress_memo memo[HIST_MEMO];
+static unsigned int memo_round;
+
+/* look a search state up, or record it if add; returns 1 if it was there */
+static int stress_memo_find(const struct stress_model *m, unsigned int done,
+    int add)
+{
+  struct stress_memo key, *e;
+  uint64_t h = done;
+  unsigned int i;
+
+  memset(&key, 0, sizeof(key));
+  key.round = memo_round;
+  key.done = done;
+  key.n = m->n;
+  for (i = 0; i < m->n; i++) {
+    key.objs[i] = m->objs[(m->first + i) % (2 * HIST_SIZE)];
+    h = (h ^ (uintptr_t)key.objs[i]) * 0x9e3779b97f4a7c15ULL;
+  }
+  e = &memo[(h ^ (h >> 32)) % HIST_MEMO];
+  if (memcmp(e, &key, sizeof(key)) == 0)
+    return 1;
+  if (add)
+    *e = key;
+  return 0;
+}
+
+/* apply a call to the model; returns 0 if it gives the recorded result */
+static int stress_model_call(struct stress_model *m,
+    const struct stress_call *c)
+{
+  const unsigned int cap = HIST_SIZE;
+
+  switch (c->end) {
+    case RTE_DEQUE_PUSH_BACK:
+    case RTE_DEQUE_PUSH_FRONT:
+      if (c->done != (m->n < cap))
+        return -1;
+      if (c->done == 0)
+        return 0;
+      if (c->end == RTE_DEQUE_PUSH_FRONT) {
+        m->first = (m->first + 2 * cap - 1) % (2 * cap);
+        m->objs[m->first] = c->obj;
+      } else {
+        m->objs[(m->first + m->n) % (2 * cap)] = c->obj;
+      }
+      m->n++;
+      return 0;
+    case RTE_DEQUE_POP_FRONT:
+    case RTE_DEQUE_POP_BACK:
+      if (c->done != (m->n > 0))
+        return -1;
+      if (c->done == 0)
+        return 0;
+      if (c->end == RTE_DEQUE_POP_FRONT) {
+        if (m->objs[m->first] != c->obj)
+          return -1;
+        m->first = (m->first + 1) % (2 * cap);
+      } else if (m->objs[(m->first + m->n - 1) % (2 * cap)] != c->obj) {
+        return -1;
+      }
+      m->n--;
+      return 0;
+  }
+  return -1;
+}
+
+/*
+ * Search an order of the calls not in the done mask, each taken among the
+ * ones started before any of the others ended, which the model agrees with
+ * and which leaves it with the drained contents.
+ */
+static int stress_linearize(const struct stress_call *calls,
+    const struct stress_model *m, unsigned int done,
+    void * const *drained, unsigned int nb_drained)
+{
+  struct stress_model next;
+  uint64_t first_stop = UINT64_MAX;
+  unsigned int i;
+
+  if (done == (1u << HIST_OPS) - 1) {
+    if (m->n != nb_drained)
+      return -1;
+    for (i = 0; i < nb_drained; i++)
+      if (m->objs[(m->first + i) % (2 * HIST_SIZE)] != drained[i])
+        return -1;
+    return 0;
+  }
+
+  if (stress_memo_find(m, done, 0))
+    return -1;
+  for (i = 0; i < HIST_OPS; i++)
+    if (!(done & (1u << i)) && calls[i].stop < first_stop)
+      first_stop = calls[i].stop;
+  for (i = 0; i < HIST_OPS; i++) {
+    if ((done & (1u << i)) || calls[i].start > first_stop)
+      continue;
+    next = *m;
+    if (stress_model_call(&next, &calls[i]) == 0 &&
+        stress_linearize(calls, &next, done | (1u << i), drained,
+          nb_drained) == 0)
+      return 0;
+  }
+  stress_memo_find(m, done, 1);
+  return -1;
+}
+
+/* a thread of the history rounds */
+static void *stress_history_thread(void *arg)
+{
+  struct stress_thread *t = (struct stress_thread *)arg;
+  struct stress_run *run = t->run;
+  struct stress_call *c;
+  unsigned int round = 0, k;
+
+  inject_rng = t->rng + 1;
+  for (;;) {
+    while (run->round == round && !run->stop)
+      sched_yield();
+    if (run->stop)
+      break;
+    round = run->round;
+    for (k = 0; k < HIST_CALLS; k++) {
+      c = &run->calls[t->id * HIST_CALLS + k];
+      c->end = (enum rte_deque_end)(stress_rand(&t->rng) % 4);
+      c->obj = stress_obj(t->id, (uint64_t)round * HIST_CALLS + k);
+      c->start = rte_rdtsc();
+      c->done = stress_call(t, c->end, &c->obj, 1);
+      c->stop = rte_rdtsc();
+      if (c->end >= RTE_DEQUE_POP_FRONT && c->done == 0)
+        c->obj = NULL;
+    }
+    t->ops++;
+    __sync_add_and_fetch(&run->round_done, 1);
+  }
+  __sync_add_and_fetch(&run->finished, 1);
+  return NULL;
+}
+
+/* print the calls of a failed round */
+static void stress_history_dump(const struct stress_run *run,
+    const struct stress_model *m, void * const *drained,
+    unsigned int nb_drained)
+{
+  static const char * const end_names[] = {
+    "push_back", "push_front", "pop_front", "pop_back"
+  };
+  const struct stress_call *c;
+  uint64_t base = UINT64_MAX;
+  unsigned int i;
+
+  for (i = 0; i < HIST_OPS; i++)
+    if (run->calls[i].start < base)
+      base = run->calls[i].start;
+  printf("  initial contents:");
+  for (i = 0; i < m->n; i++)
+    printf(" %" PRIx64, (uint64_t)(uintptr_t)m->objs[i]);
+  printf("\n");
+  for (i = 0; i < HIST_OPS; i++) {
+    c = &run->calls[i];
+    printf("  thread %u: %-10s %12" PRIx64 " done %u, cycles %" PRIu64
+        "-%" PRIu64 "\n", i / HIST_CALLS, end_names[c->end],
+        (uint64_t)(uintptr_t)c->obj, c->done, c->start - base,
+        c->stop - base);
+  }
+  printf("  drained:");
+  for (i = 0; i < nb_drained; i++)
+    printf(" %" PRIx64, (uint64_t)(uintptr_t)drained[i]);
+  printf("\n");
+}
+
+/* fail the run when the threads are stuck: there is nothing to join */
+static void stress_deadlock(const struct stress_run *run)
+{
+  const uint64_t ends = run->d->ends;
+
+  printf("  error: no call completed for %u s, front %u back %u, "
+      "busy %x %x\n", run->cfg->watchdog, (uint32_t)ends,
+      (uint32_t)(ends >> 32), run->d->busy[0], run->d->busy[1]);
+  printf("%s: FAIL (deadlock)\n", use_names[run->use]);
+  fflush(stdout);
+  exit(1);
+}
+
+/* play one history round; returns 0 if it is linearizable */
+static int stress_history_round(struct stress_run *run, unsigned int round,
+    uint64_t *rng)
+{
+  const uint64_t start = rte_rdtsc();
+  struct stress_model m;
+  void *drained[HIST_SIZE + 1];
+  void *obj = NULL;
+  unsigned int i, nb_drained;
+
+  /* start from a partly filled deque, wrapped anywhere */
+  memset(&m, 0, sizeof(m));
+  for (i = stress_rand(rng) % HIST_SIZE; i > 0; i--)
+    if (rte_deque_push_back_bulk(run->d, &obj, 1, NULL) != 1 ||
+        rte_deque_pop_front_bulk(run->d, &obj, 1, NULL) != 1)
+      return -1;
+  m.n = stress_rand(rng) % (HIST_SIZE + 1);
+  for (i = 0; i < m.n; i++) {
+    m.objs[i] = stress_obj(MAX_THREADS, (uint64_t)round * HIST_SIZE + i);
+    if (rte_deque_push_back_bulk(run->d, &m.objs[i], 1, NULL) != 1)
+      return -1;
+  }
+
+  run->round_done = 0;
+  run->round = round;
+  while (run->round_done < HIST_THREADS) {
+    if (rte_rdtsc() - start > run->cfg->watchdog * tsc_hz)
+      stress_deadlock(run);
+    sched_yield();
+  }
+
+  nb_drained = 0;
+  while (nb_drained <= HIST_SIZE &&
+      rte_deque_pop_front_burst(run->d, &drained[nb_drained], 1, NULL) == 1)
+    nb_drained++;
+  memo_round = round;
+  if (nb_drained > HIST_SIZE ||
+      stress_linearize(run->calls, &m, 0, drained, nb_drained) != 0) {
+    stress_history_dump(run, &m, drained, nb_drained);
+    return -1;
+  }
+  return 0;
+}
+
+/* the main thread of a run, until the threads end or get stuck */
+static void stress_wait(struct stress_run *run, struct stress_thread *threads,
+    unsigned int nb)
+{
+  struct timespec ts;
+  uint64_t start, now, ops, last_ops = 0, last_move;
+  unsigned int i, tick_us;
+
+  tick_us = run->cfg->inject == INJECT_SIGNAL ? run->cfg->period : 10000;
+  ts.tv_sec = tick_us / 1000000;
+  ts.tv_nsec = (tick_us % 1000000) * 1000L;
+  start = last_move = rte_rdtsc();
+  while (run->finished < nb) {
+    nanosleep(&ts, NULL);
+    if (run->cfg->inject == INJECT_SIGNAL)
+      pthread_kill(threads[rand() % nb].tid, SIGUSR1);
+    now = rte_rdtsc();
+    for (ops = 0, i = 0; i < nb; i++)
+      ops += threads[i].ops;
+    if (ops != last_ops) {
+      last_ops = ops;
+      last_move = now;
+    } else if (now - last_move > run->cfg->watchdog * tsc_hz) {
+      stress_deadlock(run);
+    }
+    if (now - start > run->cfg->seconds * tsc_hz)
+      run->stop = 1;
+  }
+}
+
+/* run a use, return 0 if it passed */
+static int stress_run_one(const struct stress_config *cfg,
+    enum stress_use use)
+{
+  static struct stress_thread threads[2 * MAX_THREADS];
+  static struct stress_run run;
+  uint64_t words, total = 0, start, end, rng;
+  unsigned int nb, i, round = 0, failed = 0;
+
+  memset(&run, 0, sizeof(run));
+  run.cfg = cfg;
+  run.use = use;
+  run.d = rte_deque_create(use == USE_HISTORY ? HIST_SIZE : cfg->size, 0);
+  if (run.d == NULL)
+    return -1;
+
+  if (use == USE_HISTORY) {
+    nb = HIST_THREADS;
+  } else {
+    nb = cfg->pushers + cfg->poppers;
+    words = (cfg->max_objs + 63) / 64;
+    for (i = 0; i < cfg->pushers; i++) {
+      run.push[i].delivered = (uint64_t *)calloc(words, sizeof(uint64_t));
+      if (run.push[i].delivered == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+      }
+    }
+  }
+
+  start = rte_rdtsc();
+  for (i = 0; i < nb; i++) {
+    threads[i].run = &run;
+    threads[i].id = use == USE_HISTORY || i < cfg->pushers ? i :
+      i - cfg->pushers;
+    threads[i].ops = 0;
+    threads[i].rng = (cfg->seed + 1) * 0x9e3779b97f4a7c15ULL ^
+      ((uint64_t)use << 32) ^ (i + 1);
+    if (pthread_create(&threads[i].tid, NULL, use == USE_HISTORY ?
+          stress_history_thread : i < cfg->pushers ? stress_pusher :
+          stress_popper, &threads[i]) != 0) {
+      fprintf(stderr, "Cannot create thread %u\n", i);
+      exit(1);
+    }
+  }
+
+  if (use == USE_HISTORY) {
+    /* the rounds, each one failing the run if it does not end in time */
+    rng = (cfg->seed + 1) * 0x9e3779b97f4a7c15ULL;
+    while (!run.stop && rte_rdtsc() - start <
+        cfg->seconds * tsc_hz) {
+      if (stress_history_round(&run, ++round, &rng) != 0) {
+        stress_error(&run, "round %u is not linearizable", round);
+        failed++;
+      }
+      total += HIST_OPS;
+    }
+    run.stop = 1;
+  } else {
+    stress_wait(&run, threads, nb);
+  }
+  for (i = 0; i < nb; i++)
+    pthread_join(threads[i].tid, NULL);
+  end = rte_rdtsc();
+
+  if (use != USE_HISTORY) {
+    total = stress_check_end(&run);
+    for (i = 0; i < cfg->pushers; i++)
+      free(run.push[i].delivered);
+  }
+  printf("%-8s %5u %5u %6u %14" PRIu64 " %10.2f  %s\n", use_names[use],
+      use == USE_HISTORY ? HIST_THREADS : cfg->pushers,
+      use == USE_HISTORY ? HIST_THREADS : cfg->poppers,
+      rte_deque_get_capacity(run.d), total,
+      total / ((double)(end - start) / tsc_hz) / 1e6,
+      run.errors ? "FAIL" : "ok");
+  fflush(stdout);
+  rte_deque_free(run.d);
+  return run.errors || failed ? -1 : 0;
+}
+
+/* parse a comma separated list of names into a bit mask */
+static int parse_names(const char *list, const char * const *names,
+    unsigned int nb, unsigned int *mask)
+{
+  const char *end;
+  unsigned int i;
+  size_t len;
+
+  *mask = 0;
+  while (*list != '\0') {
+    end = strchr(list, ',');
+    len = end != NULL ? (size_t)(end - list) : strlen(list);
+    for (i = 0; i < nb; i++)
+      if (strlen(names[i]) == len && strncmp(names[i], list, len) == 0)
+        break;
+    if (i == nb)
+      return -1;
+    *mask |= 1u << i;
+    list += len + (end != NULL);
+  }
+  return *mask ? 0 : -1;
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+      "Usage: %s [-s size] [-p pushers] [-c poppers] [-t seconds] "
+      "[-n objects] [-w seconds] [-u uses] [-i inject] [-f period] "
+      "[-d delay] [-S seed]\n"
+      "  -s  deque size, a power of 2 (default 16, small to wrap often)\n"
+      "  -p  pusher threads (default 8, max %d)\n"
+      "  -c  popper threads (default 8, max %d)\n"
+      "  -t  seconds per run (default 10)\n"
+      "  -n  objects per pusher at most (default 16777216)\n"
+      "  -w  seconds without any call completing to report a deadlock\n"
+      "      (default 5)\n"
+      "  -u  uses among fifo,lifo,mixed,history (default all)\n"
+      "  -i  delays injected: none, yield (after the reservation, needs\n"
+      "      RTE_RING_DEBUG_PREEMPT), or signal (default none)\n"
+      "  -f  yield about every this many reservations (default 64), or\n"
+      "      signal a random thread every this many microseconds (1000)\n"
+      "  -d  microseconds of a signal stall (default 50)\n"
+      "  -S  random seed (default 1)\n",
+      prog, MAX_THREADS, MAX_THREADS);
+}
+
+int main(int argc, char **argv)
+{
+  struct stress_config cfg = { 16, 8, 8, 10, 1ULL << 24, 5, INJECT_NONE, 0,
+    50, 1, (1u << USE_MAX) - 1 };
+  unsigned int u, failed = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:p:c:t:n:w:u:i:f:d:S:h")) != -1) {
+    switch (opt) {
+      case 's': cfg.size = atoi(optarg); break;
+      case 'p': cfg.pushers = atoi(optarg); break;
+      case 'c': cfg.poppers = atoi(optarg); break;
+      case 't': cfg.seconds = atoi(optarg); break;
+      case 'n': cfg.max_objs = strtoull(optarg, NULL, 0); break;
+      case 'w': cfg.watchdog = atoi(optarg); break;
+      case 'u':
+        if (parse_names(optarg, use_names, USE_MAX, &cfg.uses) != 0) {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'i':
+        if (strcmp(optarg, "yield") == 0)
+          cfg.inject = INJECT_YIELD;
+        else if (strcmp(optarg, "signal") == 0)
+          cfg.inject = INJECT_SIGNAL;
+        else if (strcmp(optarg, "none") == 0)
+          cfg.inject = INJECT_NONE;
+        else {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'f': cfg.period = atoi(optarg); break;
+      case 'd': cfg.delay_us = atoi(optarg); break;
+      case 'S': cfg.seed = strtoull(optarg, NULL, 0); break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (!POWEROF2(cfg.size) || cfg.size < 4 || cfg.pushers == 0 ||
+      cfg.pushers > MAX_THREADS || cfg.poppers == 0 ||
+      cfg.poppers > MAX_THREADS || cfg.max_objs == 0 ||
+      cfg.max_objs >= 1ULL << SEQ_BITS || cfg.watchdog == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+#ifdef RTE_RING_DEBUG_PREEMPT
+  if (cfg.inject == INJECT_YIELD)
+    rte_ring_preempt_hook = stress_preempt_yield;
+#else
+  if (cfg.inject == INJECT_YIELD) {
+    fprintf(stderr, "-i yield needs a build with RTE_RING_DEBUG_PREEMPT\n");
+    return 1;
+  }
+#endif
+  if (cfg.period == 0)
+    cfg.period = cfg.inject == INJECT_SIGNAL ? 1000 : 64;
+  inject_period = cfg.period;
+  inject_delay_us = cfg.delay_us;
+  if (cfg.inject == INJECT_SIGNAL)
+    signal(SIGUSR1, stress_preempt_signal);
+  srand((unsigned int)cfg.seed);
+  tsc_hz = rte_get_tsc_hz();
+
+  printf("%-8s %5s %5s %6s %14s %10s  %s\n", "use", "push", "pop", "cap",
+      "objects", "Mobjs/s", "result");
+  for (u = 0; u < USE_MAX; u++)
+    if ((cfg.uses & (1u << u)) &&
+        stress_run_one(&cfg, (enum stress_use)u) != 0)
+      failed++;
+
+  printf("%u run%s failed\n", failed, failed == 1 ? "" : "s");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,1616 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * @file
+ * Ring performance benchmark
+ *
+ * Measures the cost per object of moving objects through a queue with a
+ * given number of producer and consumer threads. Each producer enqueues
+ * *ops* objects in bursts, consumers dequeue until every object has been
+ * seen, and the result is the elapsed TSC cycles divided by the number of
+ * objects. Each scenario is run *repeat* times.
+ *
+ * By default, one scenario is run with the given number of producers and
+ * consumers, comparing the ring with back-only use of the two-lock deque,
+ * whose producers and consumers each take turns, and with a single
+ * consumer, the MPSC list. All three are driven through the overloads of
+ * rte_queue.h. A last row dequeues from the ring with
+ * rte_ring_dequeue_burst_classify_u32() into PERF_CLASSIFY_BINS bins, the
+ * keys of the objects being in cache, to give the cost of classifying
+ * against the plain ring row. With -T, the CPU topology
+ * is read from /sys/devices/system/cpu and SPSC, MPSC and MPMC rings are
+ * swept over thread counts for each placement class:
+ *
+ * - smt:    hardware threads of one physical core
+ * - l3:     distinct physical cores sharing an L3 cache
+ * - socket: physical cores alternating between two packages
+ *
+ * With -O, every sync mode is run with more threads than lcores, to see how
+ * the modes hold up when a thread loses its CPU between moving a head and
+ * publishing the tail, as on overcommitted VMs. Busy filler threads stand in
+ * for the threads a single producer or consumer side does not have.
+ * Preemption can be injected there with sched_yield() (builds with
+ * RTE_RING_DEBUG_PREEMPT), or at any point with signals that stall a random
+ * thread. These runs also report the longest time a thread went without
+ * completing a burst.
+ *
+ * With -e, each thread counts hardware events around its part of the run
+ * with perf_event_open(): cycles, instructions, L1D and LLC misses, and a
+ * raw HITM event given with -H (model specific, e.g. 0x04d2 for
+ * MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM on Skylake). The sums over all threads
+ * are reported per object. Events the kernel or the user cannot count, as
+ * with a high perf_event_paranoid or in a VM without a PMU, are reported as
+ * unavailable and the run goes on without them.
+ *
+ * With -R, the traffic recorded on a production ring by rte_ring_record.h
+ * is replayed on a ring of every sync mode, with the recorded capacity or
+ * the one given with -s: one thread issues the recorded enqueue bursts at
+ * the recorded times, another the dequeue bursts. The replay reports the
+ * objects dropped on a full ring, how late the threads fell behind the
+ * recording, and the sojourn times of the objects (RING_F_SOJOURN).
+ *
+ * With -L, rings of every sync mode are fed open-loop traffic from
+ * rte_ring_loadgen.h for -D milliseconds: producers enqueue bursts at the
+ * times the arrival process gives and drop what does not fit, consumers
+ * spin for the service time of what they dequeue. Each traffic pattern
+ * reports offered and served throughput, drops and latency percentiles.
+ *
+ * Builds with RTE_RING_PROFILE print the contention profile of the ring
+ * after each ring scenario, see rte_ring_profile.h.
+ *
+ * Threads otherwise run on the pinned lcores of rte_lcore.h. Results are
+ * printed as a table, and can be written as CSV (one row per scenario, for
+ * charts) and as JSON (all samples, for app/ring_perf_compare.py).
+ *
+ * Usage: ring_perf [options], see usage().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <my_global.h>
+
+#include <rte_common.h>
+#include "rte_ring.h"
+#include "rte_queue.h"
+#include "rte_lcore.h"
+#include "rte_ring_record.h"
+#include "rte_ring_loadgen.h"
+
+#define MAX_BURST 256
+#define MAX_THREADS RTE_MAX_LCORE
+#define MAX_REPEAT 64
+#define MAX_RESULTS 1024
+#define MAX_OVERSUB_THREADS 1024
+#define MAX_LOADS 16
+#define PERF_CLASSIFY_BINS 8
+
+/* preemption injected in oversubscribed runs */
+enum perf_inject {
+  INJECT_NONE,
+  INJECT_YIELD,           /**< sched_yield() between head and tail moves */
+  INJECT_SIGNAL,          /**< signals stalling random threads */
+};
+
+/* hardware events counted with -e */
+enum perf_event_id {
+  PERF_EV_CYCLES,
+  PERF_EV_INSTRUCTIONS,
+  PERF_EV_L1D_MISSES,
+  PERF_EV_LLC_MISSES,
+  PERF_EV_HITM,
+  PERF_EV_MAX
+};
+
+static const char * const perf_event_names[PERF_EV_MAX] = {
+  "cycles", "instructions", "l1d-misses", "llc-misses", "hitm"
+};
+
+/* the counters of one thread */
+struct perf_counters {
+  int fd[PERF_EV_MAX];
+};
+
+/* a queue under test, behind enqueue/dequeue burst callbacks */
+struct perf_queue {
+  const char *name;
+  void *q;
+  unsigned int (*enqueue)(void *q, void * const *objs, unsigned int n);
+  unsigned int (*dequeue)(void *q, void **objs, unsigned int n);
+};
+
+struct perf_config {
+  unsigned int size;
+  unsigned int burst;
+  unsigned long ops;
+  unsigned int producers;
+  unsigned int consumers;
+  unsigned int repeat;
+  int topology;
+  int counters;
+  unsigned long long hitm_config;
+  int oversub;
+  enum perf_inject inject;
+  unsigned int period;
+  unsigned int delay_us;
+  const char *cpus;
+  const char *csv_path;
+  const char *json_path;
+  const char *replay_path;
+  unsigned int nb_loads;
+  const char *loads[MAX_LOADS];
+  unsigned int duration_ms;
+};
+
+/* state shared by the threads of one run */
+struct perf_run {
+  const struct perf_config *cfg;
+  const struct perf_queue *queue;
+  unsigned int producers;
+  unsigned int consumers;
+  volatile unsigned int ready;
+  volatile unsigned int go;
+  int track_stall;
+  volatile unsigned long consumed __rte_cache_aligned;
+  uint64_t start __rte_cache_aligned;
+  uint64_t end;
+  volatile uint64_t max_stall;
+  volatile uint64_t events[PERF_EV_MAX];
+  volatile unsigned int finished;
+  volatile unsigned int release;
+};
+
+/* state shared by the two threads of a replay */
+struct perf_replay {
+  const struct rte_ring_recording *rec;
+  struct rte_ring *r;
+  double scale;            /* local TSC cycles per recorded cycle */
+  void **objs[2];          /* per side, room for the largest burst */
+  volatile unsigned int ready;
+  volatile unsigned int go;
+  uint64_t start;
+  uint64_t lag[2];         /* longest lag behind the recording, per side */
+  uint64_t moved[2];       /* objects enqueued, dequeued */
+  uint64_t dropped;        /* objects not enqueued on a full ring */
+};
+
+/* state shared by the threads of a run under generated load */
+struct perf_load {
+  const struct perf_config *cfg;
+  const struct rte_ring_loadgen_config *traffic;
+  struct rte_ring *r;
+  unsigned int producers;
+  unsigned int consumers;
+  volatile unsigned int ready;
+  volatile unsigned int go;
+  volatile unsigned int seed;
+  volatile unsigned int producers_done;
+  uint64_t start;
+  pthread_mutex_t lock;    /* protects stats */
+  struct rte_ring_loadgen_stats stats;
+};
+
+/* a thread of an oversubscribed run */
+struct perf_thread {
+  struct perf_run *run;
+  lcore_function_t *role;
+  pthread_t tid;
+};
+
+/* the samples of one scenario */
+struct perf_result {
+  char queue[16];
+  char mode[16];
+  char placement[16];
+  unsigned int producers;
+  unsigned int consumers;
+  unsigned int nb_samples;
+  double samples[MAX_REPEAT];
+  int has_stall;
+  uint64_t max_stall;      /* longest time without progress, in cycles */
+  double events[PERF_EV_MAX];   /* per object, over all the samples */
+};
+
+static struct perf_result results[MAX_RESULTS];
+static unsigned int nb_results;
+static uint64_t tsc_hz;
+/* the objects of perf_producer(): the keys of the classify scenario */
+static uint32_t perf_keys[MAX_BURST];
+
+/* events that could be counted, probed once by perf_counters_probe() */
+static int perf_event_ok[PERF_EV_MAX];
+static unsigned int perf_nb_events;
+static struct perf_event_attr perf_event_attrs[PERF_EV_MAX];
+
+static unsigned int inject_period;
+static unsigned int inject_delay_us;
+
+#ifdef RTE_RING_DEBUG_PREEMPT
+static __thread unsigned int inject_calls;
+
+/* give up the CPU between a head move and the tail update */
+static void perf_preempt_yield(const struct rte_ring_headtail *ht,
+    unsigned int enqueue)
+{
+  (void)ht;
+  (void)enqueue;
+  if (++inject_calls % inject_period == 0)
+    sched_yield();
+}
+#endif
+
+/* stall the interrupted thread, wherever it was in its enqueue or dequeue */
+static void perf_preempt_signal(int sig)
+{
+  struct timespec ts;
+
+  (void)sig;
+  ts.tv_sec = inject_delay_us / 1000000;
+  ts.tv_nsec = (inject_delay_us % 1000000) * 1000L;
+  nanosleep(&ts, NULL);
+}
+
+/* perf_queue callbacks of the queues of rte_queue.h */
+template <typename Q>
+static unsigned int queue_enqueue(void *q, void * const *objs, unsigned int n)
+{
+  return rte_queue_enqueue_burst((Q *)q, objs, n, NULL);
+}
+
+template <typename Q>
+static unsigned int queue_dequeue(void *q, void **objs, unsigned int n)
+{
+  return rte_queue_dequeue_burst((Q *)q, objs, n, NULL);
+}
+
+/* classify by the key of the objects, the first bin being the objects
+ * returned, so that the consumer counts every object once */
+static unsigned int classify_dequeue(void *q, void **objs, unsigned int n)
+{
+  void *bin_objs[PERF_CLASSIFY_BINS - 1][MAX_BURST];
+  void **bins[PERF_CLASSIFY_BINS];
+  unsigned int counts[PERF_CLASSIFY_BINS];
+  unsigned int i;
+
+  bins[0] = objs;
+  for (i = 1; i < PERF_CLASSIFY_BINS; i++)
+    bins[i] = bin_objs[i - 1];
+  memset(counts, 0, sizeof(counts));
+  return rte_ring_dequeue_burst_classify_u32((struct rte_ring *)q, n, 0,
+      bins, PERF_CLASSIFY_BINS, counts, NULL);
+}
+
+/*
+ * The MPSC list links the objects it holds, so the objects of the benchmark
+ * travel in nodes, taken from a ring of as many free nodes as the size of
+ * the other queues and given back by the consumer. The objects in flight
+ * are bounded as in those queues, and the cost per object includes taking
+ * and giving back a node.
+ */
+struct perf_mpsc_node {
+  struct rte_mpsc_node link;
+  void *obj;
+};
+
+struct perf_mpsc {
+  struct rte_mpsc q;
+  struct rte_ring *free;
+  struct perf_mpsc_node *nodes;
+};
+
+static unsigned int mpsc_enqueue(void *q, void * const *objs, unsigned int n)
+{
+  struct perf_mpsc *m = (struct perf_mpsc *)q;
+  void *nodes[MAX_BURST];
+  unsigned int i;
+
+  n = rte_ring_mc_dequeue_burst(m->free, nodes, n, NULL);
+  for (i = 0; i < n; i++)
+    ((struct perf_mpsc_node *)nodes[i])->obj = objs[i];
+  return queue_enqueue<struct rte_mpsc>(&m->q, nodes, n);
+}
+
+static unsigned int mpsc_dequeue(void *q, void **objs, unsigned int n)
+{
+  struct perf_mpsc *m = (struct perf_mpsc *)q;
+  void *nodes[MAX_BURST];
+  unsigned int i;
+
+  n = queue_dequeue<struct rte_mpsc>(&m->q, nodes, n);
+  for (i = 0; i < n; i++)
+    objs[i] = ((struct perf_mpsc_node *)nodes[i])->obj;
+  /* cannot fail: the ring holds every node */
+  rte_ring_sp_enqueue_bulk(m->free, nodes, n, NULL);
+  return n;
+}
+
+static int perf_event_open(struct perf_event_attr *attr)
+{
+  /* the calling thread, on any CPU */
+  return (int)syscall(__NR_perf_event_open, attr, 0, -1, -1, 0);
+}
+
+/* set up the event attributes and keep the ones this thread can count */
+static void perf_counters_probe(const struct perf_config *cfg)
+{
+  struct perf_event_attr *attr;
+  unsigned int i;
+  int fd, err = 0;
+
+  for (i = 0; i < PERF_EV_MAX; i++) {
+    attr = &perf_event_attrs[i];
+    memset(attr, 0, sizeof(*attr));
+    attr->size = sizeof(*attr);
+    attr->disabled = 1;
+    attr->exclude_kernel = 1;
+    attr->exclude_hv = 1;
+    attr->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+      PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr->type = PERF_TYPE_HARDWARE;
+    switch (i) {
+      case PERF_EV_CYCLES:
+        attr->config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+      case PERF_EV_INSTRUCTIONS:
+        attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+      case PERF_EV_L1D_MISSES:
+        attr->type = PERF_TYPE_HW_CACHE;
+        attr->config = PERF_COUNT_HW_CACHE_L1D |
+          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+      case PERF_EV_LLC_MISSES:
+        attr->config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+      case PERF_EV_HITM:
+        if (cfg->hitm_config == 0)
+          continue;
+        attr->type = PERF_TYPE_RAW;
+        attr->config = cfg->hitm_config;
+        break;
+    }
+    fd = perf_event_open(attr);
+    if (fd < 0) {
+      err = errno;
+      continue;
+    }
+    close(fd);
+    perf_event_ok[i] = 1;
+    perf_nb_events++;
+  }
+
+  if (err != 0) {
+    /* EACCES: perf_event_paranoid, ENOENT: no PMU or unknown event */
+    fprintf(stderr, "# hardware events not counted (%s):", strerror(err));
+    for (i = 0; i < PERF_EV_MAX; i++)
+      if (!perf_event_ok[i])
+        fprintf(stderr, " %s", perf_event_names[i]);
+    fprintf(stderr, "\n");
+  }
+}
+
+/* open the probed counters for the calling thread, disabled */
+static void perf_counters_open(struct perf_counters *pc)
+{
+  unsigned int i;
+
+  for (i = 0; i < PERF_EV_MAX; i++)
+    pc->fd[i] = perf_event_ok[i] ? perf_event_open(&perf_event_attrs[i]) :
+      -1;
+}
+
+static void perf_counters_start(struct perf_counters *pc)
+{
+  unsigned int i;
+
+  for (i = 0; i < PERF_EV_MAX; i++)
+    if (pc->fd[i] >= 0) {
+      ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+/* stop the counters, add them to the run and close them */
+static void perf_counters_stop(struct perf_counters *pc, struct perf_run *run)
+{
+  uint64_t v[3];          /* value, time enabled, time running */
+  unsigned int i;
+
+  for (i = 0; i < PERF_EV_MAX; i++)
+    if (pc->fd[i] >= 0)
+      ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+  for (i = 0; i < PERF_EV_MAX; i++) {
+    if (pc->fd[i] < 0)
+      continue;
+    /* scale the counts of multiplexed events to the whole run */
+    if (read(pc->fd[i], v, sizeof(v)) == (ssize_t)sizeof(v) && v[2] != 0)
+      __sync_add_and_fetch(&run->events[i],
+          (uint64_t)((double)v[0] * v[1] / v[2]));
+    close(pc->fd[i]);
+  }
+}
+
+/* wait until all the threads of the run are ready, then take the start TSC */
+static void perf_barrier(struct perf_run *run)
+{
+  const unsigned int nb = run->producers + run->consumers;
+
+  if (__sync_add_and_fetch(&run->ready, 1) == nb) {
+    run->start = rte_rdtsc();
+    run->go = 1;
+  }
+  /* oversubscribed threads give their CPU to the ones not there yet */
+  while (!run->go) {
+    if (run->track_stall)
+      sched_yield();
+    else
+      rte_pause();
+  }
+}
+
+/* fold the longest stall seen by a thread into the run */
+static void perf_stall_update(struct perf_run *run, uint64_t stall)
+{
+  uint64_t cur = run->max_stall;
+
+  while (stall > cur && !__sync_bool_compare_and_swap(&run->max_stall, cur,
+        stall))
+    cur = run->max_stall;
+}
+
+static int perf_producer(void *arg)
+{
+  struct perf_run *run = (struct perf_run *)arg;
+  const struct perf_queue *queue = run->queue;
+  void *objs[MAX_BURST];
+  unsigned long left = run->cfg->ops;
+  uint64_t t0 = 0, t1, stall = 0;
+  struct perf_counters pc;
+  unsigned int i, n, done;
+
+  for (i = 0; i < MAX_BURST; i++)
+    objs[i] = &perf_keys[i];
+
+  if (run->cfg->counters)
+    perf_counters_open(&pc);
+  perf_barrier(run);
+  if (run->cfg->counters)
+    perf_counters_start(&pc);
+  while (left > 0) {
+    n = left < run->cfg->burst ? (unsigned int)left : run->cfg->burst;
+    if (run->track_stall)
+      t0 = rte_rdtsc();
+    for (done = 0; done < n;) {
+      done += queue->enqueue(queue->q, objs + done, n - done);
+      if (done < n)
+        rte_pause();
+    }
+    if (run->track_stall) {
+      t1 = rte_rdtsc();
+      if (t1 - t0 > stall)
+        stall = t1 - t0;
+    }
+    left -= n;
+  }
+  if (run->cfg->counters)
+    perf_counters_stop(&pc, run);
+  perf_stall_update(run, stall);
+  return 0;
+}
+
+static int perf_consumer(void *arg)
+{
+  struct perf_run *run = (struct perf_run *)arg;
+  const struct perf_queue *queue = run->queue;
+  const unsigned long total = run->cfg->ops * run->producers;
+  void *objs[MAX_BURST];
+  uint64_t last = 0, now, stall = 0;
+  struct perf_counters pc;
+  unsigned int n;
+
+  if (run->cfg->counters)
+    perf_counters_open(&pc);
+  perf_barrier(run);
+  if (run->cfg->counters)
+    perf_counters_start(&pc);
+  if (run->track_stall)
+    last = rte_rdtsc();
+  while (run->consumed < total) {
+    n = queue->dequeue(queue->q, objs, run->cfg->burst);
+    if (n == 0) {
+      rte_pause();
+      continue;
+    }
+    if (run->track_stall) {
+      now = rte_rdtsc();
+      if (now - last > stall)
+        stall = now - last;
+      last = now;
+    }
+    if (__sync_add_and_fetch(&run->consumed, n) == total)
+      run->end = rte_rdtsc();
+  }
+  if (run->cfg->counters)
+    perf_counters_stop(&pc, run);
+  perf_stall_update(run, stall);
+  return 0;
+}
+
+/* keep a CPU busy until the ring threads are done, see perf_run_threads() */
+static int perf_filler(void *arg)
+{
+  struct perf_run *run = (struct perf_run *)arg;
+
+  while (run->finished < run->producers + run->consumers)
+    rte_pause();
+  return 0;
+}
+
+/* keep the thread alive until the signals stop, see perf_run_threads() */
+static void *perf_thread_main(void *arg)
+{
+  struct perf_thread *t = (struct perf_thread *)arg;
+
+  t->role(t->run);
+  __sync_add_and_fetch(&t->run->finished, 1);
+  while (!t->run->release)
+    sched_yield();
+  return NULL;
+}
+
+/*
+ * Run more threads than lcores: thread i is pinned on the CPU of lcore
+ * i modulo the lcore count. Modes with a single side run fewer ring
+ * threads than mpmc, so busy filler threads bring every mode to the same
+ * count, -p plus -c and at least one more than the lcores, and the ring
+ * threads share their CPUs in every mode. With INJECT_SIGNAL, the calling
+ * thread then signals a random ring thread every period microseconds until
+ * all are done.
+ */
+static int perf_run_threads(const struct perf_config *cfg,
+    struct perf_run *run)
+{
+  static struct perf_thread threads[MAX_OVERSUB_THREADS];
+  const unsigned int nb = run->producers + run->consumers;
+  pthread_attr_t attr;
+  cpu_set_t cpus;
+  struct timespec ts;
+  unsigned int i, total;
+
+  total = cfg->producers + cfg->consumers;
+  if (total <= rte_lcore_count())
+    total = rte_lcore_count() + 1;
+  if (total > MAX_OVERSUB_THREADS)
+    total = MAX_OVERSUB_THREADS;
+  if (total < nb)
+    total = nb;
+
+  for (i = 0; i < total; i++) {
+    threads[i].run = run;
+    threads[i].role = i < run->producers ? perf_producer :
+      i < nb ? perf_consumer : perf_filler;
+    CPU_ZERO(&cpus);
+    CPU_SET(rte_lcore_to_cpu_id(i % rte_lcore_count()), &cpus);
+    pthread_attr_init(&attr);
+    pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    if (pthread_create(&threads[i].tid, &attr, perf_thread_main,
+          &threads[i]) != 0) {
+      fprintf(stderr, "Cannot create thread %u\n", i);
+      exit(1);
+    }
+    pthread_attr_destroy(&attr);
+  }
+
+  ts.tv_sec = cfg->period / 1000000;
+  ts.tv_nsec = (cfg->period % 1000000) * 1000L;
+  while (run->finished < total) {
+    if (cfg->inject == INJECT_SIGNAL) {
+      nanosleep(&ts, NULL);
+      pthread_kill(threads[rand() % nb].tid, SIGUSR1);
+    } else {
+      sched_yield();
+    }
+  }
+
+  run->release = 1;
+  for (i = 0; i < total; i++)
+    pthread_join(threads[i].tid, NULL);
+  return 0;
+}
+
+/*
+ * Run the producers then the consumers on the given lcores and add the
+ * cycles spent per object as a sample of the result. The main lcore may be
+ * one of them: its role runs once the others are launched. Without lcores,
+ * the run is oversubscribed, see perf_run_threads().
+ */
+static void perf_run_queue(const struct perf_config *cfg,
+    const struct perf_queue *queue, const unsigned int *lcores,
+    struct perf_result *res)
+{
+  const double objs = (double)cfg->ops * res->producers * cfg->repeat;
+  struct perf_run run;
+  lcore_function_t *main_role = NULL;
+  lcore_function_t *role;
+  unsigned int i;
+
+  memset(&run, 0, sizeof(run));
+  run.cfg = cfg;
+  run.queue = queue;
+  run.producers = res->producers;
+  run.consumers = res->consumers;
+
+  if (lcores == NULL) {
+    run.track_stall = 1;
+    perf_run_threads(cfg, &run);
+  } else {
+    for (i = 0; i < run.producers + run.consumers; i++) {
+      role = i < run.producers ? perf_producer : perf_consumer;
+      if (lcores[i] == rte_get_main_lcore())
+        main_role = role;
+      else
+        rte_eal_remote_launch(role, &run, lcores[i]);
+    }
+    if (main_role != NULL)
+      main_role(&run);
+    for (i = 0; i < run.producers + run.consumers; i++)
+      rte_eal_wait_lcore(lcores[i]);
+  }
+
+  res->samples[res->nb_samples++] = (double)(run.end - run.start) /
+    (cfg->ops * run.producers);
+  if (run.max_stall > res->max_stall)
+    res->max_stall = run.max_stall;
+  /* events per object, averaged over the repeated runs */
+  for (i = 0; i < PERF_EV_MAX; i++)
+    res->events[i] += run.events[i] / objs;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+  const double x = *(const double *)a, y = *(const double *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static double perf_median(const struct perf_result *res)
+{
+  double sorted[MAX_REPEAT];
+
+  memcpy(sorted, res->samples, res->nb_samples * sizeof(double));
+  qsort(sorted, res->nb_samples, sizeof(double), cmp_double);
+  if (res->nb_samples % 2)
+    return sorted[res->nb_samples / 2];
+  return (sorted[res->nb_samples / 2 - 1] + sorted[res->nb_samples / 2]) / 2;
+}
+
+/* run a scenario cfg->repeat times and record it */
+static void perf_scenario(const struct perf_config *cfg,
+    const struct perf_queue *queue, const char *mode, const char *placement,
+    unsigned int producers, unsigned int consumers,
+    const unsigned int *lcores)
+{
+  struct perf_result *res;
+  char stall_us[32];
+  double median;
+  unsigned int i;
+
+  if (nb_results == MAX_RESULTS)
+    return;
+  res = &results[nb_results++];
+  snprintf(res->queue, sizeof(res->queue), "%s", queue->name);
+  snprintf(res->mode, sizeof(res->mode), "%s", mode);
+  snprintf(res->placement, sizeof(res->placement), "%s", placement);
+  res->producers = producers;
+  res->consumers = consumers;
+  res->has_stall = lcores == NULL;
+
+  for (i = 0; i < cfg->repeat; i++)
+    perf_run_queue(cfg, queue, lcores, res);
+
+  median = perf_median(res);
+  if (res->has_stall)
+    snprintf(stall_us, sizeof(stall_us), "%.1f",
+        res->max_stall * 1e6 / tsc_hz);
+  else
+    snprintf(stall_us, sizeof(stall_us), "-");
+  printf("%-11s %-5s %-9s %5u %5u %14.2f %12.2f %12s\n", res->queue,
+      res->mode, res->placement, producers, consumers, median,
+      median > 0 ? tsc_hz / median / 1e6 : 0.0, stall_us);
+  if (perf_nb_events > 0) {
+    printf("%28s", "per object:");
+    for (i = 0; i < PERF_EV_MAX; i++)
+      if (perf_event_ok[i])
+        printf(" %s %.2f", perf_event_names[i], res->events[i]);
+    if (perf_event_ok[PERF_EV_CYCLES] && perf_event_ok[PERF_EV_INSTRUCTIONS] &&
+        res->events[PERF_EV_CYCLES] > 0)
+      printf(" ipc %.2f", res->events[PERF_EV_INSTRUCTIONS] /
+          res->events[PERF_EV_CYCLES]);
+    printf("\n");
+  }
+  fflush(stdout);
+}
+
+/* the flags of a ring in the given sync mode, "spsc" to "mpmc" */
+static unsigned int perf_ring_flags(const char *mode)
+{
+  unsigned int flags = 0;
+
+  if (mode[0] == 's')
+    flags |= RING_F_SP_ENQ;
+  if (mode[2] == 's')
+    flags |= RING_F_SC_DEQ;
+  return flags;
+}
+
+/* run a ring scenario in the given sync mode, "spsc" to "mpmc" */
+static void perf_ring_scenario(const struct perf_config *cfg,
+    const char *mode, const char *placement, unsigned int producers,
+    unsigned int consumers, const unsigned int *lcores)
+{
+  struct perf_queue queue = { "ring", NULL, queue_enqueue<struct rte_ring>,
+    queue_dequeue<struct rte_ring> };
+  struct rte_ring *r;
+
+  r = rte_ring_create(cfg->size, perf_ring_flags(mode));
+  if (r == NULL)
+    return;
+  queue.q = r;
+  perf_scenario(cfg, &queue, mode, placement, producers, consumers, lcores);
+#ifdef RTE_RING_PROFILE
+  rte_ring_profile_dump(stdout, 0);
+  rte_ring_profile_reset();
+#endif
+  rte_ring_free(r);
+}
+
+/* CPU topology, as exposed by /sys/devices/system/cpu */
+struct cpu_topo {
+  unsigned int lcore;
+  int package;
+  int core;
+  int l3;                  /* first CPU sharing the L3, -1 if unknown */
+};
+
+static int sysfs_read_int(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  int v = -1;
+
+  if (f == NULL)
+    return -1;
+  if (fscanf(f, "%d", &v) != 1)
+    v = -1;
+  fclose(f);
+  return v;
+}
+
+/* identify the L3 of a CPU by the first CPU of its shared_cpu_list */
+static int sysfs_cpu_l3(int cpu)
+{
+  char path[128];
+  int idx;
+
+  for (idx = 0; idx < 8; idx++) {
+    snprintf(path, sizeof(path),
+        "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, idx);
+    if (sysfs_read_int(path) != 3)
+      continue;
+    snprintf(path, sizeof(path),
+        "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list",
+        cpu, idx);
+    return sysfs_read_int(path);
+  }
+  return -1;
+}
+
+static unsigned int perf_read_topology(struct cpu_topo *topo)
+{
+  char path[128];
+  unsigned int lcore, nb = 0;
+  int cpu;
+
+  for (lcore = 0; lcore < rte_lcore_count(); lcore++) {
+    cpu = rte_lcore_to_cpu_id(lcore);
+    topo[nb].lcore = lcore;
+    snprintf(path, sizeof(path),
+        "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    topo[nb].package = sysfs_read_int(path);
+    snprintf(path, sizeof(path),
+        "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+    topo[nb].core = sysfs_read_int(path);
+    topo[nb].l3 = sysfs_cpu_l3(cpu);
+    if (topo[nb].package >= 0 && topo[nb].core >= 0)
+      nb++;
+  }
+  return nb;
+}
+
+/* one lcore per physical core among the lcores matching a predicate */
+static unsigned int perf_one_per_core(const struct cpu_topo *topo,
+    unsigned int nb, int package, int l3, unsigned int *out)
+{
+  unsigned int i, j, n = 0;
+
+  for (i = 0; i < nb; i++) {
+    if ((package >= 0 && topo[i].package != package) ||
+        (l3 >= 0 && topo[i].l3 != l3))
+      continue;
+    for (j = 0; j < i; j++)
+      if (topo[j].package == topo[i].package && topo[j].core == topo[i].core)
+        break;
+    if (j == i)
+      out[n++] = topo[i].lcore;
+  }
+  return n;
+}
+
+/* the lcores of a placement class, in the order threads are added */
+static unsigned int perf_placement(const char *placement,
+    const struct cpu_topo *topo, unsigned int nb, unsigned int *out)
+{
+  unsigned int a[MAX_THREADS], b[MAX_THREADS];
+  unsigned int i, j, na, nb_b, n = 0, best = 0;
+
+  if (strcmp(placement, "smt") == 0) {
+    /* the first core with several hardware threads */
+    for (i = 0; i < nb; i++) {
+      n = 0;
+      for (j = 0; j < nb; j++)
+        if (topo[j].package == topo[i].package && topo[j].core == topo[i].core)
+          out[n++] = topo[j].lcore;
+      if (n >= 2)
+        return n;
+    }
+    return 0;
+  }
+
+  if (strcmp(placement, "l3") == 0) {
+    /* the L3 shared by the most physical cores */
+    for (i = 0; i < nb; i++) {
+      if (topo[i].l3 < 0)
+        continue;
+      na = perf_one_per_core(topo, nb, -1, topo[i].l3, a);
+      if (na > best) {
+        best = na;
+        memcpy(out, a, na * sizeof(*a));
+      }
+    }
+    return best >= 2 ? best : 0;
+  }
+
+  /* socket: alternate the cores of the first two packages */
+  for (i = 1; i < nb && topo[i].package == topo[0].package; i++)
+    ;
+  if (i == nb)
+    return 0;
+  na = perf_one_per_core(topo, nb, topo[0].package, -1, a);
+  nb_b = perf_one_per_core(topo, nb, topo[i].package, -1, b);
+  for (i = 0; i < na || i < nb_b; i++) {
+    if (i < na)
+      out[n++] = a[i];
+    if (i < nb_b)
+      out[n++] = b[i];
+  }
+  return n;
+}
+
+/* sweep the sync modes over thread counts for each placement class */
+static void perf_topology_sweep(const struct perf_config *cfg)
+{
+  static const char * const placements[] = { "smt", "l3", "socket" };
+  struct cpu_topo topo[MAX_THREADS];
+  unsigned int lcores[MAX_THREADS];
+  unsigned int p, t, n, nb;
+
+  nb = perf_read_topology(topo);
+  for (p = 0; p < sizeof(placements) / sizeof(placements[0]); p++) {
+    n = perf_placement(placements[p], topo, nb, lcores);
+    if (n < 2) {
+      printf("# %s: no such placement on this machine\n", placements[p]);
+      continue;
+    }
+    for (t = 2; ; t = (t * 2 > n && t < n) ? n : t * 2) {
+      /* with two threads, the multi modes show the uncontended sync cost */
+      if (t == 2)
+        perf_ring_scenario(cfg, "spsc", placements[p], 1, 1, lcores);
+      perf_ring_scenario(cfg, "mpsc", placements[p], t - 1, 1, lcores);
+      perf_ring_scenario(cfg, "mpmc", placements[p], t / 2, t - t / 2,
+          lcores);
+      if (t >= n)
+        break;
+    }
+  }
+}
+
+/* the MPSC list, with the nodes of a queue of cfg->size objects */
+static void perf_mpsc_scenario(const struct perf_config *cfg,
+    const char *mode, const unsigned int *lcores)
+{
+  static struct perf_mpsc m;
+  struct perf_queue queue = { "mpsc-list", &m, mpsc_enqueue, mpsc_dequeue };
+  unsigned int i;
+
+  rte_mpsc_init(&m.q, offsetof(struct perf_mpsc_node, link));
+  m.free = rte_ring_create(cfg->size, RING_F_EXACT_SZ | RING_F_SP_ENQ);
+  m.nodes = (struct perf_mpsc_node *)calloc(cfg->size,
+      sizeof(struct perf_mpsc_node));
+  if (m.free == NULL || m.nodes == NULL) {
+    fprintf(stderr, "Cannot allocate the list nodes\n");
+    rte_ring_free(m.free);
+    free(m.nodes);
+    return;
+  }
+  for (i = 0; i < cfg->size; i++)
+    rte_ring_sp_enqueue(m.free, &m.nodes[i]);
+
+  perf_scenario(cfg, &queue, mode, "any", cfg->producers, cfg->consumers,
+      lcores);
+  rte_ring_free(m.free);
+  free(m.nodes);
+}
+
+/*
+ * default run: the ring against back-only use of the two-lock deque and,
+ * with a single consumer, the MPSC list, then the ring classifying what it
+ * dequeues
+ */
+static void perf_queue_compare(const struct perf_config *cfg)
+{
+  struct perf_queue queue;
+  unsigned int lcores[MAX_THREADS];
+  const unsigned int nb = cfg->producers + cfg->consumers;
+  const char *mode;
+  struct rte_deque *d;
+  struct rte_ring *r;
+  unsigned int i;
+
+  if (nb > rte_lcore_count()) {
+    fprintf(stderr, "%u threads need as many lcores, only %u available\n",
+        nb, rte_lcore_count());
+    return;
+  }
+  /* workers first, so that the main lcore only takes part when needed */
+  for (i = 0; i < nb; i++)
+    lcores[i] = (i + 1) % rte_lcore_count();
+
+  mode = cfg->producers == 1 ? (cfg->consumers == 1 ? "spsc" : "spmc") :
+    (cfg->consumers == 1 ? "mpsc" : "mpmc");
+  perf_ring_scenario(cfg, mode, "any", cfg->producers, cfg->consumers, lcores);
+
+  d = rte_deque_create(cfg->size, 0);
+  if (d == NULL)
+    return;
+  queue.name = "deque-2lock";
+  queue.q = d;
+  queue.enqueue = queue_enqueue<struct rte_deque>;
+  queue.dequeue = queue_dequeue<struct rte_deque>;
+  perf_scenario(cfg, &queue, mode, "any", cfg->producers, cfg->consumers,
+      lcores);
+  rte_deque_free(d);
+
+  if (cfg->consumers == 1)
+    perf_mpsc_scenario(cfg, mode, lcores);
+
+  for (i = 0; i < MAX_BURST; i++)
+    perf_keys[i] = i % PERF_CLASSIFY_BINS;
+  r = rte_ring_create(cfg->size, perf_ring_flags(mode));
+  if (r == NULL)
+    return;
+  queue.name = "classify";
+  queue.q = r;
+  queue.enqueue = queue_enqueue<struct rte_ring>;
+  queue.dequeue = classify_dequeue;
+  perf_scenario(cfg, &queue, mode, "any", cfg->producers, cfg->consumers,
+      lcores);
+  rte_ring_free(r);
+}
+
+/*
+ * Every sync mode with more threads than CPUs. The multi sides get the
+ * given thread counts, the single sides one thread, and filler threads
+ * make up the difference (see perf_run_threads()).
+ */
+static void perf_oversub_sweep(const struct perf_config *cfg)
+{
+  static const char * const modes[] = { "spsc", "spmc", "mpsc", "mpmc" };
+  const char *placement;
+  unsigned int m, producers, consumers;
+
+  placement = cfg->inject == INJECT_YIELD ? "yield" :
+    cfg->inject == INJECT_SIGNAL ? "signal" : "oversub";
+  for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+    producers = modes[m][0] == 's' ? 1 : cfg->producers;
+    consumers = modes[m][2] == 's' ? 1 : cfg->consumers;
+    perf_ring_scenario(cfg, modes[m], placement, producers, consumers, NULL);
+  }
+}
+
+/* wait for the other replay thread, then take the start TSC */
+static void perf_replay_barrier(struct perf_replay *rp)
+{
+  if (__sync_add_and_fetch(&rp->ready, 1) == 2) {
+    rp->start = rte_rdtsc();
+    rp->go = 1;
+  }
+  while (!rp->go)
+    sched_yield();
+}
+
+/* issue the recorded calls of one side at their recorded times */
+static void perf_replay_side(struct perf_replay *rp, unsigned int enqueue)
+{
+  void **objs = rp->objs[enqueue];
+  const struct rte_ring_record_event *ev = rp->rec->events[enqueue];
+  const uint64_t nb = rp->rec->hdr.nb_events[enqueue];
+  uint64_t i, when, now, recorded = 0;
+  unsigned int done;
+
+  perf_replay_barrier(rp);
+  for (i = 0; i < nb; i++) {
+    recorded += ev[i].delta;
+    when = rp->start + (uint64_t)(recorded * rp->scale);
+    now = rte_rdtsc();
+    while (now < when) {
+      /* give up the CPU in long gaps, in case both sides share it */
+      if (when - now > tsc_hz / 10000)
+        sched_yield();
+      else
+        rte_pause();
+      now = rte_rdtsc();
+    }
+    if (now - when > rp->lag[enqueue])
+      rp->lag[enqueue] = now - when;
+    if (enqueue) {
+      done = rte_ring_enqueue_burst(rp->r, objs, ev[i].n, NULL);
+      rp->dropped += ev[i].n - done;
+    } else {
+      done = rte_ring_dequeue_burst(rp->r, objs, ev[i].n, NULL);
+    }
+    rp->moved[enqueue] += done;
+  }
+}
+
+static int perf_replay_producer(void *arg)
+{
+  perf_replay_side((struct perf_replay *)arg, 1);
+  return 0;
+}
+
+static int perf_replay_consumer(void *arg)
+{
+  perf_replay_side((struct perf_replay *)arg, 0);
+  return 0;
+}
+
+/* replay a recording in every sync mode */
+static void perf_replay_sweep(const struct perf_config *cfg)
+{
+  static const char * const modes[] = { "spsc", "spmc", "mpsc", "mpmc" };
+  struct rte_ring_recording rec;
+  struct rte_ring_sojourn st;
+  struct perf_replay rp;
+  unsigned int lcores[2];
+  unsigned int m, i, flags, count;
+  uint64_t recorded_drops = 0;
+  double us;
+
+  if (rte_lcore_count() < 2) {
+    fprintf(stderr, "a replay needs 2 lcores, only %u available\n",
+        rte_lcore_count());
+    return;
+  }
+  if (rte_ring_record_load(cfg->replay_path, &rec) != 0) {
+    fprintf(stderr, "cannot load recording %s\n", cfg->replay_path);
+    return;
+  }
+  for (i = 0; i < rec.hdr.nb_events[1]; i++)
+    recorded_drops += rec.events[1][i].n - rec.events[1][i].done;
+  us = 1e6 / tsc_hz;
+  count = cfg->size ? cfg->size : rec.hdr.capacity;
+
+  printf("replay of %s: %llu enqueues, %llu dequeues over %.3f ms, "
+      "capacity %u, %llu objects dropped\n", cfg->replay_path,
+      (unsigned long long)rec.hdr.nb_events[1],
+      (unsigned long long)rec.hdr.nb_events[0],
+      rec.hdr.cycles * 1e3 / rec.hdr.tsc_hz, rec.hdr.capacity,
+      (unsigned long long)recorded_drops);
+  if (rec.hdr.lost[0] || rec.hdr.lost[1])
+    printf("recording incomplete: %llu enqueues, %llu dequeues lost\n",
+        (unsigned long long)rec.hdr.lost[1],
+        (unsigned long long)rec.hdr.lost[0]);
+  printf("%-5s %8s %12s %10s %12s %8s %10s %10s %10s %10s\n", "mode",
+      "count", "enqueued", "dropped", "dequeued", "left", "lag(us)",
+      "p50(us)", "p99(us)", "max(us)");
+
+  for (i = 0; i < 2; i++)
+    lcores[i] = (i + 1) % rte_lcore_count();
+  for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+    flags = RING_F_SOJOURN | (cfg->size ? 0 : RING_F_EXACT_SZ);
+    if (modes[m][0] == 's')
+      flags |= RING_F_SP_ENQ;
+    if (modes[m][2] == 's')
+      flags |= RING_F_SC_DEQ;
+
+    memset(&rp, 0, sizeof(rp));
+    rp.rec = &rec;
+    rp.scale = (double)tsc_hz / rec.hdr.tsc_hz;
+    rp.r = rte_ring_create(count, flags);
+    rp.objs[0] = (void **)malloc(UINT16_MAX * sizeof(void *));
+    rp.objs[1] = (void **)malloc(UINT16_MAX * sizeof(void *));
+    if (rp.r == NULL || rp.objs[0] == NULL || rp.objs[1] == NULL) {
+      fprintf(stderr, "cannot create a %s ring of %u objects for the "
+          "replay\n", modes[m], count);
+      rte_ring_free(rp.r);
+      free(rp.objs[0]);
+      free(rp.objs[1]);
+      break;
+    }
+    for (i = 0; i < UINT16_MAX; i++)
+      rp.objs[1][i] = (void *)(uintptr_t)(i + 1);
+
+    /* the main lcore, if used, takes the consumer side */
+    rte_eal_remote_launch(perf_replay_producer, &rp, lcores[0]);
+    if (lcores[1] == rte_get_main_lcore())
+      perf_replay_consumer(&rp);
+    else
+      rte_eal_remote_launch(perf_replay_consumer, &rp, lcores[1]);
+    for (i = 0; i < 2; i++)
+      rte_eal_wait_lcore(lcores[i]);
+
+    rte_ring_sojourn_get(rp.r, &st);
+    printf("%-5s %8u %12llu %10llu %12llu %8u %10.1f %10.3f %10.3f %10.3f\n",
+        modes[m], rp.r->capacity, (unsigned long long)rp.moved[1],
+        (unsigned long long)rp.dropped, (unsigned long long)rp.moved[0],
+        rte_ring_count(rp.r),
+        us * (rp.lag[0] > rp.lag[1] ? rp.lag[0] : rp.lag[1]),
+        us * rte_ring_sojourn_percentile(&st, 0.5),
+        us * rte_ring_sojourn_percentile(&st, 0.99), us * st.max);
+    fflush(stdout);
+    rte_ring_free(rp.r);
+    free(rp.objs[0]);
+    free(rp.objs[1]);
+  }
+  rte_ring_record_unload(&rec);
+}
+
+/* wait for all the threads of a loaded run, then take the start TSC */
+static void perf_load_barrier(struct perf_load *ld)
+{
+  if (__sync_add_and_fetch(&ld->ready, 1) == ld->producers + ld->consumers) {
+    ld->start = rte_rdtsc();
+    ld->go = 1;
+  }
+  while (!ld->go)
+    sched_yield();
+}
+
+static void perf_load_merge(struct perf_load *ld,
+    const struct rte_ring_loadgen_stats *st)
+{
+  pthread_mutex_lock(&ld->lock);
+  rte_ring_loadgen_stats_add(&ld->stats, st);
+  pthread_mutex_unlock(&ld->lock);
+}
+
+/* enqueue generated bursts at their arrival times until the end of the run,
+ * objects carry their arrival TSC */
+static int perf_load_producer(void *arg)
+{
+  struct perf_load *ld = (struct perf_load *)arg;
+  struct rte_ring_loadgen_stats st;
+  struct rte_ring_loadgen g;
+  void *objs[MAX_BURST];
+  uint64_t next, end, now;
+  unsigned int i, n, done;
+
+  memset(&st, 0, sizeof(st));
+  rte_ring_loadgen_init(&g, ld->traffic, __sync_add_and_fetch(&ld->seed, 1));
+  perf_load_barrier(ld);
+  end = ld->start + ld->cfg->duration_ms * (tsc_hz / 1000);
+  for (next = ld->start + rte_ring_loadgen_gap(&g); next < end;
+      next += rte_ring_loadgen_gap(&g)) {
+    now = rte_rdtsc();
+    while (now < next) {
+      /* give up the CPU in long gaps, in case threads share it */
+      if (next - now > tsc_hz / 10000)
+        sched_yield();
+      else
+        rte_pause();
+      now = rte_rdtsc();
+    }
+    n = rte_ring_loadgen_burst(&g, MAX_BURST);
+    for (i = 0; i < n; i++)
+      objs[i] = (void *)(uintptr_t)next;
+    done = rte_ring_enqueue_burst(ld->r, objs, n, NULL);
+    st.offered += n;
+    st.enqueued += done;
+    st.dropped += n - done;
+  }
+  st.cycles = rte_rdtsc() - ld->start;
+  perf_load_merge(ld, &st);
+  __sync_add_and_fetch(&ld->producers_done, 1);
+  return 0;
+}
+
+/* dequeue and serve until the producers are done and the ring is empty */
+static int perf_load_consumer(void *arg)
+{
+  struct perf_load *ld = (struct perf_load *)arg;
+  struct rte_ring_loadgen_stats st;
+  struct rte_ring_loadgen g;
+  void *objs[MAX_BURST];
+  uint64_t until, now;
+  unsigned int i, j, n, last;
+
+  memset(&st, 0, sizeof(st));
+  rte_ring_loadgen_init(&g, ld->traffic, __sync_add_and_fetch(&ld->seed, 1));
+  perf_load_barrier(ld);
+  for (;;) {
+    last = ld->producers_done == ld->producers;
+    n = rte_ring_dequeue_burst(ld->r, objs, ld->cfg->burst, NULL);
+    if (n == 0) {
+      if (last)
+        break;
+      rte_pause();
+      continue;
+    }
+    until = rte_rdtsc() + rte_ring_loadgen_service(&g, n);
+    while ((now = rte_rdtsc()) < until)
+      rte_pause();
+    /* objects of a burst share their arrival time */
+    for (i = 0; i < n; i = j) {
+      for (j = i + 1; j < n && objs[j] == objs[i]; j++)
+        ;
+      rte_ring_loadgen_latency(&st, now - (uintptr_t)objs[i], j - i);
+    }
+    st.dequeued += n;
+  }
+  st.cycles = rte_rdtsc() - ld->start;
+  perf_load_merge(ld, &st);
+  return 0;
+}
+
+/* run every sync mode under each traffic pattern given with -L */
+static void perf_load_sweep(const struct perf_config *cfg)
+{
+  static const char * const modes[] = { "spsc", "spmc", "mpsc", "mpmc" };
+  struct rte_ring_loadgen_config traffic;
+  const struct rte_ring_loadgen_stats *st;
+  lcore_function_t *main_role;
+  lcore_function_t *role;
+  unsigned int lcores[MAX_THREADS];
+  struct perf_load ld;
+  unsigned int l, m, i, nb, flags;
+  double us, secs;
+
+  if (cfg->producers + cfg->consumers > rte_lcore_count()) {
+    fprintf(stderr, "%u threads need as many lcores, only %u available\n",
+        cfg->producers + cfg->consumers, rte_lcore_count());
+    return;
+  }
+  for (i = 0; i < cfg->producers + cfg->consumers; i++)
+    lcores[i] = (i + 1) % rte_lcore_count();
+  us = 1e6 / tsc_hz;
+
+  for (l = 0; l < cfg->nb_loads; l++) {
+    memset(&traffic, 0, sizeof(traffic));
+    traffic.arrival = RTE_RING_LOADGEN_POISSON;
+    traffic.burst.mean = cfg->burst;
+    if (rte_ring_loadgen_parse(cfg->loads[l], &traffic) != 0) {
+      fprintf(stderr, "invalid traffic %s\n", cfg->loads[l]);
+      continue;
+    }
+    printf("traffic ");
+    rte_ring_loadgen_print(stdout, &traffic);
+    printf("\n%-5s %5s %5s %12s %12s %8s %10s %10s %10s %10s\n", "mode",
+        "prod", "cons", "offered(M/s)", "served(M/s)", "drop(%)", "p50(us)",
+        "p99(us)", "p99.9(us)", "max(us)");
+
+    for (m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+      memset(&ld, 0, sizeof(ld));
+      ld.cfg = cfg;
+      ld.traffic = &traffic;
+      ld.producers = modes[m][0] == 's' ? 1 : cfg->producers;
+      ld.consumers = modes[m][2] == 's' ? 1 : cfg->consumers;
+      flags = 0;
+      if (modes[m][0] == 's')
+        flags |= RING_F_SP_ENQ;
+      if (modes[m][2] == 's')
+        flags |= RING_F_SC_DEQ;
+      ld.r = rte_ring_create(cfg->size, flags);
+      if (ld.r == NULL)
+        return;
+      pthread_mutex_init(&ld.lock, NULL);
+
+      nb = ld.producers + ld.consumers;
+      main_role = NULL;
+      for (i = 0; i < nb; i++) {
+        role = i < ld.producers ? perf_load_producer : perf_load_consumer;
+        if (lcores[i] == rte_get_main_lcore())
+          main_role = role;
+        else
+          rte_eal_remote_launch(role, &ld, lcores[i]);
+      }
+      if (main_role != NULL)
+        main_role(&ld);
+      for (i = 0; i < nb; i++)
+        rte_eal_wait_lcore(lcores[i]);
+
+      st = &ld.stats;
+      secs = (double)st->cycles / tsc_hz;
+      printf("%-5s %5u %5u %12.3f %12.3f %8.3f %10.3f %10.3f %10.3f %10.3f\n",
+          modes[m], ld.producers, ld.consumers, st->offered / secs / 1e6,
+          st->dequeued / secs / 1e6,
+          st->offered ? 100.0 * st->dropped / st->offered : 0.0,
+          us * rte_ring_sojourn_percentile(&st->latency, 0.5),
+          us * rte_ring_sojourn_percentile(&st->latency, 0.99),
+          us * rte_ring_sojourn_percentile(&st->latency, 0.999),
+          us * st->latency.max);
+      fflush(stdout);
+      pthread_mutex_destroy(&ld.lock);
+      rte_ring_free(ld.r);
+    }
+  }
+}
+
+static void perf_write_csv(const char *path)
+{
+  FILE *f = fopen(path, "w");
+  const struct perf_result *res;
+  double median;
+  unsigned int i, j;
+
+  if (f == NULL) {
+    perror(path);
+    return;
+  }
+  fprintf(f, "queue,mode,placement,threads,producers,consumers,"
+      "cycles_per_object,mobjs_per_s,max_stall_us");
+  for (j = 0; j < PERF_EV_MAX; j++)
+    fprintf(f, ",%s", perf_event_names[j]);
+  fprintf(f, "\n");
+  for (i = 0; i < nb_results; i++) {
+    res = &results[i];
+    median = perf_median(res);
+    fprintf(f, "%s,%s,%s,%u,%u,%u,%.3f,%.3f,", res->queue, res->mode,
+        res->placement, res->producers + res->consumers, res->producers,
+        res->consumers, median, median > 0 ? tsc_hz / median / 1e6 : 0.0);
+    if (res->has_stall)
+      fprintf(f, "%.3f", res->max_stall * 1e6 / tsc_hz);
+    for (j = 0; j < PERF_EV_MAX; j++) {
+      fprintf(f, ",");
+      if (perf_event_ok[j])
+        fprintf(f, "%.4f", res->events[j]);
+    }
+    fprintf(f, "\n");
+  }
+  fclose(f);
+}
+
+static void perf_write_json(const char *path, const struct perf_config *cfg)
+{
+  FILE *f = fopen(path, "w");
+  const struct perf_result *res;
+  unsigned int i, j, n;
+
+  if (f == NULL) {
+    perror(path);
+    return;
+  }
+  fprintf(f, "{\n  \"tool\": \"ring_perf\",\n  \"version\": 1,\n"
+      "  \"tsc_hz\": %llu,\n  \"size\": %u,\n  \"burst\": %u,\n"
+      "  \"ops\": %lu,\n  \"unit\": \"cycles/object\",\n"
+      "  \"scenarios\": [\n", (unsigned long long)tsc_hz, cfg->size,
+      cfg->burst, cfg->ops);
+  for (i = 0; i < nb_results; i++) {
+    res = &results[i];
+    fprintf(f, "    {\"name\": \"%s/%s/%s/p%uc%u\", \"queue\": \"%s\", "
+        "\"mode\": \"%s\", \"placement\": \"%s\", \"producers\": %u, "
+        "\"consumers\": %u, \"samples\": [", res->queue, res->mode,
+        res->placement, res->producers, res->consumers, res->queue,
+        res->mode, res->placement, res->producers, res->consumers);
+    for (j = 0; j < res->nb_samples; j++)
+      fprintf(f, "%s%.3f", j ? ", " : "", res->samples[j]);
+    fprintf(f, "]");
+    if (res->has_stall)
+      fprintf(f, ", \"max_stall_us\": %.3f", res->max_stall * 1e6 / tsc_hz);
+    for (j = 0, n = 0; j < PERF_EV_MAX; j++)
+      if (perf_event_ok[j])
+        fprintf(f, "%s\"%s\": %.4f", n++ ? ", " : ", \"events\": {",
+            perf_event_names[j], res->events[j]);
+    if (n)
+      fprintf(f, "}");
+    fprintf(f, "}%s\n", i + 1 < nb_results ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  fclose(f);
+}
+
+/* set up the lcores on a comma separated list of CPUs */
+static int perf_init_cpus(const char *list)
+{
+  int cpus[RTE_MAX_LCORE];
+  unsigned int nb = 0;
+  char *end;
+
+  while (*list != '\0' && nb < RTE_MAX_LCORE) {
+    cpus[nb++] = (int)strtol(list, &end, 10);
+    if (end == list || (*end != ',' && *end != '\0'))
+      return -1;
+    list = *end == ',' ? end + 1 : end;
+  }
+  return rte_lcore_init_cpus(cpus, nb);
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+      "Usage: %s [-s size] [-b burst] [-n ops] [-p producers] "
+      "[-c consumers] [-r repeat] [-l cpus] [-T | -O [-i inject] [-f period] "
+      "[-d delay] | -R recording | -L traffic... [-D ms]] [-e [-H raw]] "
+      "[-C csv] [-J json]\n"
+      "  -s  queue size, a power of 2 (default 1024)\n"
+      "  -b  burst size (default 32, max %d)\n"
+      "  -n  objects enqueued by each producer (default 10000000)\n"
+      "  -p  producer threads (default 1)\n"
+      "  -c  consumer threads (default 1)\n"
+      "  -r  runs of each scenario (default 5, max %d)\n"
+      "  -l  CPUs of the lcores, e.g. 0,2,4 (default: all allowed CPUs)\n"
+      "  -T  sweep sync modes and thread counts over the CPU topology\n"
+      "  -O  run every sync mode with -p producers and -c consumers\n"
+      "      (default: one per lcore each) pinned round-robin on the lcore\n"
+      "      CPUs, single sides with one thread and busy filler threads\n"
+      "      in its place, so every mode runs more threads than lcores\n"
+      "  -i  preemption injected with -O: none, yield (between head and\n"
+      "      tail moves, needs RTE_RING_DEBUG_PREEMPT) or signal\n"
+      "  -f  yield every this many tail updates (default 64), or signal a\n"
+      "      random thread every this many microseconds (default 1000)\n"
+      "  -d  microseconds a signalled thread stalls (default 100)\n"
+      "  -R  replay a ring traffic recording in every sync mode, on a ring\n"
+      "      of the recorded capacity unless -s is given\n"
+      "  -L  run every sync mode under generated traffic, e.g.\n"
+      "      arrival=onoff,rate=1e6,on=100,off=900,service=exp:20\n"
+      "      (see rte_ring_loadgen.h), up to %d times\n"
+      "  -D  duration of each run with -L, in milliseconds (default 1000)\n"
+      "  -e  count hardware events per object with perf_event_open()\n"
+      "  -H  raw config of a HITM event to count with -e\n"
+      "  -C  write the median of each scenario to a CSV file\n"
+      "  -J  write all the samples to a JSON file\n",
+      prog, MAX_BURST, MAX_REPEAT, MAX_LOADS);
+}
+
+int main(int argc, char **argv)
+{
+  struct perf_config cfg = { 1024, 32, 10000000, 1, 1, 5, 0, 0, 0, 0,
+    INJECT_NONE, 0, 100, NULL, NULL, NULL, NULL, 0, { NULL }, 1000 };
+  int explicit_threads = 0, explicit_size = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:b:n:p:c:r:l:TOi:f:d:eH:C:J:R:L:D:h")) !=
+      -1) {
+    switch (opt) {
+      case 's': cfg.size = atoi(optarg); explicit_size = 1; break;
+      case 'b': cfg.burst = atoi(optarg); break;
+      case 'n': cfg.ops = strtoul(optarg, NULL, 0); break;
+      case 'p': cfg.producers = atoi(optarg); explicit_threads = 1; break;
+      case 'c': cfg.consumers = atoi(optarg); explicit_threads = 1; break;
+      case 'r': cfg.repeat = atoi(optarg); break;
+      case 'l': cfg.cpus = optarg; break;
+      case 'T': cfg.topology = 1; break;
+      case 'O': cfg.oversub = 1; break;
+      case 'i':
+        if (strcmp(optarg, "yield") == 0)
+          cfg.inject = INJECT_YIELD;
+        else if (strcmp(optarg, "signal") == 0)
+          cfg.inject = INJECT_SIGNAL;
+        else if (strcmp(optarg, "none") == 0)
+          cfg.inject = INJECT_NONE;
+        else {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'e': cfg.counters = 1; break;
+      case 'H': cfg.hitm_config = strtoull(optarg, NULL, 0); break;
+      case 'f': cfg.period = atoi(optarg); break;
+      case 'd': cfg.delay_us = atoi(optarg); break;
+      case 'C': cfg.csv_path = optarg; break;
+      case 'J': cfg.json_path = optarg; break;
+      case 'R': cfg.replay_path = optarg; break;
+      case 'L':
+        if (cfg.nb_loads == MAX_LOADS) {
+          usage(argv[0]);
+          return 1;
+        }
+        cfg.loads[cfg.nb_loads++] = optarg;
+        break;
+      case 'D': cfg.duration_ms = atoi(optarg); break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (cfg.burst == 0 || cfg.burst > MAX_BURST || cfg.producers == 0 ||
+      cfg.consumers == 0 || cfg.producers + cfg.consumers >
+      (cfg.oversub ? MAX_OVERSUB_THREADS : MAX_THREADS) ||
+      cfg.repeat == 0 || cfg.repeat > MAX_REPEAT ||
+      (cfg.topology && cfg.oversub) || (cfg.inject && !cfg.oversub) ||
+      (cfg.replay_path != NULL && (cfg.topology || cfg.oversub)) ||
+      (cfg.nb_loads && (cfg.topology || cfg.oversub || cfg.replay_path))) {
+    usage(argv[0]);
+    return 1;
+  }
+#ifndef RTE_RING_DEBUG_PREEMPT
+  if (cfg.inject == INJECT_YIELD) {
+    fprintf(stderr, "-i yield needs a build with RTE_RING_DEBUG_PREEMPT\n");
+    return 1;
+  }
+#endif
+
+  if ((cfg.cpus != NULL ? perf_init_cpus(cfg.cpus) : rte_lcore_init()) < 0)
+    return 1;
+  tsc_hz = rte_get_tsc_hz();
+  if (cfg.counters)
+    perf_counters_probe(&cfg);
+
+  if (cfg.oversub) {
+    if (!explicit_threads)
+      cfg.producers = cfg.consumers = rte_lcore_count();
+    if (cfg.period == 0)
+      cfg.period = cfg.inject == INJECT_SIGNAL ? 1000 : 64;
+    inject_period = cfg.period;
+    inject_delay_us = cfg.delay_us;
+#ifdef RTE_RING_DEBUG_PREEMPT
+    if (cfg.inject == INJECT_YIELD)
+      rte_ring_preempt_hook = perf_preempt_yield;
+#endif
+    if (cfg.inject == INJECT_SIGNAL)
+      signal(SIGUSR1, perf_preempt_signal);
+  }
+
+  if (cfg.replay_path != NULL) {
+    if (!explicit_size)
+      cfg.size = 0;
+    perf_replay_sweep(&cfg);
+    rte_lcore_cleanup();
+    return 0;
+  }
+  if (cfg.nb_loads) {
+    perf_load_sweep(&cfg);
+    rte_lcore_cleanup();
+    return 0;
+  }
+
+  printf("%-11s %-5s %-9s %5s %5s %14s %12s %12s\n", "queue", "mode",
+      "placement", "prod", "cons", "cycles/object", "Mobjs/s",
+      "stall(us)");
+
+  if (cfg.topology)
+    perf_topology_sweep(&cfg);
+  else if (cfg.oversub)
+    perf_oversub_sweep(&cfg);
+  else
+    perf_queue_compare(&cfg);
+
+  if (cfg.csv_path != NULL)
+    perf_write_csv(cfg.csv_path);
+  if (cfg.json_path != NULL)
+    perf_write_json(cfg.json_path, &cfg);
+
+  rte_lcore_cleanup();
+  return 0;
+}
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-3-Clause
+
+"""Compare two ring_perf JSON results.
+
+Scenarios of the baseline and candidate files (ring_perf -J) are matched by
+name. For each pair, the change of the median cycles per object is given
+with a bootstrap confidence interval over the repeated runs (ring_perf -r).
+A scenario regresses when the change is above the threshold and the whole
+interval is above zero, so that noise alone does not fail a review; it
+improves in the symmetric case. A change beyond the threshold with an
+interval crossing zero is reported as noisy. The report is a markdown
+table, and the exit status is 1 if any scenario regressed.
+
+Usage: ring_perf_compare.py [-t percent] [-c level] [-b resamples]
+                            baseline.json candidate.json
+"""
+
+import argparse
+import json
+import random
+import statistics
+import sys
+
+MIN_SAMPLES = 3
+
+
+def load(path):
+    with open(path) as f:
+        doc = json.load(f)
+    if doc.get("tool") != "ring_perf":
+        raise ValueError("%s is not a ring_perf result" % path)
+    return doc, {s["name"]: s for s in doc["scenarios"]}
+
+
+def change(base, cand):
+    """Relative change of the median, in percent."""
+    return 100.0 * (statistics.median(cand) / statistics.median(base) - 1)
+
+
+def bootstrap(base, cand, level, resamples, rng):
+    """Confidence interval of the change of the median, in percent."""
+    changes = []
+    for _ in range(resamples):
+        b = [rng.choice(base) for _ in base]
+        c = [rng.choice(cand) for _ in cand]
+        changes.append(change(b, c))
+    changes.sort()
+    lo = int((1 - level) / 2 * resamples)
+    hi = min(resamples - 1, int((1 + level) / 2 * resamples))
+    return changes[lo], changes[hi]
+
+
+def verdict(delta, ci, threshold):
+    if ci is None:
+        return "too few runs"
+    if delta > threshold and ci[0] > 0:
+        return "**regression**"
+    if delta < -threshold and ci[1] < 0:
+        return "improvement"
+    if abs(delta) > threshold:
+        return "noisy, rerun with more runs"
+    return "same"
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compare two ring_perf JSON results.")
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument("-t", "--threshold", type=float, default=5.0,
+                        help="change of the median flagged, in percent "
+                        "(default 5)")
+    parser.add_argument("-c", "--confidence", type=float, default=0.95,
+                        help="level of the confidence interval "
+                        "(default 0.95)")
+    parser.add_argument("-b", "--resamples", type=int, default=2000,
+                        help="bootstrap resamples (default 2000)")
+    args = parser.parse_args()
+
+    try:
+        base_doc, base = load(args.baseline)
+        cand_doc, cand = load(args.candidate)
+    except (OSError, ValueError, KeyError) as e:
+        print("ring_perf_compare: %s" % e, file=sys.stderr)
+        return 2
+
+    for key in ("size", "burst", "ops"):
+        if base_doc.get(key) != cand_doc.get(key):
+            print("warning: %s differs: %s vs %s" % (key, base_doc.get(key),
+                  cand_doc.get(key)), file=sys.stderr)
+
+    # same draws for the same inputs, so reruns agree
+    rng = random.Random(0)
+    regressions = 0
+    pct = int(round(args.confidence * 100))
+    print("| scenario | baseline | candidate | change | %d%% CI | verdict |"
+          % pct)
+    print("|---|---:|---:|---:|---:|---|")
+    for name in base:
+        if name not in cand:
+            continue
+        b = base[name]["samples"]
+        c = cand[name]["samples"]
+        delta = change(b, c)
+        ci = None
+        if len(b) >= MIN_SAMPLES and len(c) >= MIN_SAMPLES:
+            ci = bootstrap(b, c, args.confidence, args.resamples, rng)
+        v = verdict(delta, ci, args.threshold)
+        if v == "**regression**":
+            regressions += 1
+        print("| %s | %.2f | %.2f | %+.1f%% | %s | %s |" % (
+            name, statistics.median(b), statistics.median(c), delta,
+            "[%+.1f%%, %+.1f%%]" % ci if ci else "-", v))
+
+    only = ([("baseline", n) for n in base if n not in cand] +
+            [("candidate", n) for n in cand if n not in base])
+    if only:
+        print()
+        for side, name in only:
+            print("- %s only in the %s" % (name, side))
+
+    print()
+    print("Cycles per object, medians of %s runs; threshold %.1f%%: "
+          "%d regression%s." % (
+              "/".join(sorted({str(len(s["samples"]))
+                               for s in list(base.values()) +
+                               list(cand.values())})),
+              args.threshold, regressions, "" if regressions == 1 else "s"))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
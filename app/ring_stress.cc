@@ -0,0 +1,842 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * @file
+ * Ring torture test
+ *
+ * Runs every sync mode of the ring (spsc, spmc, mpsc, mpmc), in every
+ * variant (plain, exact size, tombstone, sojourn), with more threads than
+ * the machine has CPUs. The list variant runs the single-consumer modes on
+ * the rte_mpsc queue instead. Producers enqueue sequence-numbered objects and
+ * consumers check them, each call drawing its burst size, its behaviour
+ * (fixed or variable) and its API at random among those the ring supports:
+ *
+ * - enqueue: bulk, burst, single object, scatter-gather, zero-copy (single
+ *   producer), with handles and random cancellations (tombstone);
+ * - dequeue: bulk, burst, single object, prefetch, apply, classify, and
+ *   transfer to a private ring;
+ * - list: wait-free enqueue of bursts or single objects, drained in bursts
+ *   or one object at a time. The objects travel in nodes that each
+ *   producer takes from a pool of -s nodes, refilled by the consumer.
+ *
+ * Each object holds its producer and sequence number. Consumers check that
+ * no tombstone is returned, that every object is delivered at most once and
+ * that each consumer sees the objects of a producer in increasing order; the
+ * end of the run checks that every object was delivered or, on a tombstone
+ * ring, cancelled, but not both, that the ring indexes agree, that a
+ * sojourn ring accounted for every slot, and that a list is empty with all
+ * its nodes back in the pools.
+ *
+ * Delays can be injected between head moves and tail updates through
+ * rte_ring_preempt_hook (builds with RTE_RING_DEBUG_PREEMPT), where a late
+ * thread holds back the others, or anywhere with signals.
+ *
+ * Usage: ring_stress [options], see usage(). The exit status is 1 if any
+ * run failed.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+
+#include <my_global.h>
+
+#include <rte_common.h>
+#include "rte_ring.h"
+#include "rte_mpsc.h"
+
+#define MAX_THREADS 256
+#define MAX_BURST 64
+#define SEQ_BITS 40                  /* producer in the bits above */
+#define MAX_ERRORS 16                /* reported per run */
+#define NB_BINS 4                    /* classify bins */
+
+/* injected delays */
+enum stress_inject {
+  INJECT_NONE,
+  INJECT_YIELD,            /* sched_yield() between head and tail moves */
+  INJECT_DELAY,            /* spin between head and tail moves */
+  INJECT_SIGNAL,           /* signals stalling random threads */
+};
+
+enum stress_variant {
+  VARIANT_PLAIN,
+  VARIANT_EXACT,
+  VARIANT_TOMBSTONE,
+  VARIANT_SOJOURN,
+  VARIANT_LIST,            /* rte_mpsc, single consumer modes only */
+  VARIANT_MAX
+};
+
+static const char * const variant_names[VARIANT_MAX] = {
+  "plain", "exact", "tombstone", "sojourn", "list"
+};
+
+static const char * const mode_names[] = { "spsc", "spmc", "mpsc", "mpmc" };
+#define NB_MODES (sizeof(mode_names) / sizeof(mode_names[0]))
+
+enum stress_enqueue_op {
+  ENQ_BULK, ENQ_BURST, ENQ_ONE, ENQ_SG, ENQ_ZC, ENQ_HANDLE, ENQ_MAX
+};
+
+enum stress_dequeue_op {
+  DEQ_BULK, DEQ_BURST, DEQ_ONE, DEQ_PREFETCH, DEQ_APPLY, DEQ_CLASSIFY,
+  DEQ_TRANSFER, DEQ_MAX
+};
+
+struct stress_config {
+  unsigned int size;
+  unsigned int producers;
+  unsigned int consumers;
+  unsigned int seconds;
+  uint64_t max_objs;       /* per producer */
+  enum stress_inject inject;
+  unsigned int period;
+  unsigned int delay_us;
+  uint64_t seed;
+  unsigned int modes;      /* bit mask of mode_names */
+  unsigned int variants;   /* bit mask of enum stress_variant */
+};
+
+/* an object of the list variant */
+struct stress_node {
+  struct rte_mpsc_node link;
+  void *obj;
+  unsigned int owner;      /* producer whose pool it goes back to */
+};
+
+/* what a producer sent, and what was seen of it */
+struct stress_producer {
+  volatile uint64_t sent;
+  volatile uint64_t cancelled_nb;
+  uint64_t *delivered;     /* bitmap of the sequence numbers */
+  uint64_t *cancelled;
+  struct rte_ring *pool;   /* free nodes of the list variant */
+  struct stress_node *nodes;
+};
+
+/* state shared by the threads of one run */
+struct stress_run {
+  const struct stress_config *cfg;
+  struct rte_ring *r;
+  struct rte_mpsc q;       /* instead of r in the list variant */
+  enum stress_variant variant;
+  unsigned int sp;
+  unsigned int producers;
+  unsigned int consumers;
+  volatile unsigned int stop;
+  volatile unsigned int producers_done;
+  volatile unsigned int errors;
+  volatile uint64_t ops[2];      /* dequeue, enqueue calls */
+  struct stress_producer prod[MAX_THREADS];
+};
+
+/* a thread of a run */
+struct stress_thread {
+  struct stress_run *run;
+  unsigned int id;
+  pthread_t tid;
+  uint64_t rng;
+};
+
+static unsigned int inject_period;
+static unsigned int inject_delay_us;
+static __thread uint64_t inject_rng;
+
+static uint64_t stress_rand(uint64_t *s)
+{
+  *s ^= *s << 13;
+  *s ^= *s >> 7;
+  *s ^= *s << 17;
+  return *s;
+}
+
+#ifdef RTE_RING_DEBUG_PREEMPT
+static void stress_delay(unsigned int us)
+{
+  const uint64_t end = rte_rdtsc() + us * (rte_get_tsc_hz() / 1000000);
+
+  while (rte_rdtsc() < end)
+    rte_pause();
+}
+
+/* stall about once every period tail updates */
+static void stress_preempt_yield(const struct rte_ring_headtail *ht,
+    unsigned int enqueue)
+{
+  (void)ht;
+  (void)enqueue;
+  if (stress_rand(&inject_rng) % inject_period == 0)
+    sched_yield();
+}
+
+static void stress_preempt_delay(const struct rte_ring_headtail *ht,
+    unsigned int enqueue)
+{
+  (void)ht;
+  (void)enqueue;
+  if (stress_rand(&inject_rng) % inject_period == 0)
+    stress_delay(inject_delay_us);
+}
+#endif
+
+/* stall the interrupted thread, wherever it was */
+static void stress_preempt_signal(int sig)
+{
+  struct timespec ts;
+
+  (void)sig;
+  ts.tv_sec = inject_delay_us / 1000000;
+  ts.tv_nsec = (inject_delay_us % 1000000) * 1000L;
+  nanosleep(&ts, NULL);
+}
+
+static void *stress_obj(unsigned int p, uint64_t seq)
+{
+  return (void *)(uintptr_t)(((uint64_t)(p + 1) << SEQ_BITS) | seq);
+}
+
+static void stress_error(struct stress_run *run, const char *fmt, ...)
+{
+  va_list ap;
+
+  if (__sync_add_and_fetch(&run->errors, 1) <= MAX_ERRORS) {
+    va_start(ap, fmt);
+    printf("  error: ");
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+  }
+  run->stop = 1;
+}
+
+/* a bit of a producer bitmap, set atomically; returns its old value */
+static int stress_bit_set(uint64_t *map, uint64_t seq)
+{
+  const uint64_t bit = 1ULL << (seq % 64);
+
+  return (__sync_fetch_and_or(&map[seq / 64], bit) & bit) != 0;
+}
+
+/* check the objects a consumer got */
+static void stress_check(struct stress_run *run, int64_t *last,
+    void * const *objs, unsigned int n)
+{
+  uintptr_t v;
+  uint64_t seq;
+  unsigned int i, p;
+
+  for (i = 0; i < n; i++) {
+    v = (uintptr_t)objs[i];
+    p = (unsigned int)(v >> SEQ_BITS) - 1;
+    seq = v & ((1ULL << SEQ_BITS) - 1);
+    if (p >= run->producers || seq >= run->cfg->max_objs) {
+      stress_error(run, "invalid object from %u, seq %" PRIu64 " (%"
+          PRIx64 ")", p, seq, (uint64_t)v);
+      continue;
+    }
+    if ((int64_t)seq <= last[p])
+      stress_error(run, "producer %u: seq %" PRIu64 " after %" PRIu64,
+          p, seq, (uint64_t)last[p]);
+    last[p] = (int64_t)seq;
+    if (stress_bit_set(run->prod[p].delivered, seq))
+      stress_error(run, "producer %u: seq %" PRIu64 " delivered twice",
+          p, seq);
+  }
+}
+
+static unsigned int stress_enqueue(struct stress_thread *t, void **objs,
+    unsigned int n)
+{
+  struct stress_run *run = t->run;
+  struct stress_producer *prod = &run->prod[t->id];
+  struct rte_ring *r = run->r;
+  rte_ring_handle_t handles[MAX_BURST];
+  struct rte_ring_iovec iov[2];
+  struct rte_ring_zc_data zcd;
+  enum rte_ring_queue_behavior behavior;
+  unsigned int op, done, k, split;
+
+  do
+    op = stress_rand(&t->rng) % ENQ_MAX;
+  while ((op == ENQ_ZC && !run->sp) ||
+      (op == ENQ_HANDLE && run->variant != VARIANT_TOMBSTONE));
+  behavior = stress_rand(&t->rng) % 2 ?
+    RTE_RING_QUEUE_FIXED : RTE_RING_QUEUE_VARIABLE;
+
+  switch (op) {
+    case ENQ_BULK:
+      return rte_ring_enqueue_bulk(r, objs, n, NULL);
+    case ENQ_BURST:
+      return rte_ring_enqueue_burst(r, objs, n, NULL);
+    case ENQ_ONE:
+      return rte_ring_enqueue(r, objs[0]) == 0;
+    case ENQ_SG:
+      split = stress_rand(&t->rng) % (n + 1);
+      iov[0].objs = objs;
+      iov[0].n = split;
+      iov[1].objs = objs + split;
+      iov[1].n = n - split;
+      return rte_ring_enqueue_sg(r, iov, 2, behavior, NULL);
+    case ENQ_ZC:
+      done = behavior == RTE_RING_QUEUE_FIXED ?
+        rte_ring_enqueue_zc_bulk_start(r, n, &zcd, NULL) :
+        rte_ring_enqueue_zc_burst_start(r, n, &zcd, NULL);
+      if (done == 0)
+        return 0;
+      /* commit part of the reservation at random, or cancel all of it */
+      done = stress_rand(&t->rng) % (done + 1);
+      for (k = 0; k < done; k++) {
+        if (k < zcd.n1)
+          zcd.ptr1[k] = objs[k];
+        else
+          zcd.ptr2[k - zcd.n1] = objs[k];
+      }
+      rte_ring_enqueue_zc_finish(r, done);
+      return done;
+    default:
+      done = rte_ring_enqueue_burst_handle(r, objs, n, handles, NULL);
+      /* cancel one of them now and then */
+      if (done != 0 && stress_rand(&t->rng) % 4 == 0) {
+        k = stress_rand(&t->rng) % done;
+        if (rte_ring_cancel(r, handles[k], objs[k]) == 0) {
+          stress_bit_set(prod->cancelled,
+              (uintptr_t)objs[k] & ((1ULL << SEQ_BITS) - 1));
+          prod->cancelled_nb++;
+        }
+      }
+      return done;
+  }
+}
+
+/* list variant: the objects go in nodes from the pool of the producer */
+static unsigned int stress_enqueue_list(struct stress_thread *t, void **objs,
+    unsigned int n)
+{
+  struct stress_run *run = t->run;
+  void *nodes[MAX_BURST];
+  unsigned int i;
+
+  n = rte_ring_sc_dequeue_burst(run->prod[t->id].pool, nodes, n, NULL);
+  for (i = 0; i < n; i++)
+    ((struct stress_node *)nodes[i])->obj = objs[i];
+  if (stress_rand(&t->rng) % 2)
+    return rte_mpsc_enqueue_burst(&run->q, nodes, n, NULL);
+  for (i = 0; i < n; i++)
+    rte_mpsc_enqueue(&run->q, nodes[i]);
+  return n;
+}
+
+static void *stress_producer(void *arg)
+{
+  struct stress_thread *t = (struct stress_thread *)arg;
+  struct stress_run *run = t->run;
+  struct stress_producer *prod = &run->prod[t->id];
+  void *objs[MAX_BURST];
+  uint64_t seq = 0, ops = 0;
+  unsigned int i, n, done;
+
+  inject_rng = t->rng + 1;
+  while (!run->stop && seq < run->cfg->max_objs) {
+    n = 1 + stress_rand(&t->rng) % MAX_BURST;
+    if (n > run->cfg->max_objs - seq)
+      n = (unsigned int)(run->cfg->max_objs - seq);
+    for (i = 0; i < n; i++)
+      objs[i] = stress_obj(t->id, seq + i);
+    done = run->variant == VARIANT_LIST ?
+      stress_enqueue_list(t, objs, n) : stress_enqueue(t, objs, n);
+    seq += done;
+    prod->sent = seq;
+    ops++;
+    if (done == 0)
+      sched_yield();
+  }
+  __sync_add_and_fetch(&run->ops[1], ops);
+  __sync_add_and_fetch(&run->producers_done, 1);
+  return NULL;
+}
+
+/* apply visitor copying the objects out of the ring */
+struct stress_copy {
+  void **objs;
+  unsigned int n;
+};
+
+static void stress_apply_copy(void **objs, unsigned int n, void *ctx)
+{
+  struct stress_copy *c = (struct stress_copy *)ctx;
+
+  memcpy(c->objs + c->n, objs, n * sizeof(void *));
+  c->n += n;
+}
+
+/* classify key: the producer */
+static unsigned int stress_key(const void *obj, void *ctx)
+{
+  (void)ctx;
+  return (unsigned int)(((uintptr_t)obj >> SEQ_BITS) - 1) % NB_BINS;
+}
+
+static unsigned int stress_dequeue(struct stress_thread *t,
+    struct rte_ring *priv, int64_t *last)
+{
+  static const struct rte_ring_prefetch pf = { 64, 8, 1 };
+  struct stress_run *run = t->run;
+  struct rte_ring *r = run->r;
+  void *objs[MAX_BURST];
+  void *bin_objs[NB_BINS][MAX_BURST];
+  void **bins[NB_BINS];
+  unsigned int counts[NB_BINS];
+  struct stress_copy copy;
+  unsigned int op, n, got = 0, b;
+
+  op = stress_rand(&t->rng) % DEQ_MAX;
+  n = 1 + stress_rand(&t->rng) % MAX_BURST;
+
+  switch (op) {
+    case DEQ_BULK:
+      got = rte_ring_dequeue_bulk(r, objs, n, NULL);
+      break;
+    case DEQ_BURST:
+      got = rte_ring_dequeue_burst(r, objs, n, NULL);
+      break;
+    case DEQ_ONE:
+      got = rte_ring_dequeue(r, &objs[0]) == 0;
+      break;
+    case DEQ_PREFETCH:
+      /* the objects are not pointers, but prefetches do not fault */
+      got = rte_ring_dequeue_burst_prefetch(r, objs, n, NULL, &pf);
+      break;
+    case DEQ_APPLY:
+      copy.objs = objs;
+      copy.n = 0;
+      got = rte_ring_dequeue_burst_apply(r, n, stress_apply_copy, &copy,
+          NULL);
+      break;
+    case DEQ_CLASSIFY:
+      for (b = 0; b < NB_BINS; b++) {
+        bins[b] = bin_objs[b];
+        counts[b] = 0;
+      }
+      got = rte_ring_dequeue_burst_classify(r, n, stress_key, NULL, bins,
+          NB_BINS, counts, NULL);
+      for (b = 0; b < NB_BINS; b++)
+        stress_check(run, last, bin_objs[b], counts[b]);
+      return got;
+    default:
+      /* through a private ring, only read by this thread */
+      got = rte_ring_transfer(r, priv, n, stress_rand(&t->rng) % 2 ?
+          RTE_RING_QUEUE_FIXED : RTE_RING_QUEUE_VARIABLE);
+      n = rte_ring_dequeue_burst(priv, objs, MAX_BURST, NULL);
+      stress_check(run, last, objs, n);
+      return got;
+  }
+  stress_check(run, last, objs, got);
+  return got;
+}
+
+/* list variant: check the objects and give their nodes back */
+static unsigned int stress_dequeue_list(struct stress_thread *t,
+    int64_t *last)
+{
+  struct stress_run *run = t->run;
+  struct stress_node *node;
+  void *nodes[MAX_BURST];
+  void *objs[MAX_BURST];
+  unsigned int i, n, got;
+
+  n = 1 + stress_rand(&t->rng) % MAX_BURST;
+  if (stress_rand(&t->rng) % 2)
+    got = rte_mpsc_dequeue_burst(&run->q, nodes, n, NULL);
+  else
+    got = rte_mpsc_dequeue(&run->q, &nodes[0]) == 0;
+  for (i = 0; i < got; i++)
+    objs[i] = ((struct stress_node *)nodes[i])->obj;
+  stress_check(run, last, objs, got);
+  for (i = 0; i < got; i++) {
+    node = (struct stress_node *)nodes[i];
+    if (rte_ring_sp_enqueue(run->prod[node->owner].pool, node) != 0)
+      stress_error(run, "producer %u: node pool overflows", node->owner);
+  }
+  return got;
+}
+
+/* nothing left to dequeue, or being enqueued */
+static int stress_empty(struct stress_run *run)
+{
+  if (run->variant == VARIANT_LIST)
+    return rte_mpsc_empty(&run->q);
+  return rte_ring_empty(run->r);
+}
+
+static void *stress_consumer(void *arg)
+{
+  struct stress_thread *t = (struct stress_thread *)arg;
+  struct stress_run *run = t->run;
+  int64_t last[MAX_THREADS];
+  struct rte_ring *priv;
+  uint64_t ops = 0;
+  unsigned int i, done;
+
+  for (i = 0; i < MAX_THREADS; i++)
+    last[i] = -1;
+  /* half of the private rings are single-producer, which takes transfers
+   * from a multi-consumer or tombstone ring through a buffer; the other half
+   * refuse them, and only take the direct copy from a single-consumer ring */
+  priv = rte_ring_create(MAX_BURST, RING_F_EXACT_SZ |
+      (t->id % 2 ? RING_F_SP_ENQ | RING_F_SC_DEQ : 0));
+  if (priv == NULL) {
+    run->stop = 1;
+    __sync_add_and_fetch(&run->errors, 1);
+    return NULL;
+  }
+
+  inject_rng = t->rng + 1;
+  for (;;) {
+    /* read before dequeuing: the producers may be done once it is empty */
+    done = run->producers_done == run->producers;
+    if ((run->variant == VARIANT_LIST ? stress_dequeue_list(t, last) :
+          stress_dequeue(t, priv, last)) == 0) {
+      if (done && stress_empty(run))
+        break;
+      if (run->stop && run->errors)
+        break;
+      sched_yield();
+    }
+    ops++;
+  }
+  __sync_add_and_fetch(&run->ops[0], ops);
+  rte_ring_free(priv);
+  return NULL;
+}
+
+/* check that every object sent was delivered or cancelled, exactly once */
+static uint64_t stress_check_end(struct stress_run *run)
+{
+  const struct stress_producer *prod;
+  uint64_t w, words, full, d, c, total = 0;
+  unsigned int p;
+
+  words = (run->cfg->max_objs + 63) / 64;
+  for (p = 0; p < run->producers; p++) {
+    prod = &run->prod[p];
+    total += prod->sent;
+    for (w = 0; w < words; w++) {
+      d = prod->delivered[w];
+      c = prod->cancelled[w];
+      if (w * 64 + 64 <= prod->sent)
+        full = ~0ULL;
+      else if (w * 64 >= prod->sent)
+        full = 0;
+      else
+        full = (1ULL << (prod->sent % 64)) - 1;
+      if ((d & c) != 0)
+        stress_error(run, "producer %u: cancelled seq %" PRIu64
+            " delivered", p, w * 64 + __builtin_ctzll(d & c));
+      if (((d | c) & ~full) != 0)
+        stress_error(run, "producer %u: seq %" PRIu64 " delivered, only %"
+            PRIu64 " sent", p, w * 64 + __builtin_ctzll((d | c) & ~full),
+            prod->sent);
+      if (((d | c) & full) != full)
+        stress_error(run, "producer %u: seq %" PRIu64 " lost", p,
+            w * 64 + __builtin_ctzll(~(d | c) & full));
+    }
+  }
+
+  if (run->variant == VARIANT_LIST) {
+    if (!rte_mpsc_empty(&run->q))
+      stress_error(run, "list not empty at the end");
+    for (p = 0; p < run->producers; p++)
+      if (rte_ring_count(run->prod[p].pool) != run->cfg->size)
+        stress_error(run, "producer %u: %u nodes of %u in the pool", p,
+            rte_ring_count(run->prod[p].pool), run->cfg->size);
+    return total;
+  }
+
+  if (run->r->prod.head != run->r->prod.tail ||
+      run->r->cons.head != run->r->cons.tail ||
+      run->r->prod.tail != run->r->cons.tail)
+    stress_error(run, "indexes differ at the end: prod %u/%u, cons %u/%u",
+        run->r->prod.head, run->r->prod.tail, run->r->cons.head,
+        run->r->cons.tail);
+
+  if (run->variant == VARIANT_SOJOURN) {
+    struct rte_ring_sojourn st;
+
+    /* no cancellations here, every slot held an object */
+    rte_ring_sojourn_get(run->r, &st);
+    if (st.count != total)
+      stress_error(run, "sojourn of %" PRIu64 " slots, %" PRIu64
+          " enqueued", st.count, total);
+  }
+  return total;
+}
+
+/* fill the node pool of a producer of the list variant */
+static int stress_pool_init(struct stress_producer *prod, unsigned int id,
+    unsigned int size)
+{
+  unsigned int i;
+
+  prod->pool = rte_ring_create(size, RING_F_EXACT_SZ | RING_F_SP_ENQ |
+      RING_F_SC_DEQ);
+  prod->nodes = (struct stress_node *)calloc(size,
+      sizeof(struct stress_node));
+  if (prod->pool == NULL || prod->nodes == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return -1;
+  }
+  for (i = 0; i < size; i++) {
+    prod->nodes[i].owner = id;
+    rte_ring_sp_enqueue(prod->pool, &prod->nodes[i]);
+  }
+  return 0;
+}
+
+/* run a mode and variant, return 0 if it passed */
+static int stress_run_one(const struct stress_config *cfg, unsigned int mode,
+    enum stress_variant variant)
+{
+  static struct stress_thread threads[2 * MAX_THREADS];
+  static struct stress_run run;
+  const char *name = mode_names[mode];
+  uint64_t words, total, cancelled = 0, start, end;
+  struct timespec ts;
+  unsigned int flags = 0, count, nb, i, elapsed_ms, tick_us;
+
+  memset(&run, 0, sizeof(run));
+  run.cfg = cfg;
+  run.variant = variant;
+  run.sp = name[0] == 's';
+  run.producers = run.sp ? 1 : cfg->producers;
+  run.consumers = name[2] == 's' ? 1 : cfg->consumers;
+
+  if (run.sp)
+    flags |= RING_F_SP_ENQ;
+  if (name[2] == 's')
+    flags |= RING_F_SC_DEQ;
+  count = cfg->size;
+  if (variant == VARIANT_EXACT) {
+    /* an odd capacity, so that wrap-arounds fall anywhere */
+    flags |= RING_F_EXACT_SZ;
+    count = cfg->size - cfg->size / 4 + 1;
+  } else if (variant == VARIANT_TOMBSTONE) {
+    flags |= RING_F_TOMBSTONE;
+  } else if (variant == VARIANT_SOJOURN) {
+    flags |= RING_F_SOJOURN;
+  }
+  if (variant == VARIANT_LIST) {
+    rte_mpsc_init(&run.q, offsetof(struct stress_node, link));
+    count = cfg->size;
+  } else {
+    run.r = rte_ring_create(count, flags);
+    if (run.r == NULL)
+      return -1;
+    count = run.r->capacity;
+  }
+
+  words = (cfg->max_objs + 63) / 64;
+  for (i = 0; i < run.producers; i++) {
+    run.prod[i].delivered = (uint64_t *)calloc(words, sizeof(uint64_t));
+    run.prod[i].cancelled = (uint64_t *)calloc(words, sizeof(uint64_t));
+    if (run.prod[i].delivered == NULL || run.prod[i].cancelled == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+    if (variant == VARIANT_LIST && stress_pool_init(&run.prod[i], i,
+          cfg->size) != 0)
+      exit(1);
+  }
+
+  nb = run.producers + run.consumers;
+  start = rte_rdtsc();
+  for (i = 0; i < nb; i++) {
+    threads[i].run = &run;
+    threads[i].id = i < run.producers ? i : i - run.producers;
+    threads[i].rng = (cfg->seed + 1) * 0x9e3779b97f4a7c15ULL ^
+      ((uint64_t)(mode * VARIANT_MAX + variant) << 32) ^ (i + 1);
+    if (pthread_create(&threads[i].tid, NULL, i < run.producers ?
+          stress_producer : stress_consumer, &threads[i]) != 0) {
+      fprintf(stderr, "Cannot create thread %u\n", i);
+      exit(1);
+    }
+  }
+
+  /* let it run, signalling random threads if asked to */
+  tick_us = cfg->inject == INJECT_SIGNAL ? cfg->period : 10000;
+  ts.tv_sec = tick_us / 1000000;
+  ts.tv_nsec = (tick_us % 1000000) * 1000L;
+  for (elapsed_ms = 0; run.producers_done < run.producers &&
+      elapsed_ms < cfg->seconds * 1000;
+      elapsed_ms = (unsigned int)((rte_rdtsc() - start) /
+        (rte_get_tsc_hz() / 1000))) {
+    nanosleep(&ts, NULL);
+    if (cfg->inject == INJECT_SIGNAL)
+      pthread_kill(threads[rand() % nb].tid, SIGUSR1);
+  }
+  run.stop = 1;
+  for (i = 0; i < nb; i++)
+    pthread_join(threads[i].tid, NULL);
+  end = rte_rdtsc();
+
+  total = stress_check_end(&run);
+  for (i = 0; i < run.producers; i++) {
+    cancelled += run.prod[i].cancelled_nb;
+    free(run.prod[i].delivered);
+    free(run.prod[i].cancelled);
+    rte_ring_free(run.prod[i].pool);
+    free(run.prod[i].nodes);
+  }
+  printf("%-5s %-9s %5u %5u %6u %14" PRIu64 " %10" PRIu64 " %10.2f  %s\n",
+      name, variant_names[variant], run.producers, run.consumers,
+      count, total, cancelled,
+      total / ((double)(end - start) / rte_get_tsc_hz()) / 1e6,
+      run.errors ? "FAIL" : "ok");
+  fflush(stdout);
+  rte_ring_free(run.r);
+  return run.errors ? -1 : 0;
+}
+
+/* parse a comma separated list of names into a bit mask */
+static int parse_names(const char *list, const char * const *names,
+    unsigned int nb, unsigned int *mask)
+{
+  const char *end;
+  unsigned int i;
+  size_t len;
+
+  *mask = 0;
+  while (*list != '\0') {
+    end = strchr(list, ',');
+    len = end != NULL ? (size_t)(end - list) : strlen(list);
+    for (i = 0; i < nb; i++)
+      if (strlen(names[i]) == len && strncmp(names[i], list, len) == 0)
+        break;
+    if (i == nb)
+      return -1;
+    *mask |= 1u << i;
+    list += len + (end != NULL);
+  }
+  return *mask ? 0 : -1;
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+      "Usage: %s [-s size] [-p producers] [-c consumers] [-t seconds] "
+      "[-n objects] [-m modes] [-v variants] [-i inject] [-f period] "
+      "[-d delay] [-S seed]\n"
+      "  -s  ring size, or list nodes per producer, a power of 2 (default\n"
+      "      64, small to wrap often)\n"
+      "  -p  producer threads of the mp modes (default 8, max %d)\n"
+      "  -c  consumer threads of the mc modes (default 8, max %d)\n"
+      "  -t  seconds per run (default 10)\n"
+      "  -n  objects per producer at most (default 16777216)\n"
+      "  -m  modes among spsc,spmc,mpsc,mpmc (default all)\n"
+      "  -v  variants among plain,exact,tombstone,sojourn,list (default\n"
+      "      all, list in the single consumer modes only)\n"
+      "  -i  delays injected: none, yield or delay (between head and tail\n"
+      "      moves, needs RTE_RING_DEBUG_PREEMPT), or signal (default none)\n"
+      "  -f  inject about every this many tail updates (default 64), or\n"
+      "      signal a random thread every this many microseconds (1000)\n"
+      "  -d  microseconds of a delay or a signal stall (default 50)\n"
+      "  -S  random seed (default 1)\n",
+      prog, MAX_THREADS, MAX_THREADS);
+}
+
+int main(int argc, char **argv)
+{
+  struct stress_config cfg = { 64, 8, 8, 10, 1ULL << 24, INJECT_NONE, 0, 50,
+    1, (1u << NB_MODES) - 1, (1u << VARIANT_MAX) - 1 };
+  unsigned int m, v, failed = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:p:c:t:n:m:v:i:f:d:S:h")) != -1) {
+    switch (opt) {
+      case 's': cfg.size = atoi(optarg); break;
+      case 'p': cfg.producers = atoi(optarg); break;
+      case 'c': cfg.consumers = atoi(optarg); break;
+      case 't': cfg.seconds = atoi(optarg); break;
+      case 'n': cfg.max_objs = strtoull(optarg, NULL, 0); break;
+      case 'm':
+        if (parse_names(optarg, mode_names, NB_MODES, &cfg.modes) != 0) {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'v':
+        if (parse_names(optarg, variant_names, VARIANT_MAX,
+              &cfg.variants) != 0) {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'i':
+        if (strcmp(optarg, "yield") == 0)
+          cfg.inject = INJECT_YIELD;
+        else if (strcmp(optarg, "delay") == 0)
+          cfg.inject = INJECT_DELAY;
+        else if (strcmp(optarg, "signal") == 0)
+          cfg.inject = INJECT_SIGNAL;
+        else if (strcmp(optarg, "none") == 0)
+          cfg.inject = INJECT_NONE;
+        else {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'f': cfg.period = atoi(optarg); break;
+      case 'd': cfg.delay_us = atoi(optarg); break;
+      case 'S': cfg.seed = strtoull(optarg, NULL, 0); break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (!POWEROF2(cfg.size) || cfg.size < 4 || cfg.producers == 0 ||
+      cfg.producers > MAX_THREADS || cfg.consumers == 0 ||
+      cfg.consumers > MAX_THREADS || cfg.max_objs == 0 ||
+      cfg.max_objs >= 1ULL << SEQ_BITS) {
+    usage(argv[0]);
+    return 1;
+  }
+#ifdef RTE_RING_DEBUG_PREEMPT
+  if (cfg.inject == INJECT_YIELD)
+    rte_ring_preempt_hook = stress_preempt_yield;
+  else if (cfg.inject == INJECT_DELAY)
+    rte_ring_preempt_hook = stress_preempt_delay;
+#else
+  if (cfg.inject == INJECT_YIELD || cfg.inject == INJECT_DELAY) {
+    fprintf(stderr, "-i %s needs a build with RTE_RING_DEBUG_PREEMPT\n",
+        cfg.inject == INJECT_YIELD ? "yield" : "delay");
+    return 1;
+  }
+#endif
+  if (cfg.period == 0)
+    cfg.period = cfg.inject == INJECT_SIGNAL ? 1000 : 64;
+  inject_period = cfg.period;
+  inject_delay_us = cfg.delay_us;
+  if (cfg.inject == INJECT_SIGNAL)
+    signal(SIGUSR1, stress_preempt_signal);
+  srand((unsigned int)cfg.seed);
+
+  printf("%-5s %-9s %5s %5s %6s %14s %10s %10s  %s\n", "mode", "variant",
+      "prod", "cons", "cap", "objects", "cancelled", "Mobjs/s", "result");
+  for (m = 0; m < NB_MODES; m++)
+    for (v = 0; v < VARIANT_MAX; v++)
+      if ((cfg.modes & (1u << m)) && (cfg.variants & (1u << v)) &&
+          (v != VARIANT_LIST || mode_names[m][2] == 's') &&
+          stress_run_one(&cfg, m, (enum stress_variant)v) != 0)
+        failed++;
+
+  printf("%u run%s failed\n", failed, failed == 1 ? "" : "s");
+  return failed ? 1 : 0;
+}
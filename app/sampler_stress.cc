@@ -0,0 +1,412 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * @file
+ * Ring sampler test
+ *
+ * Checks rte_ring_sampler.h against rings whose depth is known:
+ *
+ * - still rings: an empty ring and a full one, sampled a few times, must be
+ *   seen empty and full every time, and the full one reported saturated;
+ * - moving rings: threads enqueue a burst of at most -b objects and dequeue
+ *   as many, over and over, so that each ring holds at most threads times
+ *   -b objects, well below its capacity, while a thread samples them in a
+ *   loop. The sampler must never see them full nor deeper than that
+ *   bound, every sample must be in the histogram, and the recommended size
+ *   must hold the peak;
+ * - the background thread, started and stopped while the threads run, must
+ *   have sampled the rings.
+ *
+ * The sampler reads the two tails of a ring one after the other, and the
+ * moving rings wrap all the time in between: a thread stalled there sees
+ * the consumers move on. Signals stalling random threads, the sampler
+ * included, make that more likely.
+ *
+ * Usage: sampler_stress [options], see usage(). The exit status is 1 if
+ * any check failed.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+
+#include <my_global.h>
+
+#include <rte_common.h>
+#include "rte_ring.h"
+#include "rte_ring_sampler.h"
+
+#define MAX_RINGS 16
+#define MAX_THREADS 64               /* per ring */
+#define MAX_BURST 64
+#define MAX_ERRORS 16
+#define STILL_SAMPLES 8
+
+/* injected delays */
+enum stress_inject {
+  INJECT_NONE,
+  INJECT_SIGNAL,           /* signals stalling random threads */
+};
+
+struct stress_config {
+  unsigned int size;
+  unsigned int rings;
+  unsigned int threads;    /* per ring */
+  unsigned int burst;
+  unsigned int seconds;
+  enum stress_inject inject;
+  unsigned int period;
+  unsigned int delay_us;
+  uint64_t seed;
+};
+
+/* a thread moving objects through a ring */
+struct stress_thread {
+  struct rte_ring *r;
+  const struct stress_config *cfg;
+  pthread_t tid;
+  uint64_t rng;
+  volatile uint64_t moved;
+};
+
+/* the thread sampling the moving rings */
+struct stress_sampler {
+  struct rte_ring_sampler *s;
+  pthread_t tid;
+  volatile uint64_t samples;
+};
+
+static volatile unsigned int stop;
+static unsigned int errors;
+static unsigned int inject_delay_us;
+static uint64_t tsc_hz;          /* rte_get_tsc_hz() takes 100 ms */
+
+static uint64_t stress_rand(uint64_t *s)
+{
+  *s ^= *s << 13;
+  *s ^= *s >> 7;
+  *s ^= *s << 17;
+  return *s;
+}
+
+/* stall the interrupted thread, wherever it was */
+static void stress_preempt_signal(int sig)
+{
+  struct timespec ts;
+
+  (void)sig;
+  ts.tv_sec = inject_delay_us / 1000000;
+  ts.tv_nsec = (inject_delay_us % 1000000) * 1000L;
+  nanosleep(&ts, NULL);
+}
+
+static void stress_error(const char *fmt, ...)
+{
+  va_list ap;
+
+  if (++errors <= MAX_ERRORS) {
+    va_start(ap, fmt);
+    printf("  error: ");
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+  }
+}
+
+/* enqueue a burst and dequeue as many, so the ring never holds more */
+static void *stress_mover(void *arg)
+{
+  struct stress_thread *t = (struct stress_thread *)arg;
+  void *objs[MAX_BURST];
+  unsigned int i, n, got;
+
+  for (i = 0; i < MAX_BURST; i++)
+    objs[i] = (void *)(uintptr_t)(i + 1);
+  while (!stop) {
+    n = 1 + stress_rand(&t->rng) % t->cfg->burst;
+    n = rte_ring_enqueue_burst(t->r, objs, n, NULL);
+    for (got = 0; got < n;)
+      got += rte_ring_dequeue_burst(t->r, objs + got, n - got, NULL);
+    t->moved += n;
+  }
+  return NULL;
+}
+
+/* sample in a loop, where signals can stall it between two reads */
+static void *stress_sample(void *arg)
+{
+  struct stress_sampler *smp = (struct stress_sampler *)arg;
+
+  while (!stop) {
+    rte_ring_sampler_sample(smp->s);
+    smp->samples++;
+  }
+  return NULL;
+}
+
+/* the checks every sampled ring passes */
+static void stress_check_stats(const char *name, const struct rte_ring *r,
+    const struct rte_ring_sampler_stats *st, uint32_t bound)
+{
+  uint64_t hist = 0;
+  unsigned int b;
+
+  for (b = 0; b < RTE_RING_SAMPLER_HIST; b++)
+    hist += st->hist[b];
+  if (hist != st->samples)
+    stress_error("%s: %" PRIu64 " samples, %" PRIu64 " in the histogram",
+        name, st->samples, hist);
+  if (st->capacity != r->capacity)
+    stress_error("%s: capacity %u, the ring has %u", name, st->capacity,
+        r->capacity);
+  if (st->peak > bound)
+    stress_error("%s: peak %u, the ring never held more than %u", name,
+        st->peak, bound);
+  if (bound < r->capacity && st->full != 0)
+    stress_error("%s: seen full %" PRIu64 " times, the ring never held "
+        "more than %u of %u", name, st->full, bound, r->capacity);
+  if (st->depth_sum > st->samples * (uint64_t)st->peak)
+    stress_error("%s: depth sum %" PRIu64 " above %" PRIu64 " samples of "
+        "at most %u", name, st->depth_sum, st->samples, st->peak);
+}
+
+/* an empty ring and a full one */
+static void stress_still(void)
+{
+  struct rte_ring_sampler_stats st;
+  struct rte_ring_sampler *s;
+  struct rte_ring *empty, *full;
+  void *obj = NULL;
+  unsigned int i;
+
+  s = rte_ring_sampler_create(1000);
+  empty = rte_ring_create(16, 0);
+  full = rte_ring_create(16, RING_F_EXACT_SZ);
+  if (s == NULL || empty == NULL || full == NULL) {
+    stress_error("cannot create the still rings");
+    goto end;
+  }
+  while (rte_ring_enqueue(full, obj) == 0)
+    ;
+  if (rte_ring_sampler_register(s, empty, "empty") != 0 ||
+      rte_ring_sampler_register(s, full, "full") != 0)
+    stress_error("cannot register the still rings");
+  if (rte_ring_sampler_register(s, full, "again") != -EEXIST)
+    stress_error("full: registered twice");
+  for (i = 0; i < STILL_SAMPLES; i++)
+    rte_ring_sampler_sample(s);
+
+  if (rte_ring_sampler_get_stats(s, empty, &st) != 0)
+    stress_error("empty: no statistics");
+  stress_check_stats("empty", empty, &st, 0);
+  if (st.samples != STILL_SAMPLES || st.empty != STILL_SAMPLES)
+    stress_error("empty: %" PRIu64 " samples, %" PRIu64 " empty, expected "
+        "%u", st.samples, st.empty, STILL_SAMPLES);
+  if (rte_ring_sampler_recommend(empty, &st) == 0)
+    stress_error("empty: reported saturated");
+
+  if (rte_ring_sampler_get_stats(s, full, &st) != 0)
+    stress_error("full: no statistics");
+  stress_check_stats("full", full, &st, full->capacity);
+  if (st.samples != STILL_SAMPLES || st.full != STILL_SAMPLES ||
+      st.peak != full->capacity)
+    stress_error("full: %" PRIu64 " samples, %" PRIu64 " full, peak %u, "
+        "expected %u full at %u", st.samples, st.full, st.peak,
+        STILL_SAMPLES, full->capacity);
+  if (rte_ring_sampler_recommend(full, &st) != 0)
+    stress_error("full: not reported saturated");
+
+  if (rte_ring_sampler_unregister(s, full) != 0 ||
+      rte_ring_sampler_unregister(s, full) != -ENOENT ||
+      rte_ring_sampler_get_stats(s, full, &st) != -ENOENT)
+    stress_error("full: still registered after unregistering it");
+
+end:
+  rte_ring_sampler_free(s);
+  rte_ring_free(empty);
+  rte_ring_free(full);
+  printf("%-8s %5s %5u %14u %10s  %s\n", "still", "-", 2, STILL_SAMPLES,
+      "-", errors ? "FAIL" : "ok");
+}
+
+/* rings moving under the sampler thread, then under a thread of ours */
+static void stress_moving(const struct stress_config *cfg)
+{
+  static struct stress_thread threads[MAX_RINGS * MAX_THREADS];
+  const unsigned int nb = cfg->rings * cfg->threads;
+  const uint32_t bound = cfg->threads * cfg->burst;
+  struct rte_ring_sampler_stats st;
+  struct rte_ring *rings[MAX_RINGS];
+  struct rte_ring_sampler *s;
+  struct stress_sampler smp;
+  struct timespec ts;
+  uint64_t start, background = 0;
+  char name[RTE_RING_SAMPLER_NAMESIZE];
+  unsigned int i, tick_us, before = errors;
+
+  s = rte_ring_sampler_create(100);
+  if (s == NULL) {
+    stress_error("cannot create the sampler");
+    return;
+  }
+  for (i = 0; i < cfg->rings; i++) {
+    rings[i] = rte_ring_create(cfg->size, 0);
+    if (rings[i] == NULL) {
+      fprintf(stderr, "Cannot create ring %u\n", i);
+      exit(1);
+    }
+    snprintf(name, sizeof(name), "moving%u", i);
+    if (rte_ring_sampler_register(s, rings[i], name) != 0)
+      stress_error("%s: cannot register it", name);
+  }
+
+  stop = 0;
+  for (i = 0; i < nb; i++) {
+    threads[i].r = rings[i / cfg->threads];
+    threads[i].cfg = cfg;
+    threads[i].moved = 0;
+    threads[i].rng = (cfg->seed + 1) * 0x9e3779b97f4a7c15ULL ^ (i + 1);
+    if (pthread_create(&threads[i].tid, NULL, stress_mover,
+          &threads[i]) != 0) {
+      fprintf(stderr, "Cannot create thread %u\n", i);
+      exit(1);
+    }
+  }
+
+  /* the first half with the background thread, then from here */
+  if (rte_ring_sampler_start(s) != 0)
+    stress_error("cannot start the sampler thread");
+  if (rte_ring_sampler_start(s) != -EBUSY)
+    stress_error("sampler thread started twice");
+  ts.tv_sec = cfg->seconds / 2;
+  ts.tv_nsec = cfg->seconds % 2 * 500000000L;
+  nanosleep(&ts, NULL);
+  rte_ring_sampler_stop(s);
+  for (i = 0; i < cfg->rings; i++)
+    if (rte_ring_sampler_get_stats(s, rings[i], &st) == 0)
+      background += st.samples;
+  if (background == 0)
+    stress_error("the sampler thread took no sample");
+
+  smp.s = s;
+  smp.samples = 0;
+  if (pthread_create(&smp.tid, NULL, stress_sample, &smp) != 0) {
+    fprintf(stderr, "Cannot create the sampling thread\n");
+    exit(1);
+  }
+  tick_us = cfg->inject == INJECT_SIGNAL ? cfg->period : 10000;
+  ts.tv_sec = tick_us / 1000000;
+  ts.tv_nsec = (tick_us % 1000000) * 1000L;
+  start = rte_rdtsc();
+  while (rte_rdtsc() - start < cfg->seconds * tsc_hz / 2) {
+    nanosleep(&ts, NULL);
+    /* the sampling thread gets one signal in two */
+    if (cfg->inject == INJECT_SIGNAL)
+      pthread_kill(rand() % 2 ? smp.tid : threads[rand() % nb].tid,
+          SIGUSR1);
+  }
+  stop = 1;
+  for (i = 0; i < nb; i++)
+    pthread_join(threads[i].tid, NULL);
+  pthread_join(smp.tid, NULL);
+
+  for (i = 0; i < cfg->rings; i++) {
+    snprintf(name, sizeof(name), "moving%u", i);
+    if (rte_ring_sampler_get_stats(s, rings[i], &st) != 0) {
+      stress_error("%s: no statistics", name);
+      continue;
+    }
+    stress_check_stats(name, rings[i], &st, bound);
+    if (rte_ring_sampler_recommend(rings[i], &st) <= st.peak)
+      stress_error("%s: recommended count %u for a peak of %u", name,
+          rte_ring_sampler_recommend(rings[i], &st), st.peak);
+  }
+  if (errors != before)
+    rte_ring_sampler_dump(s, stdout);
+
+  rte_ring_sampler_free(s);
+  for (i = 0; i < cfg->rings; i++)
+    rte_ring_free(rings[i]);
+  printf("%-8s %5u %5u %14" PRIu64 " %10u  %s\n", "moving", cfg->threads,
+      cfg->rings, smp.samples + background, bound,
+      errors != before ? "FAIL" : "ok");
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+      "Usage: %s [-s size] [-r rings] [-c threads] [-b burst] [-t seconds] "
+      "[-i inject] [-f period] [-d delay] [-S seed]\n"
+      "  -s  ring size, a power of 2 (default 64)\n"
+      "  -r  moving rings (default 2, max %d)\n"
+      "  -c  threads per moving ring (default 4, max %d)\n"
+      "  -b  most objects a thread holds in its ring (default 8, max %d),\n"
+      "      the threads of a ring holding less than its capacity\n"
+      "  -t  seconds of the moving rings (default 4)\n"
+      "  -i  delays injected: none or signal (default none)\n"
+      "  -f  signal a random thread every this many microseconds (1000)\n"
+      "  -d  microseconds of a signal stall (default 50)\n"
+      "  -S  random seed (default 1)\n",
+      prog, MAX_RINGS, MAX_THREADS, MAX_BURST);
+}
+
+int main(int argc, char **argv)
+{
+  struct stress_config cfg = { 64, 2, 4, 8, 4, INJECT_NONE, 1000, 50, 1 };
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:r:c:b:t:i:f:d:S:h")) != -1) {
+    switch (opt) {
+      case 's': cfg.size = atoi(optarg); break;
+      case 'r': cfg.rings = atoi(optarg); break;
+      case 'c': cfg.threads = atoi(optarg); break;
+      case 'b': cfg.burst = atoi(optarg); break;
+      case 't': cfg.seconds = atoi(optarg); break;
+      case 'i':
+        if (strcmp(optarg, "signal") == 0)
+          cfg.inject = INJECT_SIGNAL;
+        else if (strcmp(optarg, "none") == 0)
+          cfg.inject = INJECT_NONE;
+        else {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'f': cfg.period = atoi(optarg); break;
+      case 'd': cfg.delay_us = atoi(optarg); break;
+      case 'S': cfg.seed = strtoull(optarg, NULL, 0); break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+    }
+  }
+  /* the threads of a ring must not be able to fill it */
+  if (!POWEROF2(cfg.size) || cfg.rings == 0 || cfg.rings > MAX_RINGS ||
+      cfg.threads == 0 || cfg.threads > MAX_THREADS || cfg.burst == 0 ||
+      cfg.burst > MAX_BURST || cfg.threads * cfg.burst >= cfg.size - 1 ||
+      cfg.seconds == 0 || cfg.period == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  inject_delay_us = cfg.delay_us;
+  if (cfg.inject == INJECT_SIGNAL)
+    signal(SIGUSR1, stress_preempt_signal);
+  srand((unsigned int)cfg.seed);
+  tsc_hz = rte_get_tsc_hz();
+
+  printf("%-8s %5s %5s %14s %10s  %s\n", "test", "thr", "rings",
+      "samples", "bound", "result");
+  stress_still();
+  stress_moving(&cfg);
+
+  printf("%u error%s\n", errors, errors == 1 ? "" : "s");
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,569 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * @file
+ * Completion token torture test
+ *
+ * Clients send requests to servers through a ring with the completion
+ * tokens of rte_ring_token.h and wait for each result before sending the
+ * next request, with more threads than the machine has CPUs, in four waits:
+ *
+ * - sleep: rte_ring_token_wait() with no spins, which announces the sleep
+ *   and waits on the futex from the first poll, half of the time after a
+ *   yield that lets the server complete the token just before the sleep;
+ * - hybrid: a few spins, then the futex;
+ * - spin: spins only;
+ * - poll: rte_ring_token_poll() between sched_yield() calls.
+ *
+ * The pool has fewer tokens than there are clients, so that requests find
+ * it exhausted and every token is recycled all the time, and servers hold
+ * back some completions so that they find the client asleep. Each client
+ * checks the result of every request, and that no other client holds its
+ * token meanwhile; each server checks the requests it serves. The end of
+ * the run checks that every request was served once, that every token is
+ * back in the pool, and that the sleep wait did go through the futex. A
+ * watchdog fails the run when no request completes for a while, which
+ * catches lost wake-ups.
+ *
+ * Before the threads start, the pool is drained and refilled: it must hand
+ * out each token once, then report that it is exhausted.
+ *
+ * Delays can be injected anywhere with signals.
+ *
+ * Usage: token_stress [options], see usage(). The exit status is 1 if any
+ * run failed.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+
+#include <my_global.h>
+
+#include <rte_common.h>
+#include "rte_ring.h"
+#include "rte_ring_token.h"
+
+#define MAX_THREADS 256
+#define MAX_TOKENS 1024
+#define MAX_BURST 16
+#define MAX_ERRORS 16                /* reported per run */
+#define HYBRID_SPINS 64              /* polls of the hybrid wait */
+
+/* injected delays */
+enum stress_inject {
+  INJECT_NONE,
+  INJECT_SIGNAL,           /* signals stalling random threads */
+};
+
+enum stress_wait {
+  WAIT_SLEEP,
+  WAIT_HYBRID,
+  WAIT_SPIN,
+  WAIT_POLL,
+  WAIT_MAX
+};
+
+static const char * const wait_names[WAIT_MAX] = {
+  "sleep", "hybrid", "spin", "poll"
+};
+
+struct stress_config {
+  unsigned int size;
+  unsigned int clients;
+  unsigned int servers;
+  unsigned int tokens;
+  unsigned int seconds;
+  unsigned int watchdog;   /* seconds without progress */
+  enum stress_inject inject;
+  unsigned int period;
+  unsigned int delay_us;
+  uint64_t seed;
+  unsigned int waits;      /* bit mask of wait_names */
+};
+
+/* the request in flight of a client */
+struct stress_request {
+  unsigned int client;
+  uint64_t seq;
+};
+
+/* state shared by the threads of one run */
+struct stress_run {
+  const struct stress_config *cfg;
+  struct rte_ring *r;
+  struct rte_ring_token_pool *pool;
+  enum stress_wait wait;
+  volatile unsigned int stop;
+  volatile unsigned int clients_done;
+  volatile unsigned int finished;
+  volatile unsigned int errors;
+  volatile uint64_t served;
+  volatile uint64_t woken;       /* completions that found a sleeper */
+  volatile uint64_t exhausted;   /* requests refused for lack of token */
+  volatile unsigned int holder[MAX_TOKENS]; /* client + 1, 0 if free */
+  struct stress_request req[MAX_THREADS];
+};
+
+/* a thread of a run */
+struct stress_thread {
+  struct stress_run *run;
+  unsigned int id;
+  pthread_t tid;
+  uint64_t rng;
+  volatile uint64_t ops;   /* requests completed, for the watchdog */
+};
+
+static unsigned int inject_delay_us;
+static uint64_t tsc_hz;          /* rte_get_tsc_hz() takes 100 ms */
+
+static uint64_t stress_rand(uint64_t *s)
+{
+  *s ^= *s << 13;
+  *s ^= *s >> 7;
+  *s ^= *s << 17;
+  return *s;
+}
+
+/* stall the interrupted thread, wherever it was */
+static void stress_preempt_signal(int sig)
+{
+  struct timespec ts;
+
+  (void)sig;
+  ts.tv_sec = inject_delay_us / 1000000;
+  ts.tv_nsec = (inject_delay_us % 1000000) * 1000L;
+  nanosleep(&ts, NULL);
+}
+
+static void stress_error(struct stress_run *run, const char *fmt, ...)
+{
+  va_list ap;
+
+  if (__sync_add_and_fetch(&run->errors, 1) <= MAX_ERRORS) {
+    va_start(ap, fmt);
+    printf("  error: ");
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+  }
+  run->stop = 1;
+}
+
+/* the result a server computes for a request */
+static uint64_t stress_result(unsigned int client, uint64_t seq)
+{
+  return ((uint64_t)client << 48) ^ (seq * 0x9e3779b97f4a7c15ULL);
+}
+
+static unsigned int stress_token_index(const struct stress_run *run,
+    const struct rte_ring_token *tok)
+{
+  return (unsigned int)(tok - run->pool->tokens);
+}
+
+/* wait for a token as the run asks */
+static uint64_t stress_wait_token(struct stress_run *run,
+    struct rte_ring_token *tok, uint64_t *rng)
+{
+  uint64_t result;
+
+  switch (run->wait) {
+    case WAIT_SLEEP:
+      /* half of the time, let the completion land between the poll and the
+       * sleep of rte_ring_token_wait(), a window too short to hit
+       * otherwise: the sleep must then see the token done */
+      if (stress_rand(rng) % 2 && rte_ring_token_poll(tok, &result) != 0) {
+        sched_yield();
+        __rte_ring_token_sleep(tok);
+      }
+      return rte_ring_token_wait(tok, 0);
+    case WAIT_HYBRID:
+      return rte_ring_token_wait(tok, HYBRID_SPINS);
+    case WAIT_SPIN:
+      return rte_ring_token_wait(tok, UINT_MAX);
+    default:
+      while (rte_ring_token_poll(tok, &result) != 0)
+        sched_yield();
+      return result;
+  }
+}
+
+static void *stress_client(void *arg)
+{
+  struct stress_thread *t = (struct stress_thread *)arg;
+  struct stress_run *run = t->run;
+  struct stress_request *req = &run->req[t->id];
+  struct rte_ring_token *tok;
+  uint64_t seq = 0, exhausted = 0, result;
+  unsigned int idx;
+
+  req->client = t->id;
+  while (!run->stop) {
+    req->seq = seq;
+    tok = rte_ring_request_enqueue(run->r, run->pool, req);
+    if (tok == NULL) {
+      /* the ring has room for every token: the pool is exhausted */
+      exhausted++;
+      sched_yield();
+      continue;
+    }
+    idx = stress_token_index(run, tok);
+    if (idx >= run->pool->count) {
+      stress_error(run, "client %u: token %p is not from the pool", t->id,
+          (void *)tok);
+      break;
+    }
+    if (!__sync_bool_compare_and_swap(&run->holder[idx], 0, t->id + 1))
+      stress_error(run, "client %u: token %u held by client %u", t->id,
+          idx, run->holder[idx] - 1);
+
+    result = stress_wait_token(run, tok, &t->rng);
+    if (result != stress_result(t->id, seq))
+      stress_error(run, "client %u: seq %" PRIu64 " got %" PRIx64
+          ", expected %" PRIx64, t->id, seq, result,
+          stress_result(t->id, seq));
+    if (tok->state != RTE_RING_TOKEN_DONE)
+      stress_error(run, "client %u: token %u in state %u after the wait",
+          t->id, idx, tok->state);
+
+    run->holder[idx] = 0;
+    rte_ring_token_put(run->pool, tok);
+    seq++;
+    t->ops = seq;
+  }
+  __sync_add_and_fetch(&run->exhausted, exhausted);
+  __sync_add_and_fetch(&run->clients_done, 1);
+  __sync_add_and_fetch(&run->finished, 1);
+  return NULL;
+}
+
+/* serve until the clients are done and the ring is empty */
+static void *stress_server(void *arg)
+{
+  struct stress_thread *t = (struct stress_thread *)arg;
+  struct stress_run *run = t->run;
+  const struct stress_request *req;
+  struct rte_ring_token *tok;
+  void *toks[MAX_BURST];
+  uint64_t served = 0, woken = 0;
+  unsigned int i, n, done;
+
+  for (;;) {
+    /* read before dequeuing: the clients may be done once it is empty */
+    done = run->clients_done == run->cfg->clients;
+    n = rte_ring_dequeue_burst(run->r, toks,
+        1 + stress_rand(&t->rng) % MAX_BURST, NULL);
+    if (n == 0) {
+      if (done && rte_ring_empty(run->r))
+        break;
+      sched_yield();
+      continue;
+    }
+    for (i = 0; i < n; i++) {
+      tok = (struct rte_ring_token *)toks[i];
+      req = (const struct stress_request *)rte_ring_token_request(tok);
+      if (req == NULL || req->client >= run->cfg->clients) {
+        stress_error(run, "server %u: invalid request %p on token %u",
+            t->id, (const void *)req, stress_token_index(run, tok));
+        continue;
+      }
+      /* hold back some completions, so that the client goes to sleep */
+      if (stress_rand(&t->rng) % 4 == 0)
+        sched_yield();
+      if (tok->state == RTE_RING_TOKEN_WAITING)
+        woken++;
+      rte_ring_token_complete(tok, stress_result(req->client, req->seq));
+      served++;
+    }
+    t->ops += n;
+  }
+  __sync_add_and_fetch(&run->served, served);
+  __sync_add_and_fetch(&run->woken, woken);
+  __sync_add_and_fetch(&run->finished, 1);
+  return NULL;
+}
+
+/* drain the pool and refill it: each token once, then exhausted */
+static void stress_pool_check(struct stress_run *run)
+{
+  struct rte_ring_token_pool *pool = run->pool;
+  struct rte_ring_token *toks[MAX_TOKENS];
+  unsigned int i, n, idx;
+
+  for (n = 0; n < pool->count; n++) {
+    toks[n] = rte_ring_token_get(pool);
+    if (toks[n] == NULL) {
+      stress_error(run, "pool exhausted after %u tokens of %u", n,
+          pool->count);
+      break;
+    }
+    idx = stress_token_index(run, toks[n]);
+    if (idx >= pool->count || run->holder[idx] != 0)
+      stress_error(run, "pool handed out token %u twice", idx);
+    else
+      run->holder[idx] = 1;
+    if (toks[n]->state != RTE_RING_TOKEN_PENDING)
+      stress_error(run, "token %u taken in state %u", idx, toks[n]->state);
+  }
+  if (n == pool->count && rte_ring_token_get(pool) != NULL)
+    stress_error(run, "pool hands out more than its %u tokens",
+        pool->count);
+
+  for (i = 0; i < n; i++) {
+    idx = stress_token_index(run, toks[i]);
+    if (idx < pool->count)
+      run->holder[idx] = 0;
+    /* as the clients find them: completed */
+    rte_ring_token_complete(toks[i], 0);
+    rte_ring_token_put(pool, toks[i]);
+  }
+}
+
+/* check that every request was served once and every token came back */
+static uint64_t stress_check_end(struct stress_run *run,
+    const struct stress_thread *clients)
+{
+  uint64_t completed = 0;
+  unsigned int i;
+
+  for (i = 0; i < run->cfg->clients; i++)
+    completed += clients[i].ops;
+  if (completed != run->served)
+    stress_error(run, "%" PRIu64 " requests completed, %" PRIu64 " served",
+        completed, run->served);
+
+  if (rte_ring_count(run->pool->free) != run->pool->count)
+    stress_error(run, "%u tokens of %u back in the pool",
+        rte_ring_count(run->pool->free), run->pool->count);
+  for (i = 0; i < run->pool->count; i++) {
+    if (run->holder[i] != 0)
+      stress_error(run, "token %u still held by client %u", i,
+          run->holder[i] - 1);
+    if (run->pool->tokens[i].state != RTE_RING_TOKEN_DONE)
+      stress_error(run, "token %u returned in state %u", i,
+          run->pool->tokens[i].state);
+  }
+
+  if (run->wait == WAIT_SLEEP && completed != 0 && run->woken == 0)
+    stress_error(run, "no completion found a client asleep");
+  return completed;
+}
+
+/* fail the run when the threads are stuck: there is nothing to join */
+static void stress_deadlock(const struct stress_run *run)
+{
+  unsigned int i;
+
+  printf("  error: no request completed for %u s, %u requests queued, "
+      "token states:", run->cfg->watchdog, rte_ring_count(run->r));
+  for (i = 0; i < run->pool->count; i++)
+    printf(" %u", run->pool->tokens[i].state);
+  printf("\n%s: FAIL (lost wake-up?)\n", wait_names[run->wait]);
+  fflush(stdout);
+  exit(1);
+}
+
+/* the main thread of a run, until the threads end or get stuck */
+static void stress_wait(struct stress_run *run, struct stress_thread *threads,
+    unsigned int nb)
+{
+  struct timespec ts;
+  uint64_t start, now, ops, last_ops = 0, last_move;
+  unsigned int i, tick_us;
+
+  tick_us = run->cfg->inject == INJECT_SIGNAL ? run->cfg->period : 10000;
+  ts.tv_sec = tick_us / 1000000;
+  ts.tv_nsec = (tick_us % 1000000) * 1000L;
+  start = last_move = rte_rdtsc();
+  while (run->finished < nb) {
+    nanosleep(&ts, NULL);
+    if (run->cfg->inject == INJECT_SIGNAL)
+      pthread_kill(threads[rand() % nb].tid, SIGUSR1);
+    now = rte_rdtsc();
+    for (ops = 0, i = 0; i < nb; i++)
+      ops += threads[i].ops;
+    if (ops != last_ops) {
+      last_ops = ops;
+      last_move = now;
+    } else if (now - last_move > run->cfg->watchdog * tsc_hz) {
+      stress_deadlock(run);
+    }
+    if (now - start > run->cfg->seconds * tsc_hz)
+      run->stop = 1;
+  }
+}
+
+/* run a wait, return 0 if it passed */
+static int stress_run_one(const struct stress_config *cfg,
+    enum stress_wait wait)
+{
+  static struct stress_thread threads[2 * MAX_THREADS];
+  static struct stress_run run;
+  uint64_t total, start, end;
+  unsigned int nb, i;
+
+  memset(&run, 0, sizeof(run));
+  run.cfg = cfg;
+  run.wait = wait;
+  run.r = rte_ring_create(cfg->size, cfg->servers == 1 ? RING_F_SC_DEQ : 0);
+  run.pool = rte_ring_token_pool_create(cfg->tokens, 0);
+  if (run.r == NULL || run.pool == NULL) {
+    rte_ring_free(run.r);
+    rte_ring_token_pool_free(run.pool);
+    return -1;
+  }
+
+  stress_pool_check(&run);
+
+  nb = cfg->clients + cfg->servers;
+  start = rte_rdtsc();
+  for (i = 0; i < nb && !run.stop; i++) {
+    threads[i].run = &run;
+    threads[i].id = i < cfg->clients ? i : i - cfg->clients;
+    threads[i].ops = 0;
+    threads[i].rng = (cfg->seed + 1) * 0x9e3779b97f4a7c15ULL ^
+      ((uint64_t)wait << 32) ^ (i + 1);
+    if (pthread_create(&threads[i].tid, NULL, i < cfg->clients ?
+          stress_client : stress_server, &threads[i]) != 0) {
+      fprintf(stderr, "Cannot create thread %u\n", i);
+      exit(1);
+    }
+  }
+  /* a pool check that failed starts no thread */
+  nb = i;
+
+  stress_wait(&run, threads, nb);
+  for (i = 0; i < nb; i++)
+    pthread_join(threads[i].tid, NULL);
+  end = rte_rdtsc();
+
+  total = stress_check_end(&run, threads);
+  printf("%-7s %7u %7u %6u %12" PRIu64 " %10.2f %12" PRIu64 " %10" PRIu64
+      "  %s\n", wait_names[wait], cfg->clients, cfg->servers,
+      cfg->tokens, total, total / ((double)(end - start) / tsc_hz) / 1e6,
+      run.exhausted, run.woken, run.errors ? "FAIL" : "ok");
+  fflush(stdout);
+  rte_ring_token_pool_free(run.pool);
+  rte_ring_free(run.r);
+  return run.errors ? -1 : 0;
+}
+
+/* parse a comma separated list of names into a bit mask */
+static int parse_names(const char *list, const char * const *names,
+    unsigned int nb, unsigned int *mask)
+{
+  const char *end;
+  unsigned int i;
+  size_t len;
+
+  *mask = 0;
+  while (*list != '\0') {
+    end = strchr(list, ',');
+    len = end != NULL ? (size_t)(end - list) : strlen(list);
+    for (i = 0; i < nb; i++)
+      if (strlen(names[i]) == len && strncmp(names[i], list, len) == 0)
+        break;
+    if (i == nb)
+      return -1;
+    *mask |= 1u << i;
+    list += len + (end != NULL);
+  }
+  return *mask ? 0 : -1;
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr,
+      "Usage: %s [-s size] [-c clients] [-e servers] [-k tokens] "
+      "[-t seconds] [-w seconds] [-m waits] [-i inject] [-f period] "
+      "[-d delay] [-S seed]\n"
+      "  -s  request ring size, a power of 2, more than the tokens\n"
+      "      (default 64)\n"
+      "  -c  client threads (default 8, max %d)\n"
+      "  -e  server threads (default 1, max %d)\n"
+      "  -k  tokens in the pool, fewer than the clients to exhaust it\n"
+      "      (default 4, max %d)\n"
+      "  -t  seconds per run (default 5)\n"
+      "  -w  seconds without any request completing to report a lost\n"
+      "      wake-up (default 5)\n"
+      "  -m  waits among sleep,hybrid,spin,poll (default all)\n"
+      "  -i  delays injected: none or signal (default none)\n"
+      "  -f  signal a random thread every this many microseconds (1000)\n"
+      "  -d  microseconds of a signal stall (default 50)\n"
+      "  -S  random seed (default 1)\n",
+      prog, MAX_THREADS, MAX_THREADS, MAX_TOKENS);
+}
+
+int main(int argc, char **argv)
+{
+  struct stress_config cfg = { 64, 8, 1, 4, 5, 5, INJECT_NONE, 1000, 50, 1,
+    (1u << WAIT_MAX) - 1 };
+  unsigned int w, failed = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:c:e:k:t:w:m:i:f:d:S:h")) != -1) {
+    switch (opt) {
+      case 's': cfg.size = atoi(optarg); break;
+      case 'c': cfg.clients = atoi(optarg); break;
+      case 'e': cfg.servers = atoi(optarg); break;
+      case 'k': cfg.tokens = atoi(optarg); break;
+      case 't': cfg.seconds = atoi(optarg); break;
+      case 'w': cfg.watchdog = atoi(optarg); break;
+      case 'm':
+        if (parse_names(optarg, wait_names, WAIT_MAX, &cfg.waits) != 0) {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'i':
+        if (strcmp(optarg, "signal") == 0)
+          cfg.inject = INJECT_SIGNAL;
+        else if (strcmp(optarg, "none") == 0)
+          cfg.inject = INJECT_NONE;
+        else {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'f': cfg.period = atoi(optarg); break;
+      case 'd': cfg.delay_us = atoi(optarg); break;
+      case 'S': cfg.seed = strtoull(optarg, NULL, 0); break;
+      default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+    }
+  }
+  /* a full request ring would refuse requests with tokens left */
+  if (!POWEROF2(cfg.size) || cfg.size <= cfg.tokens || cfg.clients == 0 ||
+      cfg.clients > MAX_THREADS || cfg.servers == 0 ||
+      cfg.servers > MAX_THREADS || cfg.tokens == 0 ||
+      cfg.tokens > MAX_TOKENS || cfg.watchdog == 0 || cfg.period == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  inject_delay_us = cfg.delay_us;
+  if (cfg.inject == INJECT_SIGNAL)
+    signal(SIGUSR1, stress_preempt_signal);
+  srand((unsigned int)cfg.seed);
+  tsc_hz = rte_get_tsc_hz();
+
+  printf("%-7s %7s %7s %6s %12s %10s %12s %10s  %s\n", "wait", "clients",
+      "servers", "tokens", "requests", "Mreq/s", "exhausted", "woken",
+      "result");
+  for (w = 0; w < WAIT_MAX; w++)
+    if ((cfg.waits & (1u << w)) &&
+        stress_run_one(&cfg, (enum stress_wait)w) != 0)
+      failed++;
+
+  printf("%u run%s failed\n", failed, failed == 1 ? "" : "s");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/**
+ * @file
+ * Trace decoder
+ *
+ * Reads a trace file written by the rte_trace.h collector and prints the
+ * records of all the threads as one timeline, sorted by TSC, with times in
+ * microseconds from the first record and the delta from the previous record
+ * of the same thread. Lost records are reported per thread.
+ *
+ * Usage: trace_decode [-t tid] [-c] file
+ *   -t  only print the records of this thread
+ *   -c  print CSV instead of aligned columns
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <my_global.h>
+
+#include "rte_trace.h"
+
+#define MAX_THREADS 1024
+
+/* a record with its thread */
+struct decoded_record {
+  struct rte_trace_record rec;
+  uint32_t tid;
+};
+
+/* per thread totals */
+struct decoded_thread {
+  uint32_t tid;
+  uint64_t records;
+  uint64_t lost;
+  uint64_t last_tsc;
+};
+
+static struct decoded_record *records;
+static size_t nb_records, max_records;
+static uint32_t name_ids[RTE_TRACE_MAX_NAMES];
+static char name_strs[RTE_TRACE_MAX_NAMES][RTE_TRACE_NAMESIZE];
+static unsigned nb_names;
+static struct decoded_thread threads[MAX_THREADS];
+static unsigned nb_threads;
+
+static struct decoded_thread *thread_get(uint32_t tid)
+{
+  unsigned i;
+
+  for (i = 0; i < nb_threads; i++)
+    if (threads[i].tid == tid)
+      return &threads[i];
+  if (nb_threads == MAX_THREADS)
+    return NULL;
+  threads[nb_threads].tid = tid;
+  return &threads[nb_threads++];
+}
+
+/* the last name given to an event id */
+static const char *event_name(uint32_t id)
+{
+  unsigned i;
+
+  for (i = nb_names; i > 0; i--)
+    if (name_ids[i - 1] == id)
+      return name_strs[i - 1];
+  return NULL;
+}
+
+static int cmp_tsc(const void *a, const void *b)
+{
+  const struct decoded_record *x = (const struct decoded_record *)a;
+  const struct decoded_record *y = (const struct decoded_record *)b;
+
+  return x->rec.tsc < y->rec.tsc ? -1 : x->rec.tsc > y->rec.tsc;
+}
+
+static int read_trace(FILE *f, struct rte_trace_file_header *hdr)
+{
+  struct rte_trace_chunk chunk;
+  struct decoded_thread *t;
+  struct decoded_record *grown;
+  uint32_t i;
+
+  if (fread(hdr, sizeof(*hdr), 1, f) != 1 ||
+      memcmp(hdr->magic, RTE_TRACE_MAGIC, sizeof(hdr->magic)) != 0) {
+    fprintf(stderr, "not a trace file\n");
+    return -1;
+  }
+  if (hdr->version != RTE_TRACE_VERSION ||
+      hdr->record_size != sizeof(struct rte_trace_record)) {
+    fprintf(stderr, "unsupported trace version %u, record size %u\n",
+        hdr->version, hdr->record_size);
+    return -1;
+  }
+
+  while (fread(&chunk, sizeof(chunk), 1, f) == 1) {
+    if (chunk.type == RTE_TRACE_CHUNK_NAME) {
+      if (nb_names == RTE_TRACE_MAX_NAMES ||
+          fread(name_strs[nb_names], RTE_TRACE_NAMESIZE, 1, f) != 1)
+        break;
+      name_strs[nb_names][RTE_TRACE_NAMESIZE - 1] = '\0';
+      name_ids[nb_names++] = chunk.id;
+      continue;
+    }
+    if (chunk.type != RTE_TRACE_CHUNK_RECORDS) {
+      fprintf(stderr, "corrupted trace file\n");
+      return -1;
+    }
+
+    if (nb_records + chunk.count > max_records) {
+      max_records = (nb_records + chunk.count) * 2;
+      grown = (struct decoded_record *)realloc(records,
+          max_records * sizeof(*records));
+      if (grown == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+      }
+      records = grown;
+    }
+    for (i = 0; i < chunk.count; i++) {
+      if (fread(&records[nb_records].rec, sizeof(struct rte_trace_record), 1,
+            f) != 1) {
+        fprintf(stderr, "truncated trace file\n");
+        return -1;
+      }
+      records[nb_records++].tid = chunk.id;
+    }
+    t = thread_get(chunk.id);
+    if (t != NULL) {
+      t->records += chunk.count;
+      t->lost += chunk.lost;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  struct rte_trace_file_header hdr;
+  struct decoded_thread *t;
+  const struct decoded_record *d;
+  const char *name;
+  char id[16];
+  long tid_filter = -1;
+  int csv = 0, opt;
+  double us, delta;
+  uint64_t first;
+  size_t i;
+  FILE *f;
+
+  while ((opt = getopt(argc, argv, "t:ch")) != -1) {
+    switch (opt) {
+      case 't': tid_filter = strtol(optarg, NULL, 0); break;
+      case 'c': csv = 1; break;
+      default:
+        fprintf(stderr, "Usage: %s [-t tid] [-c] file\n", argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, "Usage: %s [-t tid] [-c] file\n", argv[0]);
+    return 1;
+  }
+
+  f = fopen(argv[optind], "rb");
+  if (f == NULL) {
+    perror(argv[optind]);
+    return 1;
+  }
+  if (read_trace(f, &hdr) != 0) {
+    fclose(f);
+    return 1;
+  }
+  fclose(f);
+
+  qsort(records, nb_records, sizeof(*records), cmp_tsc);
+  first = nb_records ? records[0].rec.tsc : 0;
+
+  if (csv)
+    printf("time_us,delta_us,tid,event,arg0,arg1,arg2\n");
+  for (i = 0; i < nb_records; i++) {
+    d = &records[i];
+    t = thread_get(d->tid);
+    us = (double)(d->rec.tsc - first) * 1e6 / hdr.tsc_hz;
+    delta = t != NULL && t->last_tsc ?
+      (double)(d->rec.tsc - t->last_tsc) * 1e6 / hdr.tsc_hz : 0.0;
+    if (t != NULL)
+      t->last_tsc = d->rec.tsc;
+    if (tid_filter >= 0 && d->tid != (uint32_t)tid_filter)
+      continue;
+    name = event_name(d->rec.id);
+    if (name == NULL) {
+      snprintf(id, sizeof(id), "%u", d->rec.id);
+      name = id;
+    }
+    if (csv)
+      printf("%.3f,%.3f,%u,%s,%u,%" PRIu64 ",%" PRIu64 "\n", us, delta,
+          d->tid, name, d->rec.arg0, d->rec.arg1, d->rec.arg2);
+    else
+      printf("%14.3f %+12.3f %8u %-20s %10u %20" PRIu64 " %20" PRIu64 "\n",
+          us, delta, d->tid, name, d->rec.arg0, d->rec.arg1, d->rec.arg2);
+  }
+
+  for (i = 0; i < nb_threads; i++)
+    if (tid_filter < 0 || threads[i].tid == (uint32_t)tid_filter)
+      fprintf(stderr, "thread %u: %" PRIu64 " records, %" PRIu64 " lost\n",
+          threads[i].tid, threads[i].records, threads[i].lost);
+
+  free(records);
+  return 0;
+}
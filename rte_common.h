@@ -68,6 +68,11 @@
  */
 #define __rte_always_inline inline __attribute__((always_inline))
 
+/**
+ * Force a function to be noinline
+ */
+#define __rte_noinline __attribute__((noinline))
+
 /**
  * Triggers an error at compilation time if the condition is true.
  */
@@ -105,6 +110,28 @@
 #define rte_smp_wmb() rte_wmb()
 #define rte_smp_rmb() rte_rmb()
 
+/**
+ * Prefetch a cache line into all cache levels.
+ *
+ * @param p
+ *   Address to prefetch. It may be invalid: a prefetch never faults.
+ */
+static inline void rte_prefetch0(const volatile void *p)
+{
+  asm volatile ("prefetcht0 %[p]" : : [p] "m" (*(const volatile char *)p));
+}
+
+/**
+ * Prefetch a cache line into all cache levels except the L1.
+ *
+ * @param p
+ *   Address to prefetch.
+ */
+static inline void rte_prefetch1(const volatile void *p)
+{
+  asm volatile ("prefetcht1 %[p]" : : [p] "m" (*(const volatile char *)p));
+}
+
 #define MS_PER_S 1000
 #define US_PER_S 1000000
 #define NS_PER_S 1000000000
@@ -165,6 +192,15 @@ static inline int rte_atomic32_cmpset(volatile uint32_t *dst, uint32_t exp, uint
   return res;
 }
 
+/**
+ * Pause the CPU for a short while in a busy-wait loop, which reduces power
+ * use and frees resources for the SMT sibling.
+ */
+static inline void rte_pause(void)
+{
+  asm volatile ("pause" : : : "memory");
+}
+
 static inline uint64_t rte_rdtsc(void)
 {
   union {
@@ -0,0 +1,113 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <my_global.h>
+#include <my_sys.h>
+#include <mysqld_error.h>
+
+#include "rte_deque.h"
+
+/* return the size of memory occupied by a deque */
+ssize_t rte_deque_get_memsize(unsigned count)
+{
+  ssize_t sz;
+
+  /* count must be a power of 2 */
+  if ((!POWEROF2(count)) || (count == 0) || (count > RTE_RING_SZ_MASK)) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Requested size is invalid, must be power of 2, and "
+        "do not exceed the size limit %u",
+        MYF(0),
+        RTE_RING_SZ_MASK);
+    return -EINVAL;
+  }
+
+  sz = sizeof(struct rte_deque) + count * sizeof(struct rte_deque_slot);
+  sz = RTE_ALIGN(sz, RTE_CACHE_LINE_SIZE);
+  return sz;
+}
+
+int rte_deque_init(struct rte_deque *d, unsigned count, unsigned flags)
+{
+  struct rte_deque_slot *slots;
+  unsigned i;
+
+  /* compilation-time checks */
+  RTE_BUILD_BUG_ON((sizeof(struct rte_deque) &
+        RTE_CACHE_LINE_MASK) != 0);
+  RTE_BUILD_BUG_ON((offsetof(struct rte_deque, ends) &
+        RTE_CACHE_LINE_MASK) != 0);
+
+  if (rte_deque_get_memsize(count) < 0)
+    return -EINVAL;
+
+  /* init the deque structure, all slots empty */
+  memset(d, 0, sizeof(*d) + count * sizeof(struct rte_deque_slot));
+  d->flags = flags;
+  d->size = count;
+  d->mask = count - 1;
+  d->capacity = count;
+  d->ends = 0;
+
+  /* slot i starts empty at position i, which both the first push at the
+   * back (position i) and the first push at the front (position
+   * i - count) accept */
+  slots = (struct rte_deque_slot *)&d[1];
+  for (i = 0; i < count; i++)
+    slots[i].seq = (uint64_t)i << 2 | __RTE_DEQUE_EMPTY;
+
+  return 0;
+}
+
+/* create the deque */
+struct rte_deque *rte_deque_create(unsigned count, unsigned flags)
+{
+  const struct rte_ring_alloc_ops *ops = &RTE_RING_DEFAULT_ALLOC_OPS;
+  struct rte_deque *d;
+  ssize_t deque_size;
+
+  deque_size = rte_deque_get_memsize(count);
+  if (deque_size < 0)
+    return NULL;
+
+  d = (struct rte_deque *)ops->alloc(deque_size, RTE_RING_ALLOC_ALIGN,
+      ops->ctx);
+  if (d == NULL) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot reserve memory",
+        MYF(0));
+    return NULL;
+  }
+
+  if (rte_deque_init(d, count, flags) != 0) {
+    ops->free(d, deque_size, ops->ctx);
+    return NULL;
+  }
+
+  /* rte_deque_init() clears the structure, so record the owner afterwards */
+  d->alloc = *ops;
+  d->memsize = deque_size;
+
+  return d;
+}
+
+/* free the deque */
+void rte_deque_free(struct rte_deque *d)
+{
+  if (d == NULL)
+    return;
+
+  if (d->alloc.free == NULL) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot free deque (not created with rte_deque_create())",
+        MYF(0));
+    return;
+  }
+
+  d->alloc.free(d, d->memsize, d->alloc.ctx);
+}
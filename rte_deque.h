@@ -0,0 +1,603 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _RTE_DEQUE_H_
+#define _RTE_DEQUE_H_
+
+/**
+ * @file
+ * RTE Deque (two-lock)
+ *
+ * A fixed-size double-ended queue of pointers, sharing the layout of
+ * rte_ring: power-of-two sized table, cache aligned indexes and bulk/burst
+ * API. Objects can be pushed and popped at both ends, by any number of
+ * threads at each end.
+ *
+ * It is not lock-free: each end has a lock, taken for a whole push or pop,
+ * so a thread preempted in the middle of an operation stops every other
+ * thread at its end until it runs again, which the rte_ring multi-producer
+ * and multi-consumer modes avoid. The two ends run concurrently.
+ *
+ * The front and back indexes are packed in a single 64-bit word, so every
+ * operation reserves its positions with one compare-and-set of both, which
+ * keeps the count and capacity checks exact whatever the mix of ends. The
+ * reservation is then filled or drained slot by slot: each slot carries a
+ * state tagged with the position it holds, and a thread waits for the slot
+ * to reach the exact state it needs. A reader waits for its position to be
+ * full. A writer waits for the slot to be emptied by the previous user of
+ * its position: the same position popped from the same end, or the position
+ * one lap away popped from the other end. This is the equivalent of the
+ * rte_ring tail update: it lets the operations at the two ends complete in
+ * any order, and a thread preempted in the middle of an operation stalls
+ * the other threads at its end and the ones reusing its slots.
+ *
+ * The end locks are needed for correctness, not only for fairness:
+ * concurrent operations at one end could reuse a slot while an earlier one
+ * still waits for it, the writers of an end that wraps around a full deque,
+ * or an end that changes direction and reuses the positions it just left.
+ * With one operation per end, each slot has a single pending user per end,
+ * so that a reader cannot get the object of a later writer of the same
+ * position.
+ *
+ * Compared to rte_ring, all ends share the index cache line and the threads
+ * at one end take turns, so rte_ring remains the better choice for
+ * FIFO-only use.
+ */
+
+#include <stdint.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include "rte_ring.h"
+
+/* @internal slot states, in the two low bits of the slot sequence */
+#define __RTE_DEQUE_EMPTY   0
+#define __RTE_DEQUE_WRITING 1
+#define __RTE_DEQUE_FULL    2
+#define __RTE_DEQUE_READING 3
+#define __RTE_DEQUE_STATE_MASK 3
+
+/** A deque slot: the object and its position-tagged state. */
+struct rte_deque_slot {
+  volatile uint64_t seq;   /**< Position << 2 | state. */
+  void * volatile obj;     /**< The object. */
+};
+
+/**
+ * An RTE deque structure. The slots table follows the structure.
+ *
+ * Like the rte_ring indexes, front and back run from 0 to 2^32 and are
+ * masked when accessing the slots; the front index decreases when pushing
+ * to the front.
+ */
+struct rte_deque {
+  int flags;               /**< Flags supplied at creation. */
+  uint32_t size;           /**< Size of deque. */
+  uint32_t mask;           /**< Mask (size-1) of deque. */
+  uint32_t capacity;       /**< Usable size of deque. */
+  struct rte_ring_alloc_ops alloc; /**< Allocator owning the deque memory. */
+  size_t memsize;          /**< Bytes obtained from the allocator. */
+
+  char pad0 __rte_cache_aligned; /**< empty cache line */
+
+  /** Front (low 32 bits) and back (high 32 bits) indexes. */
+  volatile uint64_t ends __rte_cache_aligned;
+  /** Operation in progress at the front and at the back. */
+  volatile uint32_t busy[2];
+  char pad1 __rte_cache_aligned; /**< empty cache line */
+};
+
+/** @internal Which end an operation works on. */
+enum rte_deque_end {
+  RTE_DEQUE_PUSH_BACK = 0,
+  RTE_DEQUE_PUSH_FRONT,
+  RTE_DEQUE_POP_FRONT,
+  RTE_DEQUE_POP_BACK
+};
+
+/**
+ * Calculate the memory size needed for a deque.
+ *
+ * @param count
+ *   The number of elements in the deque (must be a power of 2).
+ * @return
+ *   - The memory size needed for the deque on success.
+ *   - -EINVAL if count is not a power of 2.
+ */
+ssize_t rte_deque_get_memsize(unsigned count);
+
+/**
+ * Initialize a deque structure in memory pointed by "d", large enough for
+ * the structure and slots (see rte_deque_get_memsize()).
+ *
+ * @param d
+ *   The pointer to the deque structure followed by the slots table.
+ * @param count
+ *   The number of elements in the deque (must be a power of 2). Unlike
+ *   rte_ring, all of them are usable.
+ * @param flags
+ *   Reserved, must be 0.
+ * @return
+ *   0 on success, or a negative value on error.
+ */
+int rte_deque_init(struct rte_deque *d, unsigned count, unsigned flags);
+
+/**
+ * Create a new deque in memory.
+ *
+ * @param count
+ *   The size of the deque (must be a power of 2).
+ * @param flags
+ *   Reserved, must be 0.
+ * @return
+ *   On success, the pointer to the new allocated deque. NULL on error.
+ */
+struct rte_deque *rte_deque_create(unsigned count, unsigned flags);
+
+/**
+ * De-allocate all memory used by the deque.
+ *
+ * @param d
+ *   Deque to free
+ */
+void rte_deque_free(struct rte_deque *d);
+
+/* @internal position of the i-th object of an operation starting at the
+ * given front and back indexes */
+static __rte_always_inline uint32_t
+__rte_deque_pos(enum rte_deque_end end, uint32_t front, uint32_t back,
+    unsigned int i)
+{
+  switch (end) {
+    case RTE_DEQUE_PUSH_BACK:
+      return back + i;
+    case RTE_DEQUE_PUSH_FRONT:
+      return front - 1 - i;
+    case RTE_DEQUE_POP_FRONT:
+      return front + i;
+    default:
+      return back - 1 - i;
+  }
+}
+
+/* @internal take an end of the deque, once its operation in progress is
+ * done */
+static __rte_always_inline void
+__rte_deque_lock(struct rte_deque *d, enum rte_deque_end end)
+{
+  volatile uint32_t *busy = &d->busy[end == RTE_DEQUE_PUSH_BACK ||
+    end == RTE_DEQUE_POP_BACK];
+
+  while (*busy != 0 || !__sync_bool_compare_and_swap(busy, 0, 1))
+    rte_pause();
+}
+
+/* @internal release an end of the deque */
+static __rte_always_inline void
+__rte_deque_unlock(struct rte_deque *d, enum rte_deque_end end)
+{
+  __atomic_store_n(&d->busy[end == RTE_DEQUE_PUSH_BACK ||
+      end == RTE_DEQUE_POP_BACK], 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @internal Reserve positions at one end of the deque
+ *
+ * @param d
+ *   A pointer to the deque structure.
+ * @param end
+ *   The end and direction of the operation.
+ * @param n
+ *   The number of positions wanted.
+ * @param behavior
+ *   RTE_RING_QUEUE_FIXED:    Reserve a fixed number of positions
+ *   RTE_RING_QUEUE_VARIABLE: Reserve as many positions as possible
+ * @param front
+ *   Returns the front index before the reservation.
+ * @param back
+ *   Returns the back index before the reservation.
+ * @param left
+ *   Returns the free space (push) or the entries (pop) after the reservation.
+ * @return
+ *   Actual number of positions reserved.
+ */
+static __rte_always_inline unsigned int
+__rte_deque_move_ends(struct rte_deque *d, enum rte_deque_end end,
+    unsigned int n, enum rte_ring_queue_behavior behavior,
+    uint32_t *front, uint32_t *back, uint32_t *left)
+{
+  const unsigned int max = n;
+  uint64_t old_ends, new_ends;
+  uint32_t avail, new_front, new_back;
+
+  do {
+    n = max;
+
+    old_ends = d->ends;
+    *front = (uint32_t)old_ends;
+    *back = (uint32_t)(old_ends >> 32);
+
+    avail = *back - *front;
+    if (end == RTE_DEQUE_PUSH_BACK || end == RTE_DEQUE_PUSH_FRONT)
+      avail = d->capacity - avail;
+
+    if (unlikely(n > avail))
+      n = (behavior == RTE_RING_QUEUE_FIXED) ? 0 : avail;
+    *left = avail - n;
+    if (n == 0)
+      return 0;
+
+    new_front = *front;
+    new_back = *back;
+    switch (end) {
+      case RTE_DEQUE_PUSH_BACK:
+        new_back += n;
+        break;
+      case RTE_DEQUE_PUSH_FRONT:
+        new_front -= n;
+        break;
+      case RTE_DEQUE_POP_FRONT:
+        new_front += n;
+        break;
+      default:
+        new_back -= n;
+        break;
+    }
+    new_ends = ((uint64_t)new_back << 32) | new_front;
+  } while (unlikely(!__sync_bool_compare_and_swap(&d->ends, old_ends,
+          new_ends)));
+  return n;
+}
+
+/* @internal store an object at a reserved position, once its slot has been
+ * emptied at this position or at the other one given */
+static __rte_always_inline void
+__rte_deque_write_slot(struct rte_deque *d, uint32_t pos, uint32_t other,
+    void *obj)
+{
+  struct rte_deque_slot *slot =
+    &((struct rte_deque_slot *)&d[1])[pos & d->mask];
+  const uint64_t tag = (uint64_t)pos << 2;
+  const uint64_t other_tag = (uint64_t)other << 2;
+  uint64_t seq;
+
+  for (;;) {
+    seq = slot->seq;
+    if ((seq == (tag | __RTE_DEQUE_EMPTY) ||
+          seq == (other_tag | __RTE_DEQUE_EMPTY)) &&
+        __sync_bool_compare_and_swap(&slot->seq, seq,
+          tag | __RTE_DEQUE_WRITING))
+      break;
+    rte_pause();
+  }
+  slot->obj = obj;
+  __atomic_store_n(&slot->seq, tag | __RTE_DEQUE_FULL, __ATOMIC_RELEASE);
+}
+
+/* @internal load the object of a reserved position, once it is stored */
+static __rte_always_inline void *
+__rte_deque_read_slot(struct rte_deque *d, uint32_t pos)
+{
+  struct rte_deque_slot *slot = &((struct rte_deque_slot *)&d[1])[pos & d->mask];
+  const uint64_t tag = (uint64_t)pos << 2;
+  void *obj;
+
+  while (slot->seq != (tag | __RTE_DEQUE_FULL) ||
+      !__sync_bool_compare_and_swap(&slot->seq, tag | __RTE_DEQUE_FULL,
+        tag | __RTE_DEQUE_READING))
+    rte_pause();
+  obj = slot->obj;
+  __atomic_store_n(&slot->seq, tag | __RTE_DEQUE_EMPTY, __ATOMIC_RELEASE);
+  return obj;
+}
+
+/**
+ * @internal Push several objects at one end of the deque
+ *
+ * @param d
+ *   A pointer to the deque structure.
+ * @param end
+ *   RTE_DEQUE_PUSH_BACK or RTE_DEQUE_PUSH_FRONT.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects).
+ * @param n
+ *   The number of objects to push.
+ * @param behavior
+ *   RTE_RING_QUEUE_FIXED:    Push a fixed number of items
+ *   RTE_RING_QUEUE_VARIABLE: Push as many items as possible
+ * @param free_space
+ *   returns the amount of space after the operation has finished
+ * @return
+ *   Actual number of objects pushed.
+ */
+static __rte_always_inline unsigned int
+__rte_deque_do_push(struct rte_deque *d, enum rte_deque_end end,
+    void * const *obj_table, unsigned int n,
+    enum rte_ring_queue_behavior behavior, unsigned int *free_space)
+{
+  /* the other end empties a slot one lap behind the back, ahead of the
+   * front */
+  const uint32_t lap = end == RTE_DEQUE_PUSH_BACK ? -d->size : d->size;
+  uint32_t front, back, left, pos;
+  unsigned int i;
+
+  __rte_deque_lock(d, end);
+  n = __rte_deque_move_ends(d, end, n, behavior, &front, &back, &left);
+  __RTE_RING_PREEMPT_POINT(NULL, 1);
+  for (i = 0; i < n; i++) {
+    pos = __rte_deque_pos(end, front, back, i);
+    __rte_deque_write_slot(d, pos, pos + lap, obj_table[i]);
+  }
+  __rte_deque_unlock(d, end);
+
+  if (free_space != NULL)
+    *free_space = left;
+  return n;
+}
+
+/**
+ * @internal Pop several objects from one end of the deque
+ *
+ * @param d
+ *   A pointer to the deque structure.
+ * @param end
+ *   RTE_DEQUE_POP_FRONT or RTE_DEQUE_POP_BACK.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects) that will be filled.
+ * @param n
+ *   The number of objects to pop.
+ * @param behavior
+ *   RTE_RING_QUEUE_FIXED:    Pop a fixed number of items
+ *   RTE_RING_QUEUE_VARIABLE: Pop as many items as possible
+ * @param available
+ *   returns the number of remaining entries after the operation has finished
+ * @return
+ *   Actual number of objects popped.
+ */
+static __rte_always_inline unsigned int
+__rte_deque_do_pop(struct rte_deque *d, enum rte_deque_end end,
+    void **obj_table, unsigned int n, enum rte_ring_queue_behavior behavior,
+    unsigned int *available)
+{
+  uint32_t front, back, left;
+  unsigned int i;
+
+  __rte_deque_lock(d, end);
+  n = __rte_deque_move_ends(d, end, n, behavior, &front, &back, &left);
+  __RTE_RING_PREEMPT_POINT(NULL, 0);
+  for (i = 0; i < n; i++)
+    obj_table[i] = __rte_deque_read_slot(d,
+        __rte_deque_pos(end, front, back, i));
+  __rte_deque_unlock(d, end);
+
+  if (available != NULL)
+    *available = left;
+  return n;
+}
+
+/**
+ * Push several objects at the back of the deque (multi-threads safe).
+ *
+ * The objects are pushed in table order: obj_table[n-1] ends up last.
+ *
+ * @param d
+ *   A pointer to the deque structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects).
+ * @param n
+ *   The number of objects to push.
+ * @param free_space
+ *   if non-NULL, returns the amount of space in the deque after the
+ *   operation has finished.
+ * @return
+ *   The number of objects pushed, either 0 or n
+ */
+  static __rte_always_inline unsigned int
+rte_deque_push_back_bulk(struct rte_deque *d, void * const *obj_table,
+    unsigned int n, unsigned int *free_space)
+{
+  return __rte_deque_do_push(d, RTE_DEQUE_PUSH_BACK, obj_table, n,
+      RTE_RING_QUEUE_FIXED, free_space);
+}
+
+/**
+ * Push objects at the back of the deque, as many as fit up to n
+ * (multi-threads safe).
+ *
+ * @param d
+ *   A pointer to the deque structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects).
+ * @param n
+ *   The number of objects to push.
+ * @param free_space
+ *   if non-NULL, returns the amount of space in the deque after the
+ *   operation has finished.
+ * @return
+ *   - n: Actual number of objects pushed.
+ */
+  static __rte_always_inline unsigned int
+rte_deque_push_back_burst(struct rte_deque *d, void * const *obj_table,
+    unsigned int n, unsigned int *free_space)
+{
+  return __rte_deque_do_push(d, RTE_DEQUE_PUSH_BACK, obj_table, n,
+      RTE_RING_QUEUE_VARIABLE, free_space);
+}
+
+/**
+ * Push several objects at the front of the deque (multi-threads safe).
+ *
+ * The objects are pushed one after the other: obj_table[n-1] ends up first,
+ * as with n single-object pushes.
+ *
+ * @param d
+ *   A pointer to the deque structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects).
+ * @param n
+ *   The number of objects to push.
+ * @param free_space
+ *   if non-NULL, returns the amount of space in the deque after the
+ *   operation has finished.
+ * @return
+ *   The number of objects pushed, either 0 or n
+ */
+  static __rte_always_inline unsigned int
+rte_deque_push_front_bulk(struct rte_deque *d, void * const *obj_table,
+    unsigned int n, unsigned int *free_space)
+{
+  return __rte_deque_do_push(d, RTE_DEQUE_PUSH_FRONT, obj_table, n,
+      RTE_RING_QUEUE_FIXED, free_space);
+}
+
+/**
+ * Push objects at the front of the deque, as many as fit up to n
+ * (multi-threads safe).
+ *
+ * @param d
+ *   A pointer to the deque structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects).
+ * @param n
+ *   The number of objects to push.
+ * @param free_space
+ *   if non-NULL, returns the amount of space in the deque after the
+ *   operation has finished.
+ * @return
+ *   - n: Actual number of objects pushed.
+ */
+  static __rte_always_inline unsigned int
+rte_deque_push_front_burst(struct rte_deque *d, void * const *obj_table,
+    unsigned int n, unsigned int *free_space)
+{
+  return __rte_deque_do_push(d, RTE_DEQUE_PUSH_FRONT, obj_table, n,
+      RTE_RING_QUEUE_VARIABLE, free_space);
+}
+
+/**
+ * Pop several objects from the front of the deque (multi-threads safe).
+ *
+ * obj_table[0] receives the first object.
+ *
+ * @param d
+ *   A pointer to the deque structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects) that will be filled.
+ * @param n
+ *   The number of objects to pop.
+ * @param available
+ *   If non-NULL, returns the number of remaining entries after the
+ *   operation has finished.
+ * @return
+ *   The number of objects popped, either 0 or n
+ */
+  static __rte_always_inline unsigned int
+rte_deque_pop_front_bulk(struct rte_deque *d, void **obj_table,
+    unsigned int n, unsigned int *available)
+{
+  return __rte_deque_do_pop(d, RTE_DEQUE_POP_FRONT, obj_table, n,
+      RTE_RING_QUEUE_FIXED, available);
+}
+
+/**
+ * Pop objects from the front of the deque, up to n (multi-threads safe).
+ *
+ * @param d
+ *   A pointer to the deque structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects) that will be filled.
+ * @param n
+ *   The number of objects to pop.
+ * @param available
+ *   If non-NULL, returns the number of remaining entries after the
+ *   operation has finished.
+ * @return
+ *   - n: Actual number of objects popped, 0 if the deque is empty
+ */
+  static __rte_always_inline unsigned int
+rte_deque_pop_front_burst(struct rte_deque *d, void **obj_table,
+    unsigned int n, unsigned int *available)
+{
+  return __rte_deque_do_pop(d, RTE_DEQUE_POP_FRONT, obj_table, n,
+      RTE_RING_QUEUE_VARIABLE, available);
+}
+
+/**
+ * Pop several objects from the back of the deque (multi-threads safe).
+ *
+ * obj_table[0] receives the last object, as with n single-object pops.
+ *
+ * @param d
+ *   A pointer to the deque structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects) that will be filled.
+ * @param n
+ *   The number of objects to pop.
+ * @param available
+ *   If non-NULL, returns the number of remaining entries after the
+ *   operation has finished.
+ * @return
+ *   The number of objects popped, either 0 or n
+ */
+  static __rte_always_inline unsigned int
+rte_deque_pop_back_bulk(struct rte_deque *d, void **obj_table,
+    unsigned int n, unsigned int *available)
+{
+  return __rte_deque_do_pop(d, RTE_DEQUE_POP_BACK, obj_table, n,
+      RTE_RING_QUEUE_FIXED, available);
+}
+
+/**
+ * Pop objects from the back of the deque, up to n (multi-threads safe).
+ *
+ * @param d
+ *   A pointer to the deque structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects) that will be filled.
+ * @param n
+ *   The number of objects to pop.
+ * @param available
+ *   If non-NULL, returns the number of remaining entries after the
+ *   operation has finished.
+ * @return
+ *   - n: Actual number of objects popped, 0 if the deque is empty
+ */
+  static __rte_always_inline unsigned int
+rte_deque_pop_back_burst(struct rte_deque *d, void **obj_table,
+    unsigned int n, unsigned int *available)
+{
+  return __rte_deque_do_pop(d, RTE_DEQUE_POP_BACK, obj_table, n,
+      RTE_RING_QUEUE_VARIABLE, available);
+}
+
+/**
+ * Return the number of entries in a deque.
+ *
+ * @param d
+ *   A pointer to the deque structure.
+ * @return
+ *   The number of entries in the deque, including the ones being pushed.
+ */
+  static inline unsigned
+rte_deque_count(const struct rte_deque *d)
+{
+  const uint64_t ends = d->ends;
+
+  return (uint32_t)(ends >> 32) - (uint32_t)ends;
+}
+
+/**
+ * Return the number of elements which can be stored in the deque.
+ *
+ * @param d
+ *   A pointer to the deque structure.
+ * @return
+ *   The usable size of the deque.
+ */
+  static inline unsigned int
+rte_deque_get_capacity(const struct rte_deque *d)
+{
+  return d->capacity;
+}
+
+#endif /* _RTE_DEQUE_H_ */
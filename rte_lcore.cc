@@ -0,0 +1,283 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include <my_global.h>
+#include <my_sys.h>
+#include <mysqld_error.h>
+
+#include "rte_lcore.h"
+
+RTE_DEFINE_PER_LCORE(unsigned, _lcore_id) = LCORE_ID_ANY;
+
+/* configuration and launch state of one lcore */
+struct lcore_config {
+  pthread_t thread;
+  int cpu;
+  enum rte_lcore_state_t state;
+  lcore_function_t *f;
+  void *arg;
+  int ret;
+  int stop;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+} __rte_cache_aligned;
+
+static struct lcore_config lcore_config[RTE_MAX_LCORE];
+static unsigned lcore_count;
+
+static int pin_thread(pthread_t thread, int cpu)
+{
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(thread, sizeof(set), &set);
+}
+
+/* worker lcore: run the launched functions until stopped */
+static void *lcore_thread_loop(void *arg)
+{
+  struct lcore_config *cfg = (struct lcore_config *)arg;
+  int ret;
+
+  RTE_PER_LCORE(_lcore_id) = cfg - lcore_config;
+
+  pthread_mutex_lock(&cfg->lock);
+  for (;;) {
+    while (cfg->state != RUNNING && !cfg->stop)
+      pthread_cond_wait(&cfg->cond, &cfg->lock);
+    if (cfg->stop)
+      break;
+
+    pthread_mutex_unlock(&cfg->lock);
+    ret = cfg->f(cfg->arg);
+    pthread_mutex_lock(&cfg->lock);
+
+    cfg->ret = ret;
+    cfg->state = FINISHED;
+    pthread_cond_broadcast(&cfg->cond);
+  }
+  pthread_mutex_unlock(&cfg->lock);
+  return NULL;
+}
+
+int rte_lcore_init_cpus(const int *cpus, unsigned nb_cpus)
+{
+  struct lcore_config *cfg;
+  unsigned i;
+
+  if (lcore_count != 0) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Lcores already set up, call rte_lcore_cleanup() first",
+        MYF(0));
+    return -EBUSY;
+  }
+
+  if (nb_cpus == 0 || nb_cpus > RTE_MAX_LCORE) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Invalid lcore setup: %u CPUs, at most %u",
+        MYF(0),
+        nb_cpus, (unsigned)RTE_MAX_LCORE);
+    return -EINVAL;
+  }
+
+  for (i = 0; i < nb_cpus; i++) {
+    cfg = &lcore_config[i];
+    cfg->cpu = cpus[i];
+    cfg->state = WAIT;
+    cfg->stop = 0;
+    pthread_mutex_init(&cfg->lock, NULL);
+    pthread_cond_init(&cfg->cond, NULL);
+  }
+
+  /* the calling thread is the main lcore */
+  lcore_config[0].thread = pthread_self();
+  if (pin_thread(lcore_config[0].thread, cpus[0]) != 0) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot pin main lcore on CPU %d",
+        MYF(0),
+        cpus[0]);
+    return -EINVAL;
+  }
+  RTE_PER_LCORE(_lcore_id) = 0;
+  lcore_count = 1;
+
+  for (i = 1; i < nb_cpus; i++) {
+    cfg = &lcore_config[i];
+    if (pthread_create(&cfg->thread, NULL, lcore_thread_loop, cfg) != 0) {
+      my_printf_error(ER_UNKNOWN_ERROR,
+          "Cannot create lcore thread",
+          MYF(0));
+      rte_lcore_cleanup();
+      return -ENOMEM;
+    }
+    lcore_count++;
+    if (pin_thread(cfg->thread, cfg->cpu) != 0) {
+      my_printf_error(ER_UNKNOWN_ERROR,
+          "Cannot pin lcore %u on CPU %d",
+          MYF(0),
+          i, cfg->cpu);
+      rte_lcore_cleanup();
+      return -EINVAL;
+    }
+  }
+
+  return lcore_count;
+}
+
+int rte_lcore_init(void)
+{
+  int cpus[RTE_MAX_LCORE];
+  cpu_set_t set;
+  unsigned nb = 0;
+  int cpu;
+
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot get the CPU affinity",
+        MYF(0));
+    return -errno;
+  }
+
+  for (cpu = 0; cpu < CPU_SETSIZE && nb < RTE_MAX_LCORE; cpu++)
+    if (CPU_ISSET(cpu, &set))
+      cpus[nb++] = cpu;
+
+  return rte_lcore_init_cpus(cpus, nb);
+}
+
+void rte_lcore_cleanup(void)
+{
+  struct lcore_config *cfg;
+  unsigned i;
+
+  for (i = 1; i < lcore_count; i++) {
+    cfg = &lcore_config[i];
+    pthread_mutex_lock(&cfg->lock);
+    cfg->stop = 1;
+    pthread_cond_broadcast(&cfg->cond);
+    pthread_mutex_unlock(&cfg->lock);
+    pthread_join(cfg->thread, NULL);
+  }
+  for (i = 0; i < lcore_count; i++) {
+    pthread_mutex_destroy(&lcore_config[i].lock);
+    pthread_cond_destroy(&lcore_config[i].cond);
+  }
+
+  RTE_PER_LCORE(_lcore_id) = LCORE_ID_ANY;
+  lcore_count = 0;
+}
+
+unsigned rte_lcore_count(void)
+{
+  return lcore_count;
+}
+
+unsigned rte_get_main_lcore(void)
+{
+  return 0;
+}
+
+int rte_lcore_to_cpu_id(unsigned lcore_id)
+{
+  if (lcore_id >= lcore_count)
+    return -1;
+  return lcore_config[lcore_id].cpu;
+}
+
+enum rte_lcore_state_t rte_eal_get_lcore_state(unsigned lcore_id)
+{
+  struct lcore_config *cfg;
+  enum rte_lcore_state_t state;
+
+  /* an lcore that does not exist runs nothing */
+  if (lcore_id >= lcore_count)
+    return WAIT;
+
+  cfg = &lcore_config[lcore_id];
+  pthread_mutex_lock(&cfg->lock);
+  state = cfg->state;
+  pthread_mutex_unlock(&cfg->lock);
+  return state;
+}
+
+int rte_eal_remote_launch(lcore_function_t *f, void *arg, unsigned worker_id)
+{
+  struct lcore_config *cfg;
+
+  if (worker_id == 0 || worker_id >= lcore_count)
+    return -EINVAL;
+
+  cfg = &lcore_config[worker_id];
+  pthread_mutex_lock(&cfg->lock);
+  if (cfg->state != WAIT) {
+    pthread_mutex_unlock(&cfg->lock);
+    return -EBUSY;
+  }
+  cfg->f = f;
+  cfg->arg = arg;
+  cfg->state = RUNNING;
+  pthread_cond_broadcast(&cfg->cond);
+  pthread_mutex_unlock(&cfg->lock);
+  return 0;
+}
+
+int rte_eal_mp_remote_launch(lcore_function_t *f, void *arg)
+{
+  unsigned i;
+
+  RTE_LCORE_FOREACH_WORKER(i)
+    if (rte_eal_get_lcore_state(i) != WAIT)
+      return -EBUSY;
+
+  RTE_LCORE_FOREACH_WORKER(i)
+    rte_eal_remote_launch(f, arg, i);
+  return 0;
+}
+
+int rte_eal_wait_lcore(unsigned worker_id)
+{
+  struct lcore_config *cfg;
+  int ret = 0;
+
+  if (worker_id == 0 || worker_id >= lcore_count)
+    return 0;
+
+  cfg = &lcore_config[worker_id];
+  pthread_mutex_lock(&cfg->lock);
+  while (cfg->state == RUNNING)
+    pthread_cond_wait(&cfg->cond, &cfg->lock);
+  if (cfg->state == FINISHED) {
+    ret = cfg->ret;
+    cfg->state = WAIT;
+  }
+  pthread_mutex_unlock(&cfg->lock);
+  return ret;
+}
+
+void rte_eal_mp_wait_lcore(void)
+{
+  unsigned i;
+
+  RTE_LCORE_FOREACH_WORKER(i)
+    rte_eal_wait_lcore(i);
+}
+
+unsigned rte_get_next_lcore(unsigned i, int skip_main, int wrap)
+{
+  i++;
+  if (wrap)
+    i %= lcore_count;
+  if (skip_main && i == rte_get_main_lcore())
+    i++;
+  if (i >= lcore_count)
+    return RTE_MAX_LCORE;
+  return i;
+}
@@ -0,0 +1,201 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _RTE_LCORE_H_
+#define _RTE_LCORE_H_
+
+/**
+ * @file
+ * RTE lcores
+ *
+ * A minimal DPDK-like environment layer for the pinned threads rte_ring is
+ * designed for. rte_lcore_init() enumerates the CPUs the process may run on
+ * and gives each one an lcore: the calling thread becomes the main lcore,
+ * pinned to the first CPU, and a worker thread is started and pinned on
+ * each of the others. Workers sleep until a function is launched on them
+ * with rte_eal_remote_launch().
+ *
+ * Each lcore thread knows its id through rte_lcore_id(), which indexes
+ * per-lcore data defined with RTE_DEFINE_LCORE_VAR(): one cache line aligned
+ * slot per lcore, so lcores never share a line and the data of any lcore can
+ * be read by the others (e.g. to aggregate statistics).
+ */
+
+#include <stdint.h>
+#include <errno.h>
+
+#include <rte_common.h>
+
+#define RTE_MAX_LCORE 128          /**< Maximum number of lcores. */
+#define LCORE_ID_ANY UINT32_MAX    /**< Id of threads that are not lcores. */
+
+/** Thread local variable, DPDK style. */
+#define RTE_DEFINE_PER_LCORE(type, name) \
+  __thread __typeof__(type) per_lcore_##name
+
+/** Declaration of a variable defined with RTE_DEFINE_PER_LCORE(). */
+#define RTE_DECLARE_PER_LCORE(type, name) \
+  extern __thread __typeof__(type) per_lcore_##name
+
+/** Access to a variable defined with RTE_DEFINE_PER_LCORE(). */
+#define RTE_PER_LCORE(name) (per_lcore_##name)
+
+/** @internal one cache line aligned slot of a per-lcore array */
+template <typename T>
+struct rte_lcore_var_slot {
+  T v __rte_cache_aligned;
+};
+
+/** Per-lcore variable: one cache aligned instance per lcore, in an array. */
+#define RTE_DEFINE_LCORE_VAR(type, name) \
+  struct rte_lcore_var_slot<type> name[RTE_MAX_LCORE]
+
+/** Declaration of a variable defined with RTE_DEFINE_LCORE_VAR(). */
+#define RTE_DECLARE_LCORE_VAR(type, name) \
+  extern struct rte_lcore_var_slot<type> name[RTE_MAX_LCORE]
+
+/** Instance of a per-lcore variable belonging to a given lcore. */
+#define RTE_LCORE_VAR_LCORE(name, lcore_id) ((name)[lcore_id].v)
+
+/** Instance of a per-lcore variable belonging to the calling lcore. */
+#define RTE_LCORE_VAR(name) RTE_LCORE_VAR_LCORE(name, rte_lcore_id())
+
+/** Function launched on an lcore. Its return value is given back by
+ * rte_eal_wait_lcore(). */
+typedef int (lcore_function_t)(void *arg);
+
+/** State of an lcore. */
+enum rte_lcore_state_t {
+  WAIT,                    /**< Waiting for a function to run. */
+  RUNNING,                 /**< Running a function. */
+  FINISHED                 /**< Done, rte_eal_wait_lcore() not called yet. */
+};
+
+RTE_DECLARE_PER_LCORE(unsigned, _lcore_id);
+
+/**
+ * Return the id of the calling lcore.
+ *
+ * @return
+ *   The lcore id, or LCORE_ID_ANY for threads that are not lcores.
+ */
+  static inline unsigned
+rte_lcore_id(void)
+{
+  return RTE_PER_LCORE(_lcore_id);
+}
+
+/**
+ * Set up the lcores on the CPUs of the process affinity.
+ *
+ * @return
+ *   The number of lcores on success, a negative value on error.
+ */
+int rte_lcore_init(void);
+
+/**
+ * Set up the lcores on the given CPUs.
+ *
+ * @param cpus
+ *   The CPUs, the first one for the main lcore.
+ * @param nb_cpus
+ *   The number of CPUs, at most RTE_MAX_LCORE.
+ * @return
+ *   The number of lcores on success, a negative value on error.
+ */
+int rte_lcore_init_cpus(const int *cpus, unsigned nb_cpus);
+
+/**
+ * Stop the worker lcores. They must all be waiting.
+ */
+void rte_lcore_cleanup(void);
+
+/**
+ * Return the number of lcores, main included.
+ */
+unsigned rte_lcore_count(void);
+
+/**
+ * Return the id of the main lcore.
+ */
+unsigned rte_get_main_lcore(void);
+
+/**
+ * Return the CPU an lcore is pinned to.
+ *
+ * @param lcore_id
+ *   The lcore.
+ * @return
+ *   The CPU, -1 if the lcore does not exist.
+ */
+int rte_lcore_to_cpu_id(unsigned lcore_id);
+
+/**
+ * Return the state of an lcore.
+ *
+ * @param lcore_id
+ *   The lcore.
+ * @return
+ *   The state, WAIT if the lcore does not exist.
+ */
+enum rte_lcore_state_t rte_eal_get_lcore_state(unsigned lcore_id);
+
+/**
+ * Launch a function on a worker lcore.
+ *
+ * @param f
+ *   The function.
+ * @param arg
+ *   Its argument.
+ * @param worker_id
+ *   The worker lcore, which must be in the WAIT state.
+ * @return
+ *   - 0: Success.
+ *   - -EBUSY: The lcore is not waiting.
+ *   - -EINVAL: The lcore is not a worker.
+ */
+int rte_eal_remote_launch(lcore_function_t *f, void *arg, unsigned worker_id);
+
+/**
+ * Launch a function on all the worker lcores.
+ *
+ * @return
+ *   0 on success, -EBUSY if a worker is not waiting (nothing is launched).
+ */
+int rte_eal_mp_remote_launch(lcore_function_t *f, void *arg);
+
+/**
+ * Wait until a worker lcore has finished its function.
+ *
+ * @param worker_id
+ *   The worker lcore.
+ * @return
+ *   The return value of the function, 0 if the lcore was waiting.
+ */
+int rte_eal_wait_lcore(unsigned worker_id);
+
+/**
+ * Wait until all the worker lcores have finished their function.
+ */
+void rte_eal_mp_wait_lcore(void);
+
+/**
+ * Return the next lcore after *i*.
+ *
+ * @param i
+ *   The current lcore, or -1 to start.
+ * @param skip_main
+ *   Skip the main lcore.
+ * @param wrap
+ *   Wrap around to the first lcore after the last one.
+ * @return
+ *   The next lcore, RTE_MAX_LCORE when there is none.
+ */
+unsigned rte_get_next_lcore(unsigned i, int skip_main, int wrap);
+
+/** Iterate over the worker lcores. */
+#define RTE_LCORE_FOREACH_WORKER(i) \
+  for (i = rte_get_next_lcore(-1, 1, 0); i < RTE_MAX_LCORE; \
+      i = rte_get_next_lcore(i, 1, 0))
+
+#endif /* _RTE_LCORE_H_ */
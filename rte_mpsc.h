@@ -0,0 +1,243 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _RTE_MPSC_H_
+#define _RTE_MPSC_H_
+
+/**
+ * @file
+ * RTE MPSC queue
+ *
+ * An unbounded, intrusive, multi-producer single-consumer queue (Dmitry
+ * Vyukov's design) for traffic that cannot be bounded in advance, such as
+ * control messages. Objects embed a struct rte_mpsc_node at a fixed offset
+ * given at initialization, so no memory is allocated on enqueue.
+ *
+ * - Enqueue is wait-free: one atomic exchange per call, whatever the number
+ *   of objects enqueued.
+ * - Dequeue is single-consumer and lockless. An enqueue preempted between
+ *   its exchange and its link makes the objects after it invisible until it
+ *   resumes: dequeue then reports the queue as empty.
+ *
+ * The enqueue and dequeue functions mirror the rte_ring ones, and
+ * rte_queue.h provides overloads over both so callers can switch
+ * implementations.
+ */
+
+#include <stdint.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include "rte_ring.h"
+
+/** Link embedded in the objects put in a rte_mpsc queue. */
+struct rte_mpsc_node {
+  struct rte_mpsc_node * volatile next; /**< Next node towards the head. */
+};
+
+/** An RTE MPSC queue structure. */
+struct rte_mpsc {
+  /** Last node enqueued, swapped by producers. */
+  struct rte_mpsc_node * volatile head __rte_cache_aligned;
+  char pad0 __rte_cache_aligned; /**< empty cache line */
+
+  /** Next node to dequeue, owned by the consumer. */
+  struct rte_mpsc_node *tail __rte_cache_aligned;
+  struct rte_mpsc_node stub; /**< Placeholder keeping the list non-empty. */
+  size_t node_offset;        /**< Offset of the node in the objects. */
+  char pad1 __rte_cache_aligned; /**< empty cache line */
+};
+
+/**
+ * Initialize an MPSC queue.
+ *
+ * @param q
+ *   The queue.
+ * @param node_offset
+ *   Offset of the struct rte_mpsc_node in the objects that will be
+ *   enqueued, e.g. offsetof(struct my_msg, node).
+ */
+  static inline void
+rte_mpsc_init(struct rte_mpsc *q, size_t node_offset)
+{
+  q->stub.next = NULL;
+  q->head = &q->stub;
+  q->tail = &q->stub;
+  q->node_offset = node_offset;
+}
+
+/* @internal node of an object, and back */
+  static __rte_always_inline struct rte_mpsc_node *
+__rte_mpsc_node(const struct rte_mpsc *q, void *obj)
+{
+  return (struct rte_mpsc_node *)((char *)obj + q->node_offset);
+}
+
+  static __rte_always_inline void *
+__rte_mpsc_obj(const struct rte_mpsc *q, struct rte_mpsc_node *node)
+{
+  return (char *)node - q->node_offset;
+}
+
+/* @internal append the already linked chain first..last */
+  static __rte_always_inline void
+__rte_mpsc_push(struct rte_mpsc *q, struct rte_mpsc_node *first,
+    struct rte_mpsc_node *last)
+{
+  struct rte_mpsc_node *prev;
+
+  last->next = NULL;
+  prev = __atomic_exchange_n(&q->head, last, __ATOMIC_ACQ_REL);
+  __RTE_RING_PREEMPT_POINT(NULL, 1);
+  __atomic_store_n(&prev->next, first, __ATOMIC_RELEASE);
+}
+
+/**
+ * Enqueue several objects on an MPSC queue (multi-producers safe).
+ *
+ * The objects are linked together first and appended with a single atomic
+ * exchange, so they are seen contiguous by the consumer.
+ *
+ * @param q
+ *   The queue.
+ * @param obj_table
+ *   A pointer to a table of objects, each embedding a node.
+ * @param n
+ *   The number of objects.
+ * @param free_space
+ *   if non-NULL, returns UINT_MAX: the queue is unbounded.
+ * @return
+ *   - n: The queue never refuses objects.
+ */
+  static __rte_always_inline unsigned int
+rte_mpsc_enqueue_burst(struct rte_mpsc *q, void * const *obj_table,
+    unsigned int n, unsigned int *free_space)
+{
+  struct rte_mpsc_node *first, *node;
+  unsigned int i;
+
+  if (free_space != NULL)
+    *free_space = UINT_MAX;
+  if (n == 0)
+    return 0;
+
+  first = node = __rte_mpsc_node(q, obj_table[0]);
+  for (i = 1; i < n; i++) {
+    node->next = __rte_mpsc_node(q, obj_table[i]);
+    node = node->next;
+  }
+  __rte_mpsc_push(q, first, node);
+  return n;
+}
+
+/**
+ * Enqueue one object on an MPSC queue (multi-producers safe).
+ *
+ * @param q
+ *   The queue.
+ * @param obj
+ *   The object, embedding a node.
+ * @return
+ *   - 0: Success; the queue never refuses objects.
+ */
+  static __rte_always_inline int
+rte_mpsc_enqueue(struct rte_mpsc *q, void *obj)
+{
+  struct rte_mpsc_node *node = __rte_mpsc_node(q, obj);
+
+  __rte_mpsc_push(q, node, node);
+  return 0;
+}
+
+/**
+ * Dequeue one object from an MPSC queue (NOT multi-consumers safe).
+ *
+ * @param q
+ *   The queue.
+ * @param obj_p
+ *   A pointer to a void * pointer (object) that will be filled.
+ * @return
+ *   - 0: Success, object dequeued.
+ *   - -ENOENT: The queue is empty, or the next object is being enqueued.
+ */
+  static __rte_always_inline int
+rte_mpsc_dequeue(struct rte_mpsc *q, void **obj_p)
+{
+  struct rte_mpsc_node *tail = q->tail;
+  struct rte_mpsc_node *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+  /* skip the stub */
+  if (tail == &q->stub) {
+    if (next == NULL)
+      return -ENOENT;
+    q->tail = tail = next;
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+  }
+
+  if (next != NULL) {
+    q->tail = next;
+    *obj_p = __rte_mpsc_obj(q, tail);
+    return 0;
+  }
+
+  /* tail is the last node linked: unless a producer is between its
+   * exchange and its link, put the stub back behind it to release it */
+  if (tail != __atomic_load_n(&q->head, __ATOMIC_ACQUIRE))
+    return -ENOENT;
+  __rte_mpsc_push(q, &q->stub, &q->stub);
+
+  next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+  if (next == NULL)
+    return -ENOENT;
+  q->tail = next;
+  *obj_p = __rte_mpsc_obj(q, tail);
+  return 0;
+}
+
+/**
+ * Dequeue objects from an MPSC queue up to a maximum number (NOT
+ * multi-consumers safe).
+ *
+ * @param q
+ *   The queue.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects) that will be filled.
+ * @param n
+ *   The number of objects to dequeue.
+ * @param available
+ *   If non-NULL, returns 1 if more objects are ready to be dequeued, 0
+ *   otherwise: the queue does not keep a count.
+ * @return
+ *   - Number of objects dequeued
+ */
+  static __rte_always_inline unsigned int
+rte_mpsc_dequeue_burst(struct rte_mpsc *q, void **obj_table, unsigned int n,
+    unsigned int *available)
+{
+  unsigned int i;
+
+  for (i = 0; i < n; i++)
+    if (rte_mpsc_dequeue(q, &obj_table[i]) != 0)
+      break;
+
+  if (available != NULL)
+    *available = (i == n && (q->tail != &q->stub || q->stub.next != NULL));
+  return i;
+}
+
+/**
+ * Test if an MPSC queue is empty.
+ *
+ * @param q
+ *   The queue.
+ * @return
+ *   - 1: No object is enqueued, or being enqueued.
+ *   - 0: The queue is not empty.
+ */
+  static inline int
+rte_mpsc_empty(const struct rte_mpsc *q)
+{
+  return q->tail == &q->stub && q->head == &q->stub;
+}
+
+#endif /* _RTE_MPSC_H_ */
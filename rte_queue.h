@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _RTE_QUEUE_H_
+#define _RTE_QUEUE_H_
+
+/**
+ * @file
+ * RTE queue interface
+ *
+ * Overloads of the common enqueue/dequeue operations over the queue
+ * implementations, so that callers, typically templates, can switch between
+ * them by changing a type:
+ *
+ * - struct rte_ring: bounded FIFO, with the ring default sync modes.
+ * - struct rte_deque: bounded, two-lock, used as a FIFO (push back, pop
+ *   front).
+ * - struct rte_mpsc: unbounded, intrusive, single consumer.
+ *
+ * The return values follow the rte_ring conventions.
+ */
+
+#include "rte_ring.h"
+#include "rte_deque.h"
+#include "rte_mpsc.h"
+
+  static __rte_always_inline unsigned int
+rte_queue_enqueue_burst(struct rte_ring *r, void * const *obj_table,
+    unsigned int n, unsigned int *free_space)
+{
+  return rte_ring_enqueue_burst(r, obj_table, n, free_space);
+}
+
+  static __rte_always_inline unsigned int
+rte_queue_enqueue_burst(struct rte_deque *d, void * const *obj_table,
+    unsigned int n, unsigned int *free_space)
+{
+  return rte_deque_push_back_burst(d, obj_table, n, free_space);
+}
+
+  static __rte_always_inline unsigned int
+rte_queue_enqueue_burst(struct rte_mpsc *q, void * const *obj_table,
+    unsigned int n, unsigned int *free_space)
+{
+  return rte_mpsc_enqueue_burst(q, obj_table, n, free_space);
+}
+
+  static __rte_always_inline unsigned int
+rte_queue_dequeue_burst(struct rte_ring *r, void **obj_table, unsigned int n,
+    unsigned int *available)
+{
+  return rte_ring_dequeue_burst(r, obj_table, n, available);
+}
+
+  static __rte_always_inline unsigned int
+rte_queue_dequeue_burst(struct rte_deque *d, void **obj_table, unsigned int n,
+    unsigned int *available)
+{
+  return rte_deque_pop_front_burst(d, obj_table, n, available);
+}
+
+  static __rte_always_inline unsigned int
+rte_queue_dequeue_burst(struct rte_mpsc *q, void **obj_table, unsigned int n,
+    unsigned int *available)
+{
+  return rte_mpsc_dequeue_burst(q, obj_table, n, available);
+}
+
+/**
+ * Enqueue one object.
+ *
+ * @return
+ *   - 0: Success; object enqueued.
+ *   - -ENOBUFS: Not enough room in the queue; no object is enqueued.
+ */
+template <typename Q>
+  static __rte_always_inline int
+rte_queue_enqueue(Q *q, void *obj)
+{
+  return rte_queue_enqueue_burst(q, &obj, 1, NULL) ? 0 : -ENOBUFS;
+}
+
+/**
+ * Dequeue one object.
+ *
+ * @return
+ *   - 0: Success; object dequeued.
+ *   - -ENOENT: No object ready in the queue.
+ */
+template <typename Q>
+  static __rte_always_inline int
+rte_queue_dequeue(Q *q, void **obj_p)
+{
+  return rte_queue_dequeue_burst(q, obj_p, 1, NULL) ? 0 : -ENOENT;
+}
+
+#endif /* _RTE_QUEUE_H_ */
@@ -14,6 +14,8 @@
 #include <inttypes.h>
 #include <errno.h>
 #include <sys/queue.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include <my_global.h>
 #include <my_sys.h>
@@ -41,6 +43,21 @@ ssize_t rte_ring_get_memsize(unsigned count)
   return sz;
 }
 
+/* return the size of memory occupied by a ring with these flags */
+ssize_t rte_ring_get_memsize_flags(unsigned count, unsigned flags)
+{
+  ssize_t sz;
+
+  sz = rte_ring_get_memsize(count);
+  if (sz < 0 || !(flags & RING_F_SOJOURN))
+    return sz;
+
+  /* shadow timestamps after the slots, then the statistics */
+  sz = sizeof(struct rte_ring) + count * (sizeof(void *) + sizeof(uint64_t));
+  sz = RTE_ALIGN(sz, RTE_CACHE_LINE_SIZE) + sizeof(struct rte_ring_sojourn);
+  return sz;
+}
+
 int rte_ring_init(struct rte_ring *r, unsigned count, unsigned flags)
 {
   /* compilation-time checks */
@@ -76,26 +93,141 @@ int rte_ring_init(struct rte_ring *r, unsigned count, unsigned flags)
   r->prod.head = r->cons.head = 0;
   r->prod.tail = r->cons.tail = 0;
 
+  if (flags & RING_F_SPARSE) {
+    r->reclaim.low_watermark = r->capacity / 16;
+    r->reclaim.idle_rounds = 64;
+  }
+
+  if (flags & RING_F_SOJOURN)
+    memset(__rte_ring_sojourn_stats(r), 0, sizeof(struct rte_ring_sojourn));
+
   return 0;
 }
 
+/* my_malloc() only guarantees word alignment: over-allocate and keep the
+ * raw pointer just below the aligned block */
+static void *rte_ring_my_malloc_alloc(size_t size, size_t align, void *ctx)
+{
+  char *raw;
+  uintptr_t p;
+
+  (void)ctx;
+  raw = (char *)my_malloc(size + align + sizeof(void *), MYF(MY_WME));
+  if (raw == NULL)
+    return NULL;
+
+  p = RTE_ALIGN_CEIL((uintptr_t)(raw + sizeof(void *)), (uintptr_t)align);
+  ((void **)p)[-1] = raw;
+  return (void *)p;
+}
+
+static void rte_ring_my_malloc_free(void *ptr, size_t size, void *ctx)
+{
+  (void)size;
+  (void)ctx;
+  my_free(((void **)ptr)[-1]);
+}
+
+const struct rte_ring_alloc_ops rte_ring_my_malloc_ops = {
+  rte_ring_my_malloc_alloc,
+  rte_ring_my_malloc_free,
+  NULL
+};
+
+static void *rte_ring_posix_memalign_alloc(size_t size, size_t align,
+    void *ctx)
+{
+  void *p;
+
+  (void)ctx;
+  if (posix_memalign(&p, align, size) != 0)
+    return NULL;
+  return p;
+}
+
+static void rte_ring_posix_memalign_free(void *ptr, size_t size, void *ctx)
+{
+  (void)size;
+  (void)ctx;
+  free(ptr);
+}
+
+const struct rte_ring_alloc_ops rte_ring_posix_memalign_ops = {
+  rte_ring_posix_memalign_alloc,
+  rte_ring_posix_memalign_free,
+  NULL
+};
+
+/* anonymous mapping, only reserved: the kernel commits pages on first write */
+static void *rte_ring_mmap_alloc(size_t size, size_t align, void *ctx)
+{
+  void *p;
+
+  (void)ctx;
+  if (align > (size_t)sysconf(_SC_PAGESIZE))
+    return NULL;
+  p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  return p == MAP_FAILED ? NULL : p;
+}
+
+static void rte_ring_mmap_free(void *ptr, size_t size, void *ctx)
+{
+  (void)ctx;
+  munmap(ptr, size);
+}
+
+const struct rte_ring_alloc_ops rte_ring_mmap_ops = {
+  rte_ring_mmap_alloc,
+  rte_ring_mmap_free,
+  NULL
+};
+
+/* defined in every build, so that only users of the hook need the define */
+rte_ring_preempt_hook_t rte_ring_preempt_hook = NULL;
+
 /* create the ring */
 struct rte_ring* rte_ring_create(unsigned count, unsigned flags)
+{
+  return rte_ring_create_with_allocator(count, flags,
+      (flags & RING_F_SPARSE) ? &rte_ring_mmap_ops :
+      &RTE_RING_DEFAULT_ALLOC_OPS);
+}
+
+/* create the ring in memory provided by the given allocator */
+struct rte_ring* rte_ring_create_with_allocator(unsigned count, unsigned flags,
+    const struct rte_ring_alloc_ops *ops)
 {
   struct rte_ring *r;
   ssize_t ring_size;
   const unsigned int requested_count = count;
 
+  if (ops == NULL || ops->alloc == NULL || ops->free == NULL) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Invalid ring allocator",
+        MYF(0));
+    return NULL;
+  }
+
+  /* pages are dropped with madvise(), which is only meaningful (and safe)
+   * on a private anonymous mapping */
+  if ((flags & RING_F_SPARSE) && ops->alloc != rte_ring_mmap_ops.alloc) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Sparse rings must be allocated with rte_ring_mmap_ops",
+        MYF(0));
+    return NULL;
+  }
+
   /* for an exact size ring, round up from count to a power of two */
   if (flags & RING_F_EXACT_SZ)
     count = rte_align32pow2(count + 1);
 
-  ring_size = rte_ring_get_memsize(count);
+  ring_size = rte_ring_get_memsize_flags(count, flags);
   if (ring_size < 0) {
     return NULL;
   }
 
-  r = (struct rte_ring*)my_malloc(ring_size, MYF(MY_WME));
+  r = (struct rte_ring*)ops->alloc(ring_size, RTE_RING_ALLOC_ALIGN, ops->ctx);
   if (r == NULL) {
     my_printf_error(ER_UNKNOWN_ERROR,
         "Cannot reserve memory",
@@ -103,12 +235,25 @@ struct rte_ring* rte_ring_create(unsigned count, unsigned flags)
     return NULL;
   }
 
+  if (((uintptr_t)r & (RTE_RING_ALLOC_ALIGN - 1)) != 0) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Ring allocator returned memory not aligned on %u bytes",
+        MYF(0),
+        (unsigned)RTE_RING_ALLOC_ALIGN);
+    ops->free(r, ring_size, ops->ctx);
+    return NULL;
+  }
+
   if (rte_ring_init(r, requested_count, flags) != 0)
   {
-    rte_ring_free(r);
+    ops->free(r, ring_size, ops->ctx);
     return NULL;
   }
 
+  /* rte_ring_init() clears the structure, so record the owner afterwards */
+  r->alloc = *ops;
+  r->memsize = ring_size;
+
   return r;
 }
 
@@ -118,8 +263,206 @@ void rte_ring_free(struct rte_ring *r)
   if (r == NULL)
     return;
 
-  my_free(r);
+  /* set up with rte_ring_init() in caller memory */
+  if (r->alloc.free == NULL)
+    return;
+
+  r->alloc.free(r, r->memsize, r->alloc.ctx);
 
   return;
 }
 
+int rte_ring_set_reclaim(struct rte_ring *r, unsigned low_watermark,
+    unsigned idle_rounds)
+{
+  if (!(r->flags & RING_F_SPARSE))
+    return -EINVAL;
+
+  r->reclaim.low_watermark = low_watermark;
+  r->reclaim.idle_rounds = idle_rounds;
+  r->reclaim.idle = 0;
+  return 0;
+}
+
+/* release the pages lying entirely inside n slots starting at idx */
+static size_t rte_ring_drop_slots(struct rte_ring *r, uint32_t idx, uint32_t n)
+{
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  void **ring = (void **)&r[1];
+  uintptr_t start, end;
+
+  start = RTE_ALIGN_CEIL((uintptr_t)&ring[idx], page_size);
+  end = RTE_ALIGN_FLOOR((uintptr_t)&ring[idx + n], page_size);
+  if (end <= start)
+    return 0;
+
+#if defined(RTE_RING_RECLAIM_LAZY) && defined(MADV_FREE)
+  /* cheaper, but pages only leave RSS under memory pressure */
+  if (madvise((void *)start, end - start, MADV_FREE) == 0)
+    return end - start;
+#endif
+  if (madvise((void *)start, end - start, MADV_DONTNEED) != 0)
+    return 0;
+  return end - start;
+}
+
+ssize_t rte_ring_reclaim(struct rte_ring *r)
+{
+  uint32_t prod_head, cons_tail, start, n, idx;
+  size_t released;
+
+  if (!(r->flags & RING_F_SPARSE))
+    return -EINVAL;
+
+  /* the caller is the only producer, so prod.head is stable; cons.tail may
+   * only move forward, which grows the free part of the ring */
+  prod_head = r->prod.head;
+  cons_tail = r->cons.tail;
+  rte_smp_rmb();
+
+  if (prod_head - cons_tail > r->reclaim.low_watermark) {
+    r->reclaim.idle = 0;
+    return 0;
+  }
+  if (++r->reclaim.idle < r->reclaim.idle_rounds)
+    return 0;
+  r->reclaim.idle = 0;
+
+  /* free slots are [prod_head, cons_tail + size), keep a watermark worth of
+   * them committed for the next enqueues */
+  n = cons_tail + r->size - prod_head;
+  if (n <= r->reclaim.low_watermark)
+    return 0;
+  start = prod_head + r->reclaim.low_watermark;
+  n -= r->reclaim.low_watermark;
+
+  idx = start & r->mask;
+  if (idx + n <= r->size)
+    return rte_ring_drop_slots(r, idx, n);
+
+  released = rte_ring_drop_slots(r, idx, r->size - idx);
+  released += rte_ring_drop_slots(r, 0, n - (r->size - idx));
+  return released;
+}
+
+/* add to a sojourn counter, atomically unless the consumer is alone */
+static inline void rte_ring_sojourn_add(uint64_t *counter, uint64_t v,
+    unsigned int is_sc)
+{
+  if (is_sc)
+    *counter += v;
+  else
+    __sync_fetch_and_add(counter, v);
+}
+
+void __rte_ring_sojourn_fold(struct rte_ring *r, uint32_t head,
+    unsigned int n, unsigned int is_sc)
+{
+  struct rte_ring_sojourn *st = __rte_ring_sojourn_stats(r);
+  const uint64_t *tsc = __rte_ring_sojourn_tsc(r);
+  const uint64_t now = rte_rdtsc();
+  uint64_t d, sum = 0, max = 0, old;
+  unsigned int i, b, bucket = 0, run = 0;
+
+  /* objects enqueued by the same burst share a stamp and usually a bucket:
+   * add runs of the same bucket at once */
+  for (i = 0; i < n; i++) {
+    d = now - tsc[(head + i) & r->mask];
+    /* stamped by a core whose TSC is slightly ahead */
+    if ((int64_t)d < 0)
+      d = 0;
+    sum += d;
+    if (d > max)
+      max = d;
+    b = d == 0 ? 0 : 64 - __builtin_clzll(d);
+    if (b != bucket && run != 0) {
+      rte_ring_sojourn_add(&st->hist[bucket], run, is_sc);
+      run = 0;
+    }
+    bucket = b;
+    run++;
+  }
+  rte_ring_sojourn_add(&st->hist[bucket], run, is_sc);
+  rte_ring_sojourn_add(&st->count, n, is_sc);
+  rte_ring_sojourn_add(&st->sum, sum, is_sc);
+
+  if (is_sc) {
+    if (max > st->max)
+      st->max = max;
+    return;
+  }
+  do {
+    old = st->max;
+  } while (max > old && !__sync_bool_compare_and_swap(&st->max, old, max));
+}
+
+int rte_ring_sojourn_get(const struct rte_ring *r,
+    struct rte_ring_sojourn *stats)
+{
+  if (!(r->flags & RING_F_SOJOURN))
+    return -EINVAL;
+
+  memcpy(stats, __rte_ring_sojourn_stats(r), sizeof(*stats));
+  return 0;
+}
+
+int rte_ring_sojourn_reset(struct rte_ring *r)
+{
+  if (!(r->flags & RING_F_SOJOURN))
+    return -EINVAL;
+
+  memset(__rte_ring_sojourn_stats(r), 0, sizeof(struct rte_ring_sojourn));
+  return 0;
+}
+
+uint64_t rte_ring_sojourn_percentile(const struct rte_ring_sojourn *stats,
+    double q)
+{
+  uint64_t rank, seen = 0, bound;
+  unsigned int b;
+
+  if (stats->count == 0)
+    return 0;
+
+  rank = (uint64_t)(q * stats->count + 0.5);
+  if (rank == 0)
+    rank = 1;
+  for (b = 0; b < RTE_RING_SOJOURN_HIST; b++) {
+    seen += stats->hist[b];
+    if (seen >= rank)
+      break;
+  }
+  if (b == RTE_RING_SOJOURN_HIST)
+    return stats->max;
+  bound = b == 0 ? 0 : ((uint64_t)1 << b) - 1;
+  return bound < stats->max ? bound : stats->max;
+}
+
+void rte_ring_sojourn_dump(FILE *f, const struct rte_ring *r)
+{
+  struct rte_ring_sojourn st;
+  const double us = 1e6 / rte_get_tsc_hz();
+  unsigned int b;
+
+  if (rte_ring_sojourn_get(r, &st) != 0) {
+    fprintf(f, "ring <%p>: sojourn times not measured\n", (const void *)r);
+    return;
+  }
+
+  fprintf(f, "ring <%p>: %" PRIu64 " objects dequeued\n", (const void *)r,
+      st.count);
+  if (st.count == 0)
+    return;
+  fprintf(f, "  sojourn us: mean %.3f, p50 %.3f, p99 %.3f, p99.9 %.3f, "
+      "max %.3f\n", us * st.sum / st.count,
+      us * rte_ring_sojourn_percentile(&st, 0.5),
+      us * rte_ring_sojourn_percentile(&st, 0.99),
+      us * rte_ring_sojourn_percentile(&st, 0.999), us * st.max);
+  fprintf(f, "  histogram (cycles):");
+  for (b = 0; b < RTE_RING_SOJOURN_HIST; b++)
+    if (st.hist[b])
+      fprintf(f, " [%" PRIu64 ",%" PRIu64 "]: %.2f%%",
+          b ? (uint64_t)1 << (b - 1) : 0, b ? ((uint64_t)1 << b) - 1 : 0,
+          100.0 * st.hist[b] / st.count);
+  fprintf(f, "\n");
+}
@@ -34,6 +34,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/queue.h>
 #include <errno.h>
 
@@ -51,6 +52,101 @@ struct rte_ring_headtail {
   uint32_t single;         /**< True if single prod/cons */
 };
 
+/**
+ * Ring storage allocator.
+ *
+ * A set of callbacks used by rte_ring_create_with_allocator() to obtain and
+ * release the memory holding the ring structure and its object table. The
+ * ops are copied into the ring, so they need not outlive the call, but the
+ * context they point to must outlive the ring.
+ */
+struct rte_ring_alloc_ops {
+  /** Return at least *size* bytes aligned on *align*, or NULL. */
+  void *(*alloc)(size_t size, size_t align, void *ctx);
+  /** Release a block previously returned by alloc. */
+  void (*free)(void *ptr, size_t size, void *ctx);
+  void *ctx;               /**< Opaque argument passed to the callbacks. */
+};
+
+/**
+ * Software prefetch applied by the rte_ring_*dequeue_burst_prefetch()
+ * functions.
+ */
+struct rte_ring_prefetch {
+  unsigned int span;       /**< Bytes prefetched from each dequeued object. */
+  unsigned int count;      /**< Max number of objects prefetched per call. */
+  unsigned int next_slots; /**< If non-zero, prefetch next burst's slots. */
+};
+
+/**
+ * One segment of a scatter-gather enqueue (see rte_ring_enqueue_sg()).
+ */
+struct rte_ring_iovec {
+  void * const *objs;      /**< Table of objects of the segment. */
+  unsigned int n;          /**< Number of objects in the table. */
+};
+
+/**
+ * Slots reserved by a zero-copy enqueue (see rte_ring_enqueue_zc_bulk_start()).
+ * The reservation spans two regions when it wraps around the end of the ring.
+ */
+struct rte_ring_zc_data {
+  void **ptr1;             /**< First region of reserved slots. */
+  void **ptr2;             /**< Second region, NULL if the first one is enough. */
+  unsigned int n1;         /**< Number of slots in the first region. */
+};
+
+/**
+ * Visitor invoked by the rte_ring_*dequeue_burst_apply() functions on each
+ * contiguous region of dequeued slots.
+ *
+ * @param objs
+ *   The first slot of the region, in the ring storage (in a buffer for a
+ *   RING_F_TOMBSTONE ring).
+ * @param n
+ *   The number of objects in the region.
+ * @param ctx
+ *   The opaque argument given to the dequeue function.
+ */
+typedef void (*rte_ring_apply_fn_t)(void **objs, unsigned int n, void *ctx);
+
+/**
+ * Key extractor used by rte_ring_dequeue_burst_classify().
+ *
+ * @param obj
+ *   A dequeued object.
+ * @param ctx
+ *   The opaque argument given to the dequeue function.
+ * @return
+ *   The bin of the object.
+ */
+typedef unsigned int (*rte_ring_key_fn_t)(const void *obj, void *ctx);
+
+/**
+ * Idle memory reclamation state of a sparse ring (see RING_F_SPARSE). Only
+ * the producer side touches it, so it shares the producer cache line.
+ */
+struct rte_ring_reclaim {
+  uint32_t low_watermark;  /**< Occupancy at or below which ring is idle. */
+  uint32_t idle_rounds;    /**< Idle observations needed before reclaiming. */
+  uint32_t idle;           /**< Consecutive idle observations so far. */
+};
+
+#define RTE_RING_SOJOURN_HIST 64 /**< Sojourn buckets: log2 of TSC cycles. */
+
+/**
+ * Time spent in a RING_F_SOJOURN ring by the dequeued objects, in TSC cycles.
+ * The consumers update it, so it sits on its own cache line after the
+ * object table and its shadow timestamps.
+ */
+struct rte_ring_sojourn {
+  uint64_t count;          /**< Objects dequeued, or cancelled ones. */
+  uint64_t sum;            /**< Sum of their sojourn times. */
+  uint64_t max;            /**< Longest sojourn time. */
+  /** Objects per sojourn time: bucket 0 is 0, bucket b in [2^(b-1), 2^b). */
+  uint64_t hist[RTE_RING_SOJOURN_HIST];
+} __rte_cache_aligned;
+
 /**
  * An RTE ring structure.
  *
@@ -66,11 +162,15 @@ struct rte_ring {
   uint32_t size;           /**< Size of ring. */
   uint32_t mask;           /**< Mask (size-1) of ring. */
   uint32_t capacity;       /**< Usable size of ring */
+  struct rte_ring_alloc_ops alloc; /**< Allocator owning the ring memory. */
+  size_t memsize;          /**< Bytes obtained from the allocator. */
+  struct rte_ring_recorder *recorder; /**< Traffic recorder, or NULL. */
 
   char pad0 __rte_cache_aligned; /**< empty cache line */
 
   /** Ring producer status. */
   struct rte_ring_headtail prod __rte_cache_aligned;
+  struct rte_ring_reclaim reclaim; /**< Sparse storage reclamation state. */
   char pad1 __rte_cache_aligned; /**< empty cache line */
 
   /** Ring consumer status. */
@@ -89,8 +189,123 @@ struct rte_ring {
  * ring space will be wasted.
  */
 #define RING_F_EXACT_SZ 0x0004
+/**
+ * Ring object table is sparse. The ring is backed by an anonymous mapping
+ * that is only reserved as virtual memory: pages are committed when first
+ * written, and rte_ring_reclaim() gives the pages the indexes are not using
+ * back to the kernel after a period of low occupancy. The full capacity stays
+ * available for bursts.
+ */
+#define RING_F_SPARSE 0x0008
+/**
+ * Ring objects can be cancelled while queued. Producers get a handle for each
+ * object enqueued with rte_ring_enqueue_burst_handle() and can replace it by a
+ * tombstone with rte_ring_cancel(). Every consumer path skips tombstones,
+ * which are not counted in the number of objects returned, so a bulk
+ * dequeue can return from 1 to n - 1 objects when some of the n it reserved
+ * were cancelled and the ring has no more to replace them. Consumers claim
+ * each slot with an atomic exchange, so dequeue is slower than on a plain
+ * ring; the apply and classify functions visit the claimed objects in a
+ * buffer rather than in the ring, and transfers from such a ring go through
+ * a buffer, to a single-producer ring only (see rte_ring_transfer()).
+ */
+#define RING_F_TOMBSTONE 0x0010
+/**
+ * Ring measures how long objects wait in it. Every enqueue stores the TSC in
+ * a shadow array next to the object table, one stamp per slot, so objects
+ * keep their format; every dequeue folds the age of its objects into the
+ * sojourn statistics of the ring (see rte_ring_sojourn_get()). Each side
+ * reads the TSC once per burst. Rings without the flag only pay a test of
+ * it. rte_ring_init() needs the memory given by rte_ring_get_memsize_flags().
+ */
+#define RING_F_SOJOURN 0x0020
+/** Value of a cancelled slot; it must not be enqueued as an object. */
+#define RTE_RING_TOMBSTONE ((void *)(uintptr_t)1)
+
+/**
+ * Handle to a queued object of a RING_F_TOMBSTONE ring: the position of its
+ * slot, valid until the ring index wraps around 2^32.
+ */
+typedef uint32_t rte_ring_handle_t;
 #define RTE_RING_SZ_MASK  (0x7fffffffU) /**< Ring size mask */
 
+/**
+ * Alignment required from a ring storage allocator. The ring structure keeps
+ * the producer and consumer indexes on separate cache lines, which only holds
+ * if the ring itself starts on a cache line boundary.
+ */
+#define RTE_RING_ALLOC_ALIGN RTE_CACHE_LINE_SIZE
+
+/** Allocator built on my_malloc(), the historical ring storage. */
+extern const struct rte_ring_alloc_ops rte_ring_my_malloc_ops;
+/** Allocator built on posix_memalign(), bypassing the server allocator. */
+extern const struct rte_ring_alloc_ops rte_ring_posix_memalign_ops;
+/** Allocator reserving anonymous virtual memory, required by RING_F_SPARSE. */
+extern const struct rte_ring_alloc_ops rte_ring_mmap_ops;
+
+/**
+ * Allocator used by rte_ring_create(). Define it at build time to the name of
+ * another rte_ring_alloc_ops object to change the default storage of rings.
+ */
+#ifndef RTE_RING_DEFAULT_ALLOC_OPS
+#define RTE_RING_DEFAULT_ALLOC_OPS rte_ring_my_malloc_ops
+#endif
+
+/**
+ * Debug hook called by every enqueue and dequeue after the head is moved and
+ * before the tail is published, the window in which a descheduled thread
+ * holds back the other multi-producers or consumers of the ring. Deque
+ * pushes and pops call it between the reservation and the slot accesses,
+ * MPSC enqueues between their exchange and their link.
+ *
+ * It is only called from code built with RTE_RING_DEBUG_PREEMPT defined,
+ * so that benchmarks and stress tools can inject delays there. Other builds
+ * do not even test it.
+ *
+ * @param ht
+ *   The producer or consumer head/tail being updated, NULL for a deque or
+ *   an MPSC queue.
+ * @param enqueue
+ *   1 for the producer side, 0 for the consumer side.
+ */
+typedef void (*rte_ring_preempt_hook_t)(const struct rte_ring_headtail *ht,
+    unsigned int enqueue);
+extern rte_ring_preempt_hook_t rte_ring_preempt_hook;
+
+#ifdef RTE_RING_DEBUG_PREEMPT
+#define __RTE_RING_PREEMPT_POINT(ht, enqueue) do {        \
+    if (unlikely(rte_ring_preempt_hook != NULL))        \
+      rte_ring_preempt_hook(ht, enqueue);               \
+  } while (0)
+#else
+#define __RTE_RING_PREEMPT_POINT(ht, enqueue) do { } while (0)
+#endif
+
+/*
+ * Static tracepoints, built with RTE_RING_USDT defined. They are sys/sdt.h
+ * probes of the rte_ring provider, to attach to with bpftrace or perf
+ * without rebuilding: a NOP in the code and a note in the ELF file while
+ * nobody traces them. Other builds do not have them at all.
+ *
+ * - enqueue(r, n, done, free_space), dequeue(r, n, done, available):
+ *   every enqueue and dequeue path, the prefetching, apply, classify,
+ *   scatter-gather, handle, zero-copy and transfer ones included (a
+ *   transfer fires a dequeue of the source, then an enqueue of the
+ *   destination);
+ * - prod_retry(r, old_head), cons_retry(r, old_head): every failed
+ *   compare-and-set of a multi-producer or multi-consumer head move.
+ */
+#ifdef RTE_RING_USDT
+#include <sys/sdt.h>
+#define __RTE_RING_USDT2(name, a1, a2) \
+  DTRACE_PROBE2(rte_ring, name, a1, a2)
+#define __RTE_RING_USDT4(name, a1, a2, a3, a4) \
+  DTRACE_PROBE4(rte_ring, name, a1, a2, a3, a4)
+#else
+#define __RTE_RING_USDT2(name, a1, a2) do { } while (0)
+#define __RTE_RING_USDT4(name, a1, a2, a3, a4) do { } while (0)
+#endif
+
 /* @internal defines for passing to the enqueue dequeue worker functions */
 #define __IS_SP 1
 #define __IS_MP 0
@@ -113,6 +328,22 @@ struct rte_ring {
  */
 ssize_t rte_ring_get_memsize(unsigned count);
 
+/**
+ * Calculate the memory size needed for a ring created with the given flags.
+ *
+ * Same as rte_ring_get_memsize(), plus the shadow timestamps and statistics
+ * of a RING_F_SOJOURN ring.
+ *
+ * @param count
+ *   The number of elements in the ring (must be a power of 2).
+ * @param flags
+ *   The flags given to rte_ring_init().
+ * @return
+ *   - The memory size needed for the ring on success.
+ *   - -EINVAL if count is not a power of 2.
+ */
+ssize_t rte_ring_get_memsize_flags(unsigned count, unsigned flags);
+
 /**
  * Initialize a ring structure.
  *
@@ -176,14 +407,133 @@ int rte_ring_init(struct rte_ring *r, unsigned count, unsigned flags);
  *    - ENOMEM - no appropriate memory area found in which to create memzone
  */
 struct rte_ring* rte_ring_create(unsigned count, unsigned flags);
+
+/**
+ * Create a new ring in memory obtained from a caller supplied allocator.
+ *
+ * This behaves like rte_ring_create(), but the ring structure and object
+ * table are allocated through *ops*, which lets rings live in arenas, huge
+ * page pools, shared memory or NUMA-local pools. The block returned by the
+ * allocator must be aligned on RTE_RING_ALLOC_ALIGN; a misaligned block is
+ * handed back to the allocator and the creation fails.
+ *
+ * @param count
+ *   The size of the ring (must be a power of 2, unless RING_F_EXACT_SZ).
+ * @param flags
+ *   Same as for rte_ring_create().
+ * @param ops
+ *   The allocator. It is copied into the ring and used again by
+ *   rte_ring_free().
+ * @return
+ *   On success, the pointer to the new allocated ring. NULL on error.
+ */
+struct rte_ring* rte_ring_create_with_allocator(unsigned count, unsigned flags,
+    const struct rte_ring_alloc_ops *ops);
+
 /**
  * De-allocate all memory used by the ring.
  *
+ * The memory is released through the allocator the ring was created with.
+ * Rings set up with rte_ring_init() in caller memory are left untouched.
+ *
  * @param r
  *   Ring to free
  */
 void rte_ring_free(struct rte_ring *r);
 
+/**
+ * Tune idle memory reclamation of a sparse ring.
+ *
+ * @param r
+ *   A ring created with RING_F_SPARSE.
+ * @param low_watermark
+ *   The ring is considered idle when it holds at most this many objects.
+ *   This many free slots past the producer head are also kept committed,
+ *   so that a ring oscillating below the watermark does not fault.
+ * @param idle_rounds
+ *   Number of consecutive idle observations by rte_ring_reclaim() before
+ *   pages are released.
+ * @return
+ *   0 on success, -EINVAL if the ring is not sparse.
+ */
+int rte_ring_set_reclaim(struct rte_ring *r, unsigned low_watermark,
+    unsigned idle_rounds);
+
+/**
+ * Observe the occupancy of a sparse ring and release unused pages.
+ *
+ * Meant to be called periodically, e.g. by the producer between bursts.
+ * After *idle_rounds* consecutive calls finding the ring at or below its low
+ * watermark, the pages of the object table lying entirely in the free part
+ * of the ring (beyond the watermark window past the producer head) are given
+ * back to the kernel with MADV_DONTNEED, or with MADV_FREE when built with
+ * RTE_RING_RECLAIM_LAZY (cheaper, but the pages only leave the RSS under
+ * memory pressure). They are committed again on the next write.
+ *
+ * The caller must be the only thread enqueueing on the ring for the duration
+ * of the call: on a single-producer ring, call it from the producer thread.
+ * Consumers may run concurrently.
+ *
+ * @param r
+ *   A ring created with RING_F_SPARSE.
+ * @return
+ *   - The number of bytes released, possibly 0.
+ *   - -EINVAL if the ring is not sparse.
+ */
+ssize_t rte_ring_reclaim(struct rte_ring *r);
+
+/**
+ * Get the sojourn statistics of a ring.
+ *
+ * The counters are read while consumers may update them, so the copy is not
+ * a consistent snapshot of a busy ring: count, sum and the histogram may be
+ * a few bursts apart.
+ *
+ * @param r
+ *   A ring created with RING_F_SOJOURN.
+ * @param stats
+ *   Filled with a copy of the statistics.
+ * @return
+ *   0 on success, -EINVAL if the ring does not measure sojourn times.
+ */
+int rte_ring_sojourn_get(const struct rte_ring *r,
+    struct rte_ring_sojourn *stats);
+
+/**
+ * Clear the sojourn statistics of a ring. Objects dequeued by a concurrent
+ * consumer may be lost or counted partially.
+ *
+ * @param r
+ *   A ring created with RING_F_SOJOURN.
+ * @return
+ *   0 on success, -EINVAL if the ring does not measure sojourn times.
+ */
+int rte_ring_sojourn_reset(struct rte_ring *r);
+
+/**
+ * Estimate a percentile of the sojourn time from the histogram: the upper
+ * bound of the bucket holding it, capped by the longest sojourn time.
+ *
+ * @param stats
+ *   Statistics from rte_ring_sojourn_get().
+ * @param q
+ *   The percentile, in [0, 1].
+ * @return
+ *   The sojourn time in TSC cycles, 0 if no object was dequeued.
+ */
+uint64_t rte_ring_sojourn_percentile(const struct rte_ring_sojourn *stats,
+    double q);
+
+/**
+ * Write the sojourn statistics of a ring, in microseconds.
+ *
+ * @param f
+ *   A pointer to a file for output.
+ * @param r
+ *   A ring created with RING_F_SOJOURN.
+ */
+void rte_ring_sojourn_dump(FILE *f, const struct rte_ring *r);
+
 /* the actual enqueue of pointers on the ring.
  * Placed here since identical code needed in both
  * single and multi producer enqueue functions */
@@ -246,8 +596,89 @@ void rte_ring_free(struct rte_ring *r);
   } \
 } while (0)
 
+/* prefetch *span* bytes of an object, one cache line at a time */
+static __rte_always_inline void
+__rte_ring_prefetch_obj(const void *obj, unsigned int span)
+{
+  unsigned int off;
+
+  for (off = 0; off < span; off += RTE_CACHE_LINE_SIZE)
+    rte_prefetch0((const char *)obj + off);
+}
+
+/* DEQUEUE_PTRS with a prefetch of the first pf->count objects issued as
+ * each pointer leaves the ring */
+static __rte_always_inline void
+__rte_ring_dequeue_ptrs_prefetch(struct rte_ring *r, uint32_t cons_head,
+    void **obj_table, unsigned int n, const struct rte_ring_prefetch *pf)
+{
+  void **ring = (void **)&r[1];
+  const uint32_t size = r->size;
+  uint32_t idx = cons_head & r->mask;
+  const unsigned int npf = (pf->count < n) ? pf->count : n;
+  unsigned int i;
+
+  for (i = 0; i < n; i++, idx++) {
+    if (unlikely(idx == size))
+      idx = 0;
+    obj_table[i] = ring[idx];
+    if (i < npf)
+      __rte_ring_prefetch_obj(obj_table[i], pf->span);
+  }
+}
+
+#include "rte_ring_profile.h"
+#include "rte_ring_record.h"
 #include "rte_ring_generic.h"
 
+/* @internal shadow timestamps of a RING_F_SOJOURN ring, after the slots */
+static __rte_always_inline uint64_t *
+  __rte_ring_sojourn_tsc(const struct rte_ring *r)
+{
+  return (uint64_t *)((void **)&r[1] + r->size);
+}
+
+/* @internal sojourn statistics of a RING_F_SOJOURN ring */
+static __rte_always_inline struct rte_ring_sojourn *
+  __rte_ring_sojourn_stats(const struct rte_ring *r)
+{
+  return (struct rte_ring_sojourn *)RTE_ALIGN_CEIL(
+      (uintptr_t)(__rte_ring_sojourn_tsc(r) + r->size),
+      (uintptr_t)RTE_CACHE_LINE_SIZE);
+}
+
+/* @internal stamp n slots from head with the enqueue time, before the
+ * producer tail is published */
+static __rte_always_inline void
+  __rte_ring_sojourn_stamp(struct rte_ring *r, uint32_t head, unsigned int n)
+{
+  uint64_t *tsc;
+  uint64_t now;
+  unsigned int i;
+
+  if (likely(!(r->flags & RING_F_SOJOURN)) || n == 0)
+    return;
+
+  tsc = __rte_ring_sojourn_tsc(r);
+  now = rte_rdtsc();
+  for (i = 0; i < n; i++)
+    tsc[(head + i) & r->mask] = now;
+}
+
+/* @internal account the sojourn of n slots from head, out of line */
+void __rte_ring_sojourn_fold(struct rte_ring *r, uint32_t head,
+    unsigned int n, unsigned int is_sc);
+
+/* @internal account the sojourn of n dequeued slots from head, before the
+ * consumer tail is published and producers may stamp them again */
+static __rte_always_inline void
+  __rte_ring_sojourn_end(struct rte_ring *r, uint32_t head, unsigned int n,
+      unsigned int is_sc)
+{
+  if (unlikely(r->flags & RING_F_SOJOURN) && n != 0)
+    __rte_ring_sojourn_fold(r, head, n, is_sc);
+}
+
 /**
  * @internal Enqueue several objects on the ring
  *
@@ -275,19 +706,72 @@ __rte_ring_do_enqueue(struct rte_ring *r, void * const *obj_table,
 {
   uint32_t prod_head, prod_next;
   uint32_t free_entries;
+  unsigned int done;
 
-  n = __rte_ring_move_prod_head(r, is_sp, n, behavior,
+  done = __rte_ring_move_prod_head(r, is_sp, n, behavior,
       &prod_head, &prod_next, &free_entries);
-  if (n == 0)
+  if (done == 0)
     goto end;
 
-  ENQUEUE_PTRS(r, &r[1], prod_head, obj_table, n, void *);
+  ENQUEUE_PTRS(r, &r[1], prod_head, obj_table, done, void *);
+  __rte_ring_sojourn_stamp(r, prod_head, done);
 
   update_tail(&r->prod, prod_head, prod_next, is_sp, 1);
 end:
+  __RTE_RING_USDT4(enqueue, r, n, done, free_entries - done);
+  __RTE_RING_RECORD(r, 1, n, done);
   if (free_space != NULL)
-    *free_space = free_entries - n;
-  return n;
+    *free_space = free_entries - done;
+  return done;
+}
+
+/**
+ * @internal Dequeue several objects from a RING_F_TOMBSTONE ring
+ *
+ * Each slot is claimed with an atomic exchange against rte_ring_cancel().
+ * Tombstones are dropped, and as many more slots are reserved as were
+ * skipped, as long as the ring has some, so that they do not count toward n.
+ * With RTE_RING_QUEUE_FIXED, only the first reservation is all-or-nothing:
+ * fewer than n objects are returned when cancelled ones cannot be replaced.
+ */
+  static __rte_noinline unsigned int
+__rte_ring_do_dequeue_live(struct rte_ring *r, void **obj_table,
+    unsigned int n, enum rte_ring_queue_behavior behavior,
+    unsigned int is_sc, unsigned int *available)
+{
+  uint32_t cons_head, cons_next;
+  uint32_t entries = 0;
+  void **ring = (void **)&r[1];
+  unsigned int got = 0, want = n, cnt, i;
+  void *obj;
+
+  while (want > 0) {
+    cnt = __rte_ring_move_cons_head(r, (int)is_sc, want, behavior,
+        &cons_head, &cons_next, &entries);
+    if (cnt == 0)
+      break;
+
+    for (i = 0; i < cnt; i++) {
+      obj = __atomic_exchange_n(&ring[(cons_head + i) & r->mask],
+          RTE_RING_TOMBSTONE, __ATOMIC_ACQ_REL);
+      if (likely(obj != RTE_RING_TOMBSTONE))
+        obj_table[got++] = obj;
+    }
+    __rte_ring_sojourn_end(r, cons_head, cnt, is_sc);
+
+    update_tail(&r->cons, cons_head, cons_next, is_sc, 0);
+
+    entries -= cnt;
+    want = n - got;
+    behavior = RTE_RING_QUEUE_VARIABLE;
+  }
+
+  __RTE_RING_USDT4(dequeue, r, n, got, entries);
+  if (got != 0)
+    __RTE_RING_RECORD(r, 0, n, got);
+  if (available != NULL)
+    *available = entries;
+  return got;
 }
 
 /**
@@ -308,7 +792,9 @@ end:
  *   returns the number of remaining ring entries after the dequeue has finished
  * @return
  *   - Actual number of objects dequeued.
- *     If behavior == RTE_RING_QUEUE_FIXED, this will be 0 or n only.
+ *     If behavior == RTE_RING_QUEUE_FIXED, this will be 0 or n only, unless
+ *     the ring is a RING_F_TOMBSTONE ring, where cancelled objects can leave
+ *     it between 1 and n - 1 (see __rte_ring_do_dequeue_live()).
  */
   static __rte_always_inline unsigned int
 __rte_ring_do_dequeue(struct rte_ring *r, void **obj_table,
@@ -317,20 +803,81 @@ __rte_ring_do_dequeue(struct rte_ring *r, void **obj_table,
 {
   uint32_t cons_head, cons_next;
   uint32_t entries;
+  unsigned int done;
 
-  n = __rte_ring_move_cons_head(r, (int)is_sc, n, behavior,
+  if (unlikely(r->flags & RING_F_TOMBSTONE))
+    return __rte_ring_do_dequeue_live(r, obj_table, n, behavior, is_sc,
+        available);
+
+  done = __rte_ring_move_cons_head(r, (int)is_sc, n, behavior,
       &cons_head, &cons_next, &entries);
-  if (n == 0)
+  if (done == 0)
     goto end;
 
-  DEQUEUE_PTRS(r, &r[1], cons_head, obj_table, n, void *);
+  DEQUEUE_PTRS(r, &r[1], cons_head, obj_table, done, void *);
+  __rte_ring_sojourn_end(r, cons_head, done, is_sc);
 
   update_tail(&r->cons, cons_head, cons_next, is_sc, 0);
 
 end:
+  __RTE_RING_USDT4(dequeue, r, n, done, entries - done);
+  if (done != 0)
+    __RTE_RING_RECORD(r, 0, n, done);
   if (available != NULL)
-    *available = entries - n;
-  return n;
+    *available = entries - done;
+  return done;
+}
+
+/**
+ * @internal Dequeue several objects from the ring, prefetching them
+ *
+ * Same as __rte_ring_do_dequeue(), with the software prefetch described by
+ * *pf* applied to the dequeued objects and, optionally, to the ring slots
+ * the next burst will read.
+ */
+  static __rte_always_inline unsigned int
+__rte_ring_do_dequeue_prefetch(struct rte_ring *r, void **obj_table,
+    unsigned int n, enum rte_ring_queue_behavior behavior,
+    unsigned int is_sc, unsigned int *available,
+    const struct rte_ring_prefetch *pf)
+{
+  uint32_t cons_head, cons_next;
+  uint32_t entries;
+  unsigned int done, i;
+
+  if (unlikely(r->flags & RING_F_TOMBSTONE)) {
+    done = __rte_ring_do_dequeue_live(r, obj_table, n, behavior, is_sc,
+        available);
+    for (i = 0; i < done && i < pf->count; i++)
+      __rte_ring_prefetch_obj(obj_table[i], pf->span);
+    return done;
+  }
+
+  done = __rte_ring_move_cons_head(r, (int)is_sc, n, behavior,
+      &cons_head, &cons_next, &entries);
+  if (done == 0)
+    goto end;
+
+  __rte_ring_dequeue_ptrs_prefetch(r, cons_head, obj_table, done, pf);
+
+  if (pf->next_slots) {
+    void **ring = (void **)&r[1];
+    const unsigned int per_line = RTE_CACHE_LINE_SIZE / sizeof(void *);
+
+    for (i = 0; i < done; i += per_line)
+      rte_prefetch0(&ring[(cons_next + i) & r->mask]);
+  }
+  __rte_ring_sojourn_end(r, cons_head, done, is_sc);
+
+  update_tail(&r->cons, cons_head, cons_next, is_sc, 0);
+
+end:
+  __RTE_RING_USDT4(dequeue, r, n, done, entries - done);
+  if (done != 0)
+    __RTE_RING_RECORD(r, 0, n, done);
+  if (available != NULL)
+    *available = entries - done;
+  return done;
 }
 
 /**
@@ -483,7 +1030,8 @@ rte_ring_enqueue(struct rte_ring *r, void *obj)
  *   If non-NULL, returns the number of remaining ring entries after the
  *   dequeue has finished.
  * @return
- *   The number of objects dequeued, either 0 or n
+ *   The number of objects dequeued, either 0 or n, or between 1 and n - 1
+ *   on a RING_F_TOMBSTONE ring when some of the n objects were cancelled
  */
   static __rte_always_inline unsigned int
 rte_ring_mc_dequeue_bulk(struct rte_ring *r, void **obj_table,
@@ -507,7 +1055,8 @@ rte_ring_mc_dequeue_bulk(struct rte_ring *r, void **obj_table,
  *   If non-NULL, returns the number of remaining ring entries after the
  *   dequeue has finished.
  * @return
- *   The number of objects dequeued, either 0 or n
+ *   The number of objects dequeued, either 0 or n, or between 1 and n - 1
+ *   on a RING_F_TOMBSTONE ring when some of the n objects were cancelled
  */
   static __rte_always_inline unsigned int
 rte_ring_sc_dequeue_bulk(struct rte_ring *r, void **obj_table,
@@ -534,7 +1083,8 @@ rte_ring_sc_dequeue_bulk(struct rte_ring *r, void **obj_table,
  *   If non-NULL, returns the number of remaining ring entries after the
  *   dequeue has finished.
  * @return
- *   The number of objects dequeued, either 0 or n
+ *   The number of objects dequeued, either 0 or n, or between 1 and n - 1
+ *   on a RING_F_TOMBSTONE ring when some of the n objects were cancelled
  */
   static __rte_always_inline unsigned int
 rte_ring_dequeue_bulk(struct rte_ring *r, void **obj_table, unsigned int n,
@@ -853,4 +1403,1104 @@ rte_ring_dequeue_burst(struct rte_ring *r, void **obj_table,
       r->cons.single, available);
 }
 
+/**
+ * Dequeue objects from a ring (multi-consumers safe) and prefetch them.
+ *
+ * Same as rte_ring_mc_dequeue_burst(), but a prefetch of the first
+ * *pf->span* bytes of each of the first *pf->count* objects is issued as the
+ * pointers are copied out of the ring, so that the cache misses the consumer
+ * takes when dereferencing them overlap with its work. If *pf->next_slots* is
+ * set, the ring slots the next burst of the same size will read are
+ * prefetched as well.
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects) that will be filled.
+ * @param n
+ *   The number of objects to dequeue from the ring to the obj_table.
+ * @param available
+ *   If non-NULL, returns the number of remaining ring entries after the
+ *   dequeue has finished.
+ * @param pf
+ *   The prefetch to apply.
+ * @return
+ *   - n: Actual number of objects dequeued, 0 if ring is empty
+ */
+  static __rte_always_inline unsigned
+rte_ring_mc_dequeue_burst_prefetch(struct rte_ring *r, void **obj_table,
+    unsigned int n, unsigned int *available,
+    const struct rte_ring_prefetch *pf)
+{
+  return __rte_ring_do_dequeue_prefetch(r, obj_table, n,
+      RTE_RING_QUEUE_VARIABLE, __IS_MC, available, pf);
+}
+
+/**
+ * Dequeue objects from a ring (NOT multi-consumers safe) and prefetch them.
+ *
+ * See rte_ring_mc_dequeue_burst_prefetch().
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects) that will be filled.
+ * @param n
+ *   The number of objects to dequeue from the ring to the obj_table.
+ * @param available
+ *   If non-NULL, returns the number of remaining ring entries after the
+ *   dequeue has finished.
+ * @param pf
+ *   The prefetch to apply.
+ * @return
+ *   - n: Actual number of objects dequeued, 0 if ring is empty
+ */
+  static __rte_always_inline unsigned
+rte_ring_sc_dequeue_burst_prefetch(struct rte_ring *r, void **obj_table,
+    unsigned int n, unsigned int *available,
+    const struct rte_ring_prefetch *pf)
+{
+  return __rte_ring_do_dequeue_prefetch(r, obj_table, n,
+      RTE_RING_QUEUE_VARIABLE, __IS_SC, available, pf);
+}
+
+/**
+ * Dequeue objects from a ring up to a maximum number and prefetch them.
+ *
+ * This function calls the multi-consumers or the single-consumer
+ * version, depending on the default behaviour that was specified at
+ * ring creation time (see flags). See rte_ring_mc_dequeue_burst_prefetch().
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects) that will be filled.
+ * @param n
+ *   The number of objects to dequeue from the ring to the obj_table.
+ * @param available
+ *   If non-NULL, returns the number of remaining ring entries after the
+ *   dequeue has finished.
+ * @param pf
+ *   The prefetch to apply.
+ * @return
+ *   - Number of objects dequeued
+ */
+  static __rte_always_inline unsigned
+rte_ring_dequeue_burst_prefetch(struct rte_ring *r, void **obj_table,
+    unsigned int n, unsigned int *available,
+    const struct rte_ring_prefetch *pf)
+{
+  return __rte_ring_do_dequeue_prefetch(r, obj_table, n,
+      RTE_RING_QUEUE_VARIABLE, r->cons.single, available, pf);
+}
+
+/* copy n slots from one ring to another, wrapping independently on both */
+static __rte_always_inline void
+__rte_ring_copy_slots(struct rte_ring *dst, uint32_t prod_head,
+    const struct rte_ring *src, uint32_t cons_head, unsigned int n)
+{
+  void **dst_ring = (void **)&dst[1];
+  void * const *src_ring = (void * const *)&src[1];
+  uint32_t didx = prod_head & dst->mask;
+  uint32_t sidx = cons_head & src->mask;
+  unsigned int chunk;
+
+  while (n > 0) {
+    chunk = n;
+    if (chunk > src->size - sidx)
+      chunk = src->size - sidx;
+    if (chunk > dst->size - didx)
+      chunk = dst->size - didx;
+    memcpy(&dst_ring[didx], &src_ring[sidx], chunk * sizeof(void *));
+    n -= chunk;
+    sidx = (sidx + chunk) & src->mask;
+    didx = (didx + chunk) & dst->mask;
+  }
+}
+
+#define RTE_RING_TRANSFER_BUF 64 /**< Objects per rte_ring_transfer() copy. */
+
+/**
+ * @internal Move objects from one ring to another through a stack buffer
+ *
+ * Used when *dst* is single-producer and *src* is multi-consumer, is *dst*
+ * itself or is a RING_F_TOMBSTONE ring, whose slots are claimed one by one
+ * against rte_ring_cancel() rather than copied. The caller is the only
+ * producer of *dst*, so its room can only grow during the call: the objects
+ * are dequeued from *src* in chunks of RTE_RING_TRANSFER_BUF, no more than
+ * *dst* has room for, and the enqueue of each chunk cannot come short.
+ * With RTE_RING_QUEUE_FIXED, the objects are dequeued in a single bulk, so
+ * no more than RTE_RING_TRANSFER_BUF of them can be moved.
+ */
+  static __rte_noinline unsigned int
+__rte_ring_do_transfer_buffered(struct rte_ring *src, struct rte_ring *dst,
+    unsigned int n, enum rte_ring_queue_behavior behavior)
+{
+  void *buf[RTE_RING_TRANSFER_BUF];
+  unsigned int moved = 0, want, got;
+
+  if (behavior == RTE_RING_QUEUE_FIXED) {
+    if (n > RTE_RING_TRANSFER_BUF || n > rte_ring_free_count(dst))
+      return 0;
+    got = rte_ring_dequeue_bulk(src, buf, n, NULL);
+    if (got != 0)
+      rte_ring_sp_enqueue_bulk(dst, buf, got, NULL);
+    return got;
+  }
+
+  while (moved < n) {
+    want = n - moved;
+    if (want > RTE_RING_TRANSFER_BUF)
+      want = RTE_RING_TRANSFER_BUF;
+    if (want > rte_ring_free_count(dst))
+      want = rte_ring_free_count(dst);
+    if (want == 0)
+      break;
+    got = rte_ring_dequeue_burst(src, buf, want, NULL);
+    if (got == 0)
+      break;
+    rte_ring_sp_enqueue_bulk(dst, buf, got, NULL);
+    moved += got;
+    if (got < want)
+      break;
+  }
+  return moved;
+}
+
+/**
+ * @internal Move objects from one ring to another
+ *
+ * Reserving on both rings cannot be undone on a multi-threaded side, so the
+ * slots are copied directly only when one side is single-threaded: its space
+ * (free room of a single-producer destination, entries of a single-consumer
+ * source) can only grow while the other side is reserved, and reserving it
+ * afterwards cannot come short. A single-producer destination also takes
+ * the objects of a multi-consumer source, of itself or of a RING_F_TOMBSTONE
+ * source through a buffer (see __rte_ring_do_transfer_buffered()). The other
+ * cases would dequeue objects that the destination may have no room left for
+ * and that cannot go back to the source, so they are refused.
+ *
+ * A move is recorded and traced as a dequeue of *src* followed by an enqueue
+ * of all the moved objects on *dst*; a transfer that moves nothing is not.
+ *
+ * @param src
+ *   The ring to dequeue from.
+ * @param dst
+ *   The ring to enqueue to.
+ * @param n
+ *   The number of objects to move.
+ * @param behavior
+ *   RTE_RING_QUEUE_FIXED:    Move a fixed number of items
+ *   RTE_RING_QUEUE_VARIABLE: Move as many items as possible
+ * @param is_sc
+ *   Indicates whether the source uses single or multi-consumer head update
+ * @param is_sp
+ *   Indicates whether the destination uses single or multi-producer head
+ *   update
+ * @return
+ *   Actual number of objects moved, 0 if the transfer is refused.
+ *   If behavior == RTE_RING_QUEUE_FIXED, this will be 0 or n only, unless
+ *   *src* is a RING_F_TOMBSTONE ring (see __rte_ring_do_dequeue_live()).
+ */
+  static __rte_always_inline unsigned int
+__rte_ring_do_transfer(struct rte_ring *src, struct rte_ring *dst,
+    unsigned int n, enum rte_ring_queue_behavior behavior,
+    unsigned int is_sc, unsigned int is_sp)
+{
+  uint32_t cons_head = 0, cons_next = 0, entries;
+  uint32_t prod_head = 0, prod_next = 0, free_entries;
+  uint32_t room;
+
+  if (unlikely(src == dst || (!is_sp && !is_sc) ||
+        (src->flags & RING_F_TOMBSTONE))) {
+    if (!is_sp)
+      return 0;
+    return __rte_ring_do_transfer_buffered(src, dst, n, behavior);
+  }
+
+  if (is_sp) {
+    room = dst->capacity + dst->cons.tail - dst->prod.head;
+    if (n > room)
+      n = (behavior == RTE_RING_QUEUE_FIXED) ? 0 : room;
+    if (n == 0)
+      return 0;
+    n = __rte_ring_move_cons_head(src, (int)is_sc, n, behavior,
+        &cons_head, &cons_next, &entries);
+    if (n == 0)
+      return 0;
+    __rte_ring_move_prod_head(dst, __IS_SP, n, RTE_RING_QUEUE_FIXED,
+        &prod_head, &prod_next, &free_entries);
+  } else {
+    room = src->prod.tail - src->cons.head;
+    if (n > room)
+      n = (behavior == RTE_RING_QUEUE_FIXED) ? 0 : room;
+    if (n == 0)
+      return 0;
+    n = __rte_ring_move_prod_head(dst, __IS_MP, n, behavior,
+        &prod_head, &prod_next, &free_entries);
+    if (n == 0)
+      return 0;
+    __rte_ring_move_cons_head(src, __IS_SC, n, RTE_RING_QUEUE_FIXED,
+        &cons_head, &cons_next, &entries);
+  }
+
+  __rte_ring_copy_slots(dst, prod_head, src, cons_head, n);
+  __rte_ring_sojourn_end(src, cons_head, n, is_sc);
+  __rte_ring_sojourn_stamp(dst, prod_head, n);
+
+  update_tail(&dst->prod, prod_head, prod_next, is_sp, 1);
+  update_tail(&src->cons, cons_head, cons_next, is_sc, 0);
+
+  __RTE_RING_USDT4(dequeue, src, n, n, entries - n);
+  __RTE_RING_RECORD(src, 0, n, n);
+  __RTE_RING_USDT4(enqueue, dst, n, n, free_entries - n);
+  __RTE_RING_RECORD(dst, 1, n, n);
+  return n;
+}
+
+/**
+ * Move objects from one ring to another.
+ *
+ * The objects are dequeued and enqueued with the default behaviour of each
+ * ring (see flags). When *src* is single-consumer or *dst* is
+ * single-producer, the object pointers are copied straight from the storage
+ * of *src* to the storage of *dst*, without going through an intermediate
+ * object table. A single-producer *dst* goes through a stack buffer instead
+ * when *src* is multi-consumer, is *dst* itself or is a RING_F_TOMBSTONE
+ * ring.
+ *
+ * The call never waits for other threads. When *dst* is multi-producer and
+ * *src* is multi-consumer, is *dst* itself or is a RING_F_TOMBSTONE ring,
+ * the objects could not be reserved on both rings at once: the transfer is
+ * refused and returns 0. Use a dequeue followed by an enqueue, which leaves
+ * the objects that do not fit in *dst* to the caller.
+ *
+ * @param src
+ *   The ring to dequeue from.
+ * @param dst
+ *   The ring to enqueue to.
+ * @param n
+ *   The number of objects to move.
+ * @param behavior
+ *   RTE_RING_QUEUE_FIXED:    Move exactly n objects or none, like the bulk
+ *                            functions. Through a buffer, n must not exceed
+ *                            RTE_RING_TRANSFER_BUF. A RING_F_TOMBSTONE
+ *                            *src* can move fewer objects, as its bulk
+ *                            dequeue does.
+ *   RTE_RING_QUEUE_VARIABLE: Move as many objects as both the entries of
+ *                            *src* and the room in *dst* allow, up to n,
+ *                            like the burst functions.
+ * @return
+ *   The number of objects moved, 0 if the transfer is refused.
+ */
+  static __rte_always_inline unsigned int
+rte_ring_transfer(struct rte_ring *src, struct rte_ring *dst, unsigned int n,
+    enum rte_ring_queue_behavior behavior)
+{
+  return __rte_ring_do_transfer(src, dst, n, behavior, src->cons.single,
+      dst->prod.single);
+}
+
+#define __RTE_RING_APPLY_BUF 64 /**< Tombstone ring objects per visit. */
+
+/**
+ * @internal Dequeue objects from a RING_F_TOMBSTONE ring by visiting them
+ *
+ * Visiting the slots in place would let rte_ring_cancel() replace an object
+ * *fn* is looking at, so each slot is claimed with an atomic exchange, as in
+ * __rte_ring_do_dequeue_live(), and *fn* visits the live objects from a
+ * buffer of __RTE_RING_APPLY_BUF entries. Tombstones are skipped and
+ * replaced by more slots while the ring has some.
+ */
+template <typename F>
+  static __rte_noinline unsigned int
+__rte_ring_do_dequeue_apply_live(struct rte_ring *r, unsigned int n,
+    enum rte_ring_queue_behavior behavior, unsigned int is_sc, F &fn,
+    unsigned int *available)
+{
+  uint32_t cons_head, cons_next;
+  uint32_t entries = 0;
+  void **ring = (void **)&r[1];
+  void *buf[__RTE_RING_APPLY_BUF];
+  unsigned int got = 0, want = n, cnt, nb, i;
+  void *obj;
+
+  while (want > 0) {
+    cnt = __rte_ring_move_cons_head(r, (int)is_sc, want, behavior,
+        &cons_head, &cons_next, &entries);
+    if (cnt == 0)
+      break;
+
+    nb = 0;
+    for (i = 0; i < cnt; i++) {
+      obj = __atomic_exchange_n(&ring[(cons_head + i) & r->mask],
+          RTE_RING_TOMBSTONE, __ATOMIC_ACQ_REL);
+      if (unlikely(obj == RTE_RING_TOMBSTONE))
+        continue;
+      buf[nb++] = obj;
+      if (nb == __RTE_RING_APPLY_BUF) {
+        fn(buf, nb);
+        got += nb;
+        nb = 0;
+      }
+    }
+    if (nb != 0) {
+      fn(buf, nb);
+      got += nb;
+    }
+    __rte_ring_sojourn_end(r, cons_head, cnt, is_sc);
+
+    update_tail(&r->cons, cons_head, cons_next, is_sc, 0);
+
+    entries -= cnt;
+    want = n - got;
+    behavior = RTE_RING_QUEUE_VARIABLE;
+  }
+
+  __RTE_RING_USDT4(dequeue, r, n, got, entries);
+  if (got != 0)
+    __RTE_RING_RECORD(r, 0, n, got);
+  if (available != NULL)
+    *available = entries;
+  return got;
+}
+
+/**
+ * @internal Dequeue objects by visiting them in place
+ *
+ * The consumer reservation is held while *fn* runs on the (up to two)
+ * contiguous regions of reserved slots, then the slots are released.
+ * RING_F_TOMBSTONE rings are visited from a buffer instead.
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param n
+ *   The number of objects to dequeue.
+ * @param behavior
+ *   RTE_RING_QUEUE_FIXED:    Dequeue a fixed number of items from a ring
+ *   RTE_RING_QUEUE_VARIABLE: Dequeue as many items as possible from ring
+ * @param is_sc
+ *   Indicates whether to use single consumer or multi-consumer head update
+ * @param fn
+ *   Callable invoked as fn(void **objs, unsigned int n) on each region.
+ * @param available
+ *   returns the number of remaining ring entries after the dequeue has finished
+ * @return
+ *   - Actual number of objects dequeued.
+ *     If behavior == RTE_RING_QUEUE_FIXED, this will be 0 or n only, unless
+ *     the ring is a RING_F_TOMBSTONE ring (see
+ *     __rte_ring_do_dequeue_apply_live()).
+ */
+template <typename F>
+  static __rte_always_inline unsigned int
+__rte_ring_do_dequeue_apply(struct rte_ring *r, unsigned int n,
+    enum rte_ring_queue_behavior behavior, unsigned int is_sc, F &fn,
+    unsigned int *available)
+{
+  uint32_t cons_head, cons_next;
+  uint32_t entries;
+  uint32_t idx;
+  void **ring = (void **)&r[1];
+  unsigned int done;
+
+  if (unlikely(r->flags & RING_F_TOMBSTONE))
+    return __rte_ring_do_dequeue_apply_live(r, n, behavior, is_sc, fn,
+        available);
+
+  done = __rte_ring_move_cons_head(r, (int)is_sc, n, behavior,
+      &cons_head, &cons_next, &entries);
+  if (done == 0)
+    goto end;
+
+  idx = cons_head & r->mask;
+  if (likely(idx + done <= r->size))
+    fn(&ring[idx], done);
+  else {
+    fn(&ring[idx], r->size - idx);
+    fn(&ring[0], done - (r->size - idx));
+  }
+  __rte_ring_sojourn_end(r, cons_head, done, is_sc);
+
+  update_tail(&r->cons, cons_head, cons_next, is_sc, 0);
+
+end:
+  __RTE_RING_USDT4(dequeue, r, n, done, entries - done);
+  if (done != 0)
+    __RTE_RING_RECORD(r, 0, n, done);
+  if (available != NULL)
+    *available = entries - done;
+  return done;
+}
+
+/* @internal visitors are taken by forwarding reference when the compiler
+ * has them, so that stateful callables bind whether they are named or
+ * temporaries, and by reference otherwise */
+#if __cplusplus >= 201103L
+#define __RTE_RING_FN_REF &&
+#else
+#define __RTE_RING_FN_REF &
+#endif
+
+/* @internal adapts a C visitor to the callable expected above */
+struct __rte_ring_apply_cb {
+  rte_ring_apply_fn_t fn;
+  void *ctx;
+
+  void operator()(void **objs, unsigned int n) const { fn(objs, n, ctx); }
+};
+
+/**
+ * Dequeue objects from a ring (multi-consumers safe) by visiting them in
+ * place.
+ *
+ * Instead of copying the object pointers to a table, *fn* is called on the
+ * dequeued slots directly in the ring storage, once per contiguous region
+ * (twice when the dequeued slots wrap around the end of the ring). The slots
+ * are only released to producers after *fn* returns, so it must not keep
+ * pointers to them. On a RING_F_TOMBSTONE ring, *fn* visits the live objects
+ * from a buffer instead.
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param n
+ *   The number of objects to dequeue from the ring.
+ * @param fn
+ *   The visitor.
+ * @param ctx
+ *   Opaque argument passed to *fn*.
+ * @param available
+ *   If non-NULL, returns the number of remaining ring entries after the
+ *   dequeue has finished.
+ * @return
+ *   - n: Actual number of objects dequeued, 0 if ring is empty
+ */
+  static __rte_always_inline unsigned
+rte_ring_mc_dequeue_burst_apply(struct rte_ring *r, unsigned int n,
+    rte_ring_apply_fn_t fn, void *ctx, unsigned int *available)
+{
+  struct __rte_ring_apply_cb cb = { fn, ctx };
+
+  return __rte_ring_do_dequeue_apply(r, n, RTE_RING_QUEUE_VARIABLE, __IS_MC,
+      cb, available);
+}
+
+/**
+ * Dequeue objects from a ring (NOT multi-consumers safe) by visiting them in
+ * place.
+ *
+ * See rte_ring_mc_dequeue_burst_apply().
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param n
+ *   The number of objects to dequeue from the ring.
+ * @param fn
+ *   The visitor.
+ * @param ctx
+ *   Opaque argument passed to *fn*.
+ * @param available
+ *   If non-NULL, returns the number of remaining ring entries after the
+ *   dequeue has finished.
+ * @return
+ *   - n: Actual number of objects dequeued, 0 if ring is empty
+ */
+  static __rte_always_inline unsigned
+rte_ring_sc_dequeue_burst_apply(struct rte_ring *r, unsigned int n,
+    rte_ring_apply_fn_t fn, void *ctx, unsigned int *available)
+{
+  struct __rte_ring_apply_cb cb = { fn, ctx };
+
+  return __rte_ring_do_dequeue_apply(r, n, RTE_RING_QUEUE_VARIABLE, __IS_SC,
+      cb, available);
+}
+
+/**
+ * Dequeue objects from a ring up to a maximum number by visiting them in
+ * place.
+ *
+ * This function calls the multi-consumers or the single-consumer
+ * version, depending on the default behaviour that was specified at
+ * ring creation time (see flags). See rte_ring_mc_dequeue_burst_apply().
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param n
+ *   The number of objects to dequeue from the ring.
+ * @param fn
+ *   The visitor.
+ * @param ctx
+ *   Opaque argument passed to *fn*.
+ * @param available
+ *   If non-NULL, returns the number of remaining ring entries after the
+ *   dequeue has finished.
+ * @return
+ *   - Number of objects dequeued
+ */
+  static __rte_always_inline unsigned
+rte_ring_dequeue_burst_apply(struct rte_ring *r, unsigned int n,
+    rte_ring_apply_fn_t fn, void *ctx, unsigned int *available)
+{
+  struct __rte_ring_apply_cb cb = { fn, ctx };
+
+  return __rte_ring_do_dequeue_apply(r, n, RTE_RING_QUEUE_VARIABLE,
+      r->cons.single, cb, available);
+}
+
+/**
+ * Dequeue objects from a ring (multi-consumers safe) by visiting them in
+ * place with an inlinable callable.
+ *
+ * Same as rte_ring_mc_dequeue_burst_apply(), for any callable (function
+ * object, lambda) invocable as fn(void **objs, unsigned int n), so that the
+ * compiler can inline the visitor into the dequeue. The callable may keep
+ * state across calls: it is not taken as const (a mutable lambda works).
+ */
+template <typename F>
+  static __rte_always_inline unsigned
+rte_ring_mc_dequeue_burst_apply(struct rte_ring *r, unsigned int n,
+    F __RTE_RING_FN_REF fn, unsigned int *available)
+{
+  return __rte_ring_do_dequeue_apply(r, n, RTE_RING_QUEUE_VARIABLE, __IS_MC,
+      fn, available);
+}
+
+/**
+ * Dequeue objects from a ring (NOT multi-consumers safe) by visiting them in
+ * place with an inlinable callable.
+ *
+ * See the callable version of rte_ring_mc_dequeue_burst_apply().
+ */
+template <typename F>
+  static __rte_always_inline unsigned
+rte_ring_sc_dequeue_burst_apply(struct rte_ring *r, unsigned int n,
+    F __RTE_RING_FN_REF fn, unsigned int *available)
+{
+  return __rte_ring_do_dequeue_apply(r, n, RTE_RING_QUEUE_VARIABLE, __IS_SC,
+      fn, available);
+}
+
+/**
+ * Dequeue objects from a ring up to a maximum number by visiting them in
+ * place with an inlinable callable.
+ *
+ * Uses the default consumer behaviour of the ring. See the callable version
+ * of rte_ring_mc_dequeue_burst_apply().
+ */
+template <typename F>
+  static __rte_always_inline unsigned
+rte_ring_dequeue_burst_apply(struct rte_ring *r, unsigned int n,
+    F __RTE_RING_FN_REF fn, unsigned int *available)
+{
+  return __rte_ring_do_dequeue_apply(r, n, RTE_RING_QUEUE_VARIABLE,
+      r->cons.single, fn, available);
+}
+
+/**
+ * @internal Enqueue objects gathered from several tables on the ring
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param iov
+ *   The segments, enqueued in order.
+ * @param iovcnt
+ *   The number of segments.
+ * @param behavior
+ *   RTE_RING_QUEUE_FIXED:    Enqueue all the objects of all the segments
+ *   RTE_RING_QUEUE_VARIABLE: Enqueue as many items as possible from ring
+ * @param is_sp
+ *   Indicates whether to use single producer or multi-producer head update
+ * @param free_space
+ *   returns the amount of space after the enqueue operation has finished
+ * @return
+ *   Actual number of objects enqueued.
+ *   If behavior == RTE_RING_QUEUE_FIXED, this will be 0 or the total.
+ */
+  static __rte_always_inline unsigned int
+__rte_ring_do_enqueue_sg(struct rte_ring *r, const struct rte_ring_iovec *iov,
+    unsigned int iovcnt, enum rte_ring_queue_behavior behavior,
+    unsigned int is_sp, unsigned int *free_space)
+{
+  uint32_t prod_head, prod_next, head;
+  uint32_t free_entries;
+  unsigned int want, n, seg, cnt, done;
+
+  for (want = 0, seg = 0; seg < iovcnt; seg++)
+    want += iov[seg].n;
+
+  n = __rte_ring_move_prod_head(r, is_sp, want, behavior,
+      &prod_head, &prod_next, &free_entries);
+  if (n == 0)
+    goto end;
+
+  for (done = 0, seg = 0; done < n; seg++) {
+    cnt = iov[seg].n;
+    if (cnt > n - done)
+      cnt = n - done;
+    head = prod_head + done;
+    ENQUEUE_PTRS(r, &r[1], head, iov[seg].objs, cnt, void *);
+    done += cnt;
+  }
+  __rte_ring_sojourn_stamp(r, prod_head, n);
+
+  update_tail(&r->prod, prod_head, prod_next, is_sp, 1);
+end:
+  __RTE_RING_USDT4(enqueue, r, want, n, free_entries - n);
+  __RTE_RING_RECORD(r, 1, want, n);
+  if (free_space != NULL)
+    *free_space = free_entries - n;
+  return n;
+}
+
+/**
+ * Enqueue objects gathered from several tables on a ring.
+ *
+ * The total number of objects is reserved at once, and each segment is
+ * copied into place in order, so the objects of all the segments end up
+ * contiguous in the ring and become visible to consumers together. This
+ * function calls the multi-producer or the single-producer version depending
+ * on the default behavior that was specified at ring creation time (see
+ * flags).
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param iov
+ *   The segments.
+ * @param iovcnt
+ *   The number of segments.
+ * @param behavior
+ *   RTE_RING_QUEUE_FIXED:    Enqueue all the objects or none, like the bulk
+ *                            functions.
+ *   RTE_RING_QUEUE_VARIABLE: Enqueue as many objects as possible, like the
+ *                            burst functions. The objects enqueued are a
+ *                            prefix of the concatenation of the segments.
+ * @param free_space
+ *   if non-NULL, returns the amount of space in the ring after the
+ *   enqueue operation has finished.
+ * @return
+ *   The number of objects enqueued.
+ */
+  static __rte_always_inline unsigned int
+rte_ring_enqueue_sg(struct rte_ring *r, const struct rte_ring_iovec *iov,
+    unsigned int iovcnt, enum rte_ring_queue_behavior behavior,
+    unsigned int *free_space)
+{
+  return __rte_ring_do_enqueue_sg(r, iov, iovcnt, behavior, r->prod.single,
+      free_space);
+}
+
+/**
+ * @internal Reserve slots for a zero-copy enqueue
+ *
+ * Only single-producer rings support it: giving back part of a reservation
+ * moves the producer head backwards, which is only possible when no other
+ * producer may have reserved slots after it.
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param n
+ *   The number of slots to reserve.
+ * @param behavior
+ *   RTE_RING_QUEUE_FIXED:    Reserve a fixed number of slots
+ *   RTE_RING_QUEUE_VARIABLE: Reserve as many slots as possible
+ * @param zcd
+ *   Returns the reserved regions.
+ * @param free_space
+ *   returns the amount of space after the reservation
+ * @return
+ *   Actual number of slots reserved, 0 on a multi-producer ring.
+ *   If behavior == RTE_RING_QUEUE_FIXED, this will be 0 or n only.
+ */
+  static __rte_always_inline unsigned int
+__rte_ring_do_enqueue_zc_start(struct rte_ring *r, unsigned int n,
+    enum rte_ring_queue_behavior behavior, struct rte_ring_zc_data *zcd,
+    unsigned int *free_space)
+{
+  uint32_t prod_head, prod_next;
+  uint32_t free_entries = 0;
+  uint32_t idx;
+  void **ring = (void **)&r[1];
+  unsigned int done = 0;
+
+  zcd->ptr1 = zcd->ptr2 = NULL;
+  zcd->n1 = 0;
+
+  if (unlikely(r->prod.single != __IS_SP))
+    goto end;
+
+  done = __rte_ring_move_prod_head(r, __IS_SP, n, behavior,
+      &prod_head, &prod_next, &free_entries);
+  if (done == 0) {
+    /* nothing to commit: record the failed enqueue here */
+    __RTE_RING_USDT4(enqueue, r, n, 0, free_entries);
+    __RTE_RING_RECORD(r, 1, n, 0);
+    goto end;
+  }
+
+  idx = prod_head & r->mask;
+  zcd->ptr1 = &ring[idx];
+  if (likely(idx + done <= r->size))
+    zcd->n1 = done;
+  else {
+    zcd->n1 = r->size - idx;
+    zcd->ptr2 = &ring[0];
+  }
+end:
+  if (free_space != NULL)
+    *free_space = free_entries - done;
+  return done;
+}
+
+/**
+ * Start a zero-copy enqueue of a fixed number of objects.
+ *
+ * Reserve *n* slots, or none, that the caller fills in place through *zcd*
+ * before committing them with rte_ring_enqueue_zc_finish(). The reservation
+ * is cancelable: the finish call may commit fewer slots than reserved,
+ * including none, without leaving holes in the ring.
+ *
+ * Only rings created with RING_F_SP_ENQ support it, and the producer must not
+ * enqueue anything else between the start and the finish calls.
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param n
+ *   The number of slots to reserve.
+ * @param zcd
+ *   Returns the reserved regions: *n1* slots at *ptr1*, then the remaining
+ *   ones at *ptr2* if the reservation wraps.
+ * @param free_space
+ *   if non-NULL, returns the amount of space in the ring after the
+ *   reservation.
+ * @return
+ *   The number of slots reserved, either 0 or n. Always 0 on a
+ *   multi-producer ring.
+ */
+  static __rte_always_inline unsigned int
+rte_ring_enqueue_zc_bulk_start(struct rte_ring *r, unsigned int n,
+    struct rte_ring_zc_data *zcd, unsigned int *free_space)
+{
+  return __rte_ring_do_enqueue_zc_start(r, n, RTE_RING_QUEUE_FIXED, zcd,
+      free_space);
+}
+
+/**
+ * Start a zero-copy enqueue of up to a maximum number of objects.
+ *
+ * Same as rte_ring_enqueue_zc_bulk_start(), but reserves as many slots as
+ * possible, up to *n*.
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param n
+ *   The number of slots to reserve.
+ * @param zcd
+ *   Returns the reserved regions.
+ * @param free_space
+ *   if non-NULL, returns the amount of space in the ring after the
+ *   reservation.
+ * @return
+ *   The number of slots reserved. Always 0 on a multi-producer ring.
+ */
+  static __rte_always_inline unsigned int
+rte_ring_enqueue_zc_burst_start(struct rte_ring *r, unsigned int n,
+    struct rte_ring_zc_data *zcd, unsigned int *free_space)
+{
+  return __rte_ring_do_enqueue_zc_start(r, n, RTE_RING_QUEUE_VARIABLE, zcd,
+      free_space);
+}
+
+/**
+ * Complete a zero-copy enqueue.
+ *
+ * Commit the first *n* slots of the reservation made by the previous
+ * rte_ring_enqueue_zc_bulk_start() or rte_ring_enqueue_zc_burst_start()
+ * call, making their objects visible to consumers, and give the other
+ * reserved slots back to the ring.
+ *
+ * The commit is what a recording or the enqueue probe sees, as an enqueue of
+ * *n* objects; a start call that reserves nothing is seen as a failed one.
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param n
+ *   The number of slots to commit, from 0 (cancel the whole reservation) to
+ *   the number of slots reserved.
+ */
+  static __rte_always_inline void
+rte_ring_enqueue_zc_finish(struct rte_ring *r, unsigned int n)
+{
+  const uint32_t prod_tail = r->prod.tail;
+
+  r->prod.head = prod_tail + n;
+  __rte_ring_sojourn_stamp(r, prod_tail, n);
+  update_tail(&r->prod, prod_tail, prod_tail + n, __IS_SP, 1);
+
+  __RTE_RING_USDT4(enqueue, r, n, n,
+      r->capacity + r->cons.tail - (prod_tail + n));
+  if (n != 0)
+    __RTE_RING_RECORD(r, 1, n, n);
+}
+
+/**
+ * Enqueue objects on a ring and return a handle for each of them.
+ *
+ * Same as rte_ring_enqueue_burst(), and handles[i] receives the handle of
+ * obj_table[i], to be given to rte_ring_cancel().
+ *
+ * @param r
+ *   A pointer to the ring structure, created with RING_F_TOMBSTONE.
+ * @param obj_table
+ *   A pointer to a table of void * pointers (objects).
+ * @param n
+ *   The number of objects to add in the ring from the obj_table.
+ * @param handles
+ *   A table of at least n handles, filled for the objects enqueued.
+ * @param free_space
+ *   if non-NULL, returns the amount of space in the ring after the
+ *   enqueue operation has finished.
+ * @return
+ *   - n: Actual number of objects enqueued.
+ */
+  static __rte_always_inline unsigned int
+rte_ring_enqueue_burst_handle(struct rte_ring *r, void * const *obj_table,
+    unsigned int n, rte_ring_handle_t *handles, unsigned int *free_space)
+{
+  uint32_t prod_head, prod_next;
+  uint32_t free_entries;
+  const unsigned int is_sp = r->prod.single;
+  unsigned int done, i;
+
+  done = __rte_ring_move_prod_head(r, is_sp, n, RTE_RING_QUEUE_VARIABLE,
+      &prod_head, &prod_next, &free_entries);
+  if (done == 0)
+    goto end;
+
+  ENQUEUE_PTRS(r, &r[1], prod_head, obj_table, done, void *);
+  for (i = 0; i < done; i++)
+    handles[i] = prod_head + i;
+  __rte_ring_sojourn_stamp(r, prod_head, done);
+
+  update_tail(&r->prod, prod_head, prod_next, is_sp, 1);
+end:
+  __RTE_RING_USDT4(enqueue, r, n, done, free_entries - done);
+  __RTE_RING_RECORD(r, 1, n, done);
+  if (free_space != NULL)
+    *free_space = free_entries - done;
+  return done;
+}
+
+/**
+ * Cancel a queued object.
+ *
+ * The slot of the object is atomically replaced by a tombstone, unless a
+ * consumer has already claimed it. The slot stays in the ring until
+ * consumers pass it, but they skip it without returning it.
+ *
+ * @param r
+ *   A pointer to the ring structure, created with RING_F_TOMBSTONE.
+ * @param handle
+ *   The handle returned when the object was enqueued.
+ * @param obj
+ *   The object, checked against the slot content so that a slot reused by a
+ *   later enqueue is left alone. A handle is only unambiguous while the same
+ *   object is not enqueued again in the same slot.
+ * @return
+ *   - 0: Success; the object will not be dequeued.
+ *   - -ENOENT: The object was already dequeued (or cancelled).
+ */
+  static inline int
+rte_ring_cancel(struct rte_ring *r, rte_ring_handle_t handle, void *obj)
+{
+  void **ring = (void **)&r[1];
+  const uint32_t cons_head = r->cons.head;
+
+  /* the object must still be between the consumer head and the producer
+   * tail; every consumer path claims slots of a tombstone ring with an
+   * exchange, which settles any race past this check */
+  if (handle - cons_head >= r->prod.tail - cons_head)
+    return -ENOENT;
+
+  return __sync_bool_compare_and_swap(&ring[handle & r->mask], obj,
+      RTE_RING_TOMBSTONE) ? 0 : -ENOENT;
+}
+
+/* keys are extracted this many objects at a time before scattering, so
+ * the (usually missing) loads of the keys overlap. Nothing is vectorized:
+ * the clamp to the last bin is part of the scatter, whose stores depend on
+ * the counts, and an AVX2 gather of the u32 keys measured no faster than
+ * these scalar loads */
+#define __RTE_RING_CLASSIFY_BATCH 8
+
+/* @internal visitor distributing dequeued slots to bins by key */
+template <typename K>
+struct __rte_ring_classify {
+  const K &key;
+  void ***bins;
+  unsigned int nb_bins;
+  unsigned int *counts;
+
+  void operator()(void **objs, unsigned int n) const
+  {
+    unsigned int keys[__RTE_RING_CLASSIFY_BATCH];
+    unsigned int i, j, cnt, k;
+    const unsigned int last = nb_bins - 1;
+
+    for (i = 0; i < n; i += cnt) {
+      cnt = n - i;
+      if (cnt > __RTE_RING_CLASSIFY_BATCH)
+        cnt = __RTE_RING_CLASSIFY_BATCH;
+      for (j = 0; j < cnt; j++)
+        keys[j] = key(objs[i + j]);
+      for (j = 0; j < cnt; j++) {
+        k = keys[j] < last ? keys[j] : last;
+        bins[k][counts[k]++] = objs[i + j];
+      }
+    }
+  }
+};
+
+/* @internal key read from a 32-bit integer at a fixed offset of objects;
+ * the visitor never sees tombstones (see __rte_ring_do_dequeue_apply_live()) */
+struct __rte_ring_key_u32 {
+  size_t offset;
+
+  unsigned int operator()(const void *obj) const
+  {
+    return *(const uint32_t *)((const char *)obj + offset);
+  }
+};
+
+/* @internal adapts a C key extractor to the callable expected above */
+struct __rte_ring_key_cb {
+  rte_ring_key_fn_t fn;
+  void *ctx;
+
+  unsigned int operator()(const void *obj) const { return fn(obj, ctx); }
+};
+
+/**
+ * Dequeue objects from a ring and distribute them to bins by key, with an
+ * inlinable key extractor.
+ *
+ * The objects are written straight from the ring storage to their bin, the
+ * way a counting sort does, so that consumers processing objects grouped by
+ * key do not need a separate sort. Objects keep their ring order within a
+ * bin. The default consumer behaviour of the ring is used (see flags). On a
+ * RING_F_TOMBSTONE ring, cancelled objects are skipped before their key is
+ * extracted.
+ *
+ * Classifying costs a few cycles per object more than
+ * rte_ring_dequeue_burst(), as the keys are loaded and the objects
+ * scattered one by one: the classify row of app/ring_perf measures it
+ * against the ring row, with 8 bins and u32 keys in cache.
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param n
+ *   The number of objects to dequeue from the ring.
+ * @param key
+ *   Callable invoked as key(const void *obj), returning the bin of obj.
+ *   Objects with a key of nb_bins or more go to the last bin.
+ * @param bins
+ *   A table of nb_bins object tables. Objects are appended to bins[k] at
+ *   index counts[k], so each table must have room for counts[k] + n more.
+ * @param nb_bins
+ *   The number of bins, at least 1; nothing is dequeued with 0.
+ * @param counts
+ *   A table of nb_bins counters, incremented by the number of objects
+ *   appended to each bin. Zero it before the first call.
+ * @param available
+ *   If non-NULL, returns the number of remaining ring entries after the
+ *   dequeue has finished.
+ * @return
+ *   - Number of objects dequeued
+ */
+template <typename K>
+  static __rte_always_inline unsigned
+rte_ring_dequeue_burst_classify(struct rte_ring *r, unsigned int n,
+    const K &key, void ***bins, unsigned int nb_bins, unsigned int *counts,
+    unsigned int *available)
+{
+  const struct __rte_ring_classify<K> cl = { key, bins, nb_bins, counts };
+
+  /* no bin to put the objects in, leave them in the ring */
+  if (unlikely(nb_bins == 0))
+    return 0;
+  return __rte_ring_do_dequeue_apply(r, n, RTE_RING_QUEUE_VARIABLE,
+      r->cons.single, cl, available);
+}
+
+/**
+ * Dequeue objects from a ring and distribute them to bins by key.
+ *
+ * See the callable version of rte_ring_dequeue_burst_classify().
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param n
+ *   The number of objects to dequeue from the ring.
+ * @param key_fn
+ *   The key extractor.
+ * @param ctx
+ *   Opaque argument passed to *key_fn*.
+ * @param bins
+ *   A table of nb_bins object tables.
+ * @param nb_bins
+ *   The number of bins, at least 1; nothing is dequeued with 0.
+ * @param counts
+ *   A table of nb_bins counters, incremented as objects are appended.
+ * @param available
+ *   If non-NULL, returns the number of remaining ring entries after the
+ *   dequeue has finished.
+ * @return
+ *   - Number of objects dequeued
+ */
+  static __rte_always_inline unsigned
+rte_ring_dequeue_burst_classify(struct rte_ring *r, unsigned int n,
+    rte_ring_key_fn_t key_fn, void *ctx, void ***bins, unsigned int nb_bins,
+    unsigned int *counts, unsigned int *available)
+{
+  const struct __rte_ring_key_cb key = { key_fn, ctx };
+
+  return rte_ring_dequeue_burst_classify(r, n, key, bins, nb_bins, counts,
+      available);
+}
+
+/**
+ * Dequeue objects from a ring and distribute them to bins by an integer key
+ * stored in the objects.
+ *
+ * See the callable version of rte_ring_dequeue_burst_classify(). The key of
+ * each object is the 32-bit unsigned integer found *key_offset* bytes into
+ * it.
+ *
+ * @param r
+ *   A pointer to the ring structure.
+ * @param n
+ *   The number of objects to dequeue from the ring.
+ * @param key_offset
+ *   Offset of the key in the objects.
+ * @param bins
+ *   A table of nb_bins object tables.
+ * @param nb_bins
+ *   The number of bins, at least 1; nothing is dequeued with 0.
+ * @param counts
+ *   A table of nb_bins counters, incremented as objects are appended.
+ * @param available
+ *   If non-NULL, returns the number of remaining ring entries after the
+ *   dequeue has finished.
+ * @return
+ *   - Number of objects dequeued
+ */
+  static __rte_always_inline unsigned
+rte_ring_dequeue_burst_classify_u32(struct rte_ring *r, unsigned int n,
+    size_t key_offset, void ***bins, unsigned int nb_bins,
+    unsigned int *counts, unsigned int *available)
+{
+  const struct __rte_ring_key_u32 key = { key_offset };
+
+  return rte_ring_dequeue_burst_classify(r, n, key, bins, nb_bins, counts,
+      available);
+}
+
 #endif /* _RTE_RING_H_ */
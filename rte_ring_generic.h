@@ -13,6 +13,8 @@
 static __rte_always_inline void update_tail(struct rte_ring_headtail *ht, uint32_t old_val, uint32_t new_val,
     uint32_t single, uint32_t enqueue)
 {
+  __RTE_RING_PREEMPT_POINT(ht, enqueue);
+
   if (enqueue)
     rte_smp_wmb();
   else
@@ -22,8 +24,8 @@ static __rte_always_inline void update_tail(struct rte_ring_headtail *ht, uint32
    * we need to wait for them to complete
    */
   if (!single)
-    while (unlikely(ht->tail != old_val))
-      usleep(1);
+    __RTE_RING_PROFILE_TAIL_WAIT(ht, enqueue, ht->tail != old_val,
+        usleep(1));
 
   ht->tail = new_val;
 }
@@ -59,6 +61,7 @@ static __rte_always_inline unsigned int __rte_ring_move_prod_head(struct rte_rin
   const uint32_t capacity = r->capacity;
   unsigned int max = n;
   int success;
+  __RTE_RING_PROFILE_HEAD_DECL;
 
   do {
     /* Reset n to the initial burst count */
@@ -84,16 +87,21 @@ static __rte_always_inline unsigned int __rte_ring_move_prod_head(struct rte_rin
       n = (behavior == RTE_RING_QUEUE_FIXED) ?
         0 : *free_entries;
 
-    if (n == 0)
+    if (n == 0) {
+      __RTE_RING_PROFILE_HEAD_DONE(&r->prod, 1);
       return 0;
+    }
 
     *new_head = *old_head + n;
     if (is_sp)
       r->prod.head = *new_head, success = 1;
-    else
-      success = rte_atomic32_cmpset(&r->prod.head,
-          *old_head, *new_head);
+    else if (!(success = rte_atomic32_cmpset(&r->prod.head,
+            *old_head, *new_head))) {
+      __RTE_RING_PROFILE_CAS_FAIL();
+      __RTE_RING_USDT2(prod_retry, r, *old_head);
+    }
   } while (unlikely(success == 0));
+  __RTE_RING_PROFILE_HEAD_DONE(&r->prod, 1);
   return n;
 }
 
@@ -127,6 +135,7 @@ static __rte_always_inline unsigned int __rte_ring_move_cons_head(struct rte_rin
 {
   unsigned int max = n;
   int success;
+  __RTE_RING_PROFILE_HEAD_DECL;
 
   /* move cons.head atomically */
   do {
@@ -151,16 +160,21 @@ static __rte_always_inline unsigned int __rte_ring_move_cons_head(struct rte_rin
     if (n > *entries)
       n = (behavior == RTE_RING_QUEUE_FIXED) ? 0 : *entries;
 
-    if (unlikely(n == 0))
+    if (unlikely(n == 0)) {
+      __RTE_RING_PROFILE_HEAD_DONE(&r->cons, 0);
       return 0;
+    }
 
     *new_head = *old_head + n;
     if (is_sc)
       r->cons.head = *new_head, success = 1;
-    else
-      success = rte_atomic32_cmpset(&r->cons.head, *old_head,
-          *new_head);
+    else if (!(success = rte_atomic32_cmpset(&r->cons.head, *old_head,
+            *new_head))) {
+      __RTE_RING_PROFILE_CAS_FAIL();
+      __RTE_RING_USDT2(cons_retry, r, *old_head);
+    }
   } while (unlikely(success == 0));
+  __RTE_RING_PROFILE_HEAD_DONE(&r->cons, 0);
   return n;
 }
 
@@ -0,0 +1,261 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include <my_global.h>
+#include <my_sys.h>
+#include <mysqld_error.h>
+
+#include "rte_ring_loadgen.h"
+
+static const char * const arrival_names[] = {
+  "constant", "poisson", "pareto", "onoff"
+};
+
+static const char * const dist_names[] = {
+  "fixed", "uniform", "exp", "pareto"
+};
+
+/* index of name in names, -1 if absent */
+static int loadgen_lookup(const char * const *names, unsigned int nb,
+    const char *name, size_t len)
+{
+  unsigned int i;
+
+  for (i = 0; i < nb; i++)
+    if (strlen(names[i]) == len && strncmp(names[i], name, len) == 0)
+      return (int)i;
+  return -1;
+}
+
+/* parse DIST: type:mean[:alpha] */
+static int loadgen_parse_dist(const char *s, size_t len,
+    struct rte_ring_loadgen_dist *d)
+{
+  const char *colon = (const char *)memchr(s, ':', len);
+  char *end;
+  int type;
+
+  if (colon == NULL)
+    return -EINVAL;
+  type = loadgen_lookup(dist_names, 4, s, colon - s);
+  if (type < 0)
+    return -EINVAL;
+  d->type = (enum rte_ring_loadgen_dist_type)type;
+  d->mean = strtod(colon + 1, &end);
+  if (end == colon + 1 || d->mean < 0)
+    return -EINVAL;
+  if (end < s + len && *end == ':')
+    d->alpha = strtod(end + 1, &end);
+  if (end != s + len || (d->type == RTE_RING_LOADGEN_PARETO_DIST &&
+        d->alpha <= 1))
+    return -EINVAL;
+  return 0;
+}
+
+int rte_ring_loadgen_parse(const char *spec,
+    struct rte_ring_loadgen_config *cfg)
+{
+  const char *p = spec, *eq, *end;
+  size_t klen, vlen;
+  char *num_end;
+  double v;
+  int i, ret = 0;
+
+  while (*p != '\0' && ret == 0) {
+    end = strchr(p, ',');
+    if (end == NULL)
+      end = p + strlen(p);
+    eq = (const char *)memchr(p, '=', end - p);
+    if (eq == NULL) {
+      ret = -EINVAL;
+      break;
+    }
+    klen = eq - p;
+    vlen = end - eq - 1;
+
+    if (klen == 7 && strncmp(p, "arrival", 7) == 0) {
+      i = loadgen_lookup(arrival_names, 4, eq + 1, vlen);
+      if (i < 0)
+        ret = -EINVAL;
+      else
+        cfg->arrival = (enum rte_ring_loadgen_arrival)i;
+    } else if (klen == 5 && strncmp(p, "burst", 5) == 0) {
+      ret = loadgen_parse_dist(eq + 1, vlen, &cfg->burst);
+    } else if (klen == 7 && strncmp(p, "service", 7) == 0) {
+      ret = loadgen_parse_dist(eq + 1, vlen, &cfg->service);
+    } else {
+      v = strtod(eq + 1, &num_end);
+      if (num_end != end || v < 0)
+        ret = -EINVAL;
+      else if (klen == 4 && strncmp(p, "rate", 4) == 0)
+        cfg->rate = v;
+      else if (klen == 5 && strncmp(p, "alpha", 5) == 0)
+        cfg->alpha = v;
+      else if (klen == 2 && strncmp(p, "on", 2) == 0)
+        cfg->on_us = v;
+      else if (klen == 3 && strncmp(p, "off", 3) == 0)
+        cfg->off_us = v;
+      else
+        ret = -EINVAL;
+    }
+    p = *end == ',' ? end + 1 : end;
+  }
+
+  if (ret == 0 && (cfg->rate <= 0 ||
+        (cfg->arrival == RTE_RING_LOADGEN_PARETO && cfg->alpha <= 1) ||
+        (cfg->arrival == RTE_RING_LOADGEN_ONOFF && cfg->on_us <= 0)))
+    ret = -EINVAL;
+  if (ret != 0)
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Invalid traffic description %s",
+        MYF(0),
+        spec);
+  return ret;
+}
+
+void rte_ring_loadgen_init(struct rte_ring_loadgen *g,
+    const struct rte_ring_loadgen_config *cfg, uint64_t seed)
+{
+  g->cfg = *cfg;
+  /* xorshift must not start from 0 */
+  g->rng = seed * 0x9e3779b97f4a7c15ULL + 1;
+  g->cycles_per_ns = rte_get_tsc_hz() / 1e9;
+  g->on_left = 0;
+}
+
+/* uniform in (0, 1] */
+static double loadgen_uniform(struct rte_ring_loadgen *g)
+{
+  g->rng ^= g->rng >> 12;
+  g->rng ^= g->rng << 25;
+  g->rng ^= g->rng >> 27;
+  return ((g->rng * 0x2545f4914f6cdd1dULL >> 11) + 1) / 9007199254740992.0;
+}
+
+static double loadgen_exponential(struct rte_ring_loadgen *g, double mean)
+{
+  return -mean * log(loadgen_uniform(g));
+}
+
+/* Pareto of the given mean: scale mean * (alpha - 1) / alpha */
+static double loadgen_pareto(struct rte_ring_loadgen *g, double mean,
+    double alpha)
+{
+  return mean * (alpha - 1) / alpha / pow(loadgen_uniform(g), 1 / alpha);
+}
+
+static double loadgen_draw(struct rte_ring_loadgen *g,
+    const struct rte_ring_loadgen_dist *d)
+{
+  switch (d->type) {
+    case RTE_RING_LOADGEN_UNIFORM:
+      return 2 * d->mean * loadgen_uniform(g);
+    case RTE_RING_LOADGEN_EXPONENTIAL:
+      return loadgen_exponential(g, d->mean);
+    case RTE_RING_LOADGEN_PARETO_DIST:
+      return loadgen_pareto(g, d->mean, d->alpha);
+    default:
+      return d->mean;
+  }
+}
+
+uint64_t rte_ring_loadgen_gap(struct rte_ring_loadgen *g)
+{
+  const double mean = 1e9 / g->cfg.rate * g->cycles_per_ns;
+  double gap, off = 0;
+
+  switch (g->cfg.arrival) {
+    case RTE_RING_LOADGEN_POISSON:
+      gap = loadgen_exponential(g, mean);
+      break;
+    case RTE_RING_LOADGEN_PARETO:
+      gap = loadgen_pareto(g, mean, g->cfg.alpha);
+      break;
+    case RTE_RING_LOADGEN_ONOFF:
+      /* skip the off periods the gap runs into */
+      gap = loadgen_exponential(g, mean);
+      while (gap > g->on_left) {
+        gap -= g->on_left;
+        off += loadgen_exponential(g, g->cfg.off_us * 1e3 * g->cycles_per_ns);
+        g->on_left = loadgen_exponential(g,
+            g->cfg.on_us * 1e3 * g->cycles_per_ns);
+      }
+      g->on_left -= gap;
+      gap += off;
+      break;
+    default:
+      gap = mean;
+      break;
+  }
+  return (uint64_t)gap;
+}
+
+unsigned int rte_ring_loadgen_burst(struct rte_ring_loadgen *g,
+    unsigned int max)
+{
+  const double n = loadgen_draw(g, &g->cfg.burst) + 0.5;
+
+  if (n < 1)
+    return 1;
+  return n > max ? max : (unsigned int)n;
+}
+
+uint64_t rte_ring_loadgen_service(struct rte_ring_loadgen *g, unsigned int n)
+{
+  double ns = 0;
+  unsigned int i;
+
+  if (g->cfg.service.mean == 0)
+    return 0;
+  if (g->cfg.service.type == RTE_RING_LOADGEN_FIXED)
+    ns = n * g->cfg.service.mean;
+  else
+    for (i = 0; i < n; i++)
+      ns += loadgen_draw(g, &g->cfg.service);
+  return (uint64_t)(ns * g->cycles_per_ns);
+}
+
+void rte_ring_loadgen_stats_add(struct rte_ring_loadgen_stats *dst,
+    const struct rte_ring_loadgen_stats *src)
+{
+  unsigned int b;
+
+  if (src->cycles > dst->cycles)
+    dst->cycles = src->cycles;
+  dst->offered += src->offered;
+  dst->enqueued += src->enqueued;
+  dst->dropped += src->dropped;
+  dst->dequeued += src->dequeued;
+  for (b = 0; b < RTE_RING_SOJOURN_HIST; b++)
+    dst->latency.hist[b] += src->latency.hist[b];
+  dst->latency.count += src->latency.count;
+  dst->latency.sum += src->latency.sum;
+  if (src->latency.max > dst->latency.max)
+    dst->latency.max = src->latency.max;
+}
+
+static void loadgen_print_dist(FILE *f, const char *key,
+    const struct rte_ring_loadgen_dist *d)
+{
+  fprintf(f, ",%s=%s:%g", key, dist_names[d->type], d->mean);
+  if (d->type == RTE_RING_LOADGEN_PARETO_DIST)
+    fprintf(f, ":%g", d->alpha);
+}
+
+void rte_ring_loadgen_print(FILE *f, const struct rte_ring_loadgen_config *cfg)
+{
+  fprintf(f, "arrival=%s,rate=%g", arrival_names[cfg->arrival], cfg->rate);
+  if (cfg->arrival == RTE_RING_LOADGEN_PARETO)
+    fprintf(f, ",alpha=%g", cfg->alpha);
+  if (cfg->arrival == RTE_RING_LOADGEN_ONOFF)
+    fprintf(f, ",on=%g,off=%g", cfg->on_us, cfg->off_us);
+  loadgen_print_dist(f, "burst", &cfg->burst);
+  loadgen_print_dist(f, "service", &cfg->service);
+}
@@ -0,0 +1,209 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _RTE_RING_LOADGEN_H_
+#define _RTE_RING_LOADGEN_H_
+
+/**
+ * @file
+ * RTE Ring load generator
+ *
+ * Open-loop traffic for the ring benchmarks: a producer asks the generator
+ * when its next burst arrives and how large it is, enqueues it at that
+ * time whether or not the ring keeps up, and counts what does not fit as
+ * dropped. A consumer asks how long serving the objects it dequeued takes.
+ *
+ * Arrival processes, at a mean rate of bursts per second:
+ *
+ * - constant: evenly spaced bursts;
+ * - poisson:  exponential gaps;
+ * - pareto:   Pareto gaps of shape alpha (1 < alpha <= 2 for heavy tails),
+ *             long silences broken by clusters of bursts;
+ * - onoff:    Poisson arrivals during exponential on periods, none during
+ *             exponential off periods.
+ *
+ * Burst sizes (objects) and service times (nanoseconds per object) follow
+ * a fixed, uniform, exponential or Pareto distribution of a given mean.
+ *
+ * Latency is counted from the scheduled arrival of an object, not from the
+ * time it was enqueued, so that a producer falling behind does not hide
+ * the queueing it would have seen (coordinated omission).
+ *
+ * A generator is owned by one thread; statistics are kept per thread and
+ * merged with rte_ring_loadgen_stats_add().
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <rte_common.h>
+#include "rte_ring.h"
+
+/** Arrival process. */
+enum rte_ring_loadgen_arrival {
+  RTE_RING_LOADGEN_CONSTANT,
+  RTE_RING_LOADGEN_POISSON,
+  RTE_RING_LOADGEN_PARETO,
+  RTE_RING_LOADGEN_ONOFF,
+};
+
+/** Type of a distribution. */
+enum rte_ring_loadgen_dist_type {
+  RTE_RING_LOADGEN_FIXED,        /**< Always the mean. */
+  RTE_RING_LOADGEN_UNIFORM,      /**< Uniform over [0, 2 * mean]. */
+  RTE_RING_LOADGEN_EXPONENTIAL,  /**< Exponential. */
+  RTE_RING_LOADGEN_PARETO_DIST,  /**< Pareto of shape alpha. */
+};
+
+/** A distribution of burst sizes or service times. */
+struct rte_ring_loadgen_dist {
+  enum rte_ring_loadgen_dist_type type;
+  double mean;             /**< Mean value. */
+  double alpha;            /**< Shape, for Pareto, > 1. */
+};
+
+/** Traffic of a generator. */
+struct rte_ring_loadgen_config {
+  enum rte_ring_loadgen_arrival arrival;
+  double rate;             /**< Mean bursts per second, while on. */
+  double alpha;            /**< Shape of Pareto gaps, > 1. */
+  double on_us;            /**< Mean on period of onoff, microseconds. */
+  double off_us;           /**< Mean off period of onoff, microseconds. */
+  struct rte_ring_loadgen_dist burst;   /**< Objects per burst. */
+  struct rte_ring_loadgen_dist service; /**< Nanoseconds per object. */
+};
+
+/** A generator, owned by one thread. */
+struct rte_ring_loadgen {
+  struct rte_ring_loadgen_config cfg;
+  uint64_t rng;            /**< xorshift64* state. */
+  double cycles_per_ns;
+  double on_left;          /**< Cycles left in the on period of onoff. */
+};
+
+/** What the threads of a run saw. */
+struct rte_ring_loadgen_stats {
+  uint64_t cycles;         /**< Duration of the run. */
+  uint64_t offered;        /**< Objects the producers tried to enqueue. */
+  uint64_t enqueued;       /**< Objects enqueued. */
+  uint64_t dropped;        /**< Objects not enqueued on a full ring. */
+  uint64_t dequeued;       /**< Objects dequeued and served. */
+  /** Latency from scheduled arrival to end of service, in TSC cycles, in
+   * the layout of the sojourn statistics for rte_ring_sojourn_percentile(). */
+  struct rte_ring_sojourn latency;
+};
+
+/**
+ * Parse a traffic description: comma separated key=value pairs among
+ * arrival=constant|poisson|pareto|onoff, rate=bursts per second,
+ * alpha=Pareto shape of the gaps, on=us, off=us, burst=DIST and
+ * service=DIST, where DIST is fixed|uniform|exp|pareto:mean[:alpha].
+ * Unset keys keep their value in *cfg*.
+ *
+ * @param spec
+ *   The description, e.g. "arrival=pareto,rate=50000,burst=exp:16".
+ * @param cfg
+ *   The configuration to update.
+ * @return
+ *   0 on success, -EINVAL on a syntax error or an invalid value.
+ */
+int rte_ring_loadgen_parse(const char *spec,
+    struct rte_ring_loadgen_config *cfg);
+
+/**
+ * Set up a generator.
+ *
+ * @param g
+ *   The generator.
+ * @param cfg
+ *   Its traffic.
+ * @param seed
+ *   Seed of its random numbers, different for each thread.
+ */
+void rte_ring_loadgen_init(struct rte_ring_loadgen *g,
+    const struct rte_ring_loadgen_config *cfg, uint64_t seed);
+
+/**
+ * Draw the time until the next burst arrives.
+ *
+ * @param g
+ *   The generator.
+ * @return
+ *   The gap in TSC cycles.
+ */
+uint64_t rte_ring_loadgen_gap(struct rte_ring_loadgen *g);
+
+/**
+ * Draw the size of a burst.
+ *
+ * @param g
+ *   The generator.
+ * @param max
+ *   Largest size returned.
+ * @return
+ *   The number of objects, from 1 to max.
+ */
+unsigned int rte_ring_loadgen_burst(struct rte_ring_loadgen *g,
+    unsigned int max);
+
+/**
+ * Draw the time serving objects takes.
+ *
+ * @param g
+ *   The generator.
+ * @param n
+ *   Number of objects.
+ * @return
+ *   The service time of the n objects, in TSC cycles.
+ */
+uint64_t rte_ring_loadgen_service(struct rte_ring_loadgen *g, unsigned int n);
+
+/**
+ * Count the latency of served objects.
+ *
+ * @param stats
+ *   Statistics of the calling thread.
+ * @param latency
+ *   Latency of the objects in TSC cycles.
+ * @param n
+ *   Number of objects.
+ */
+static inline void
+  rte_ring_loadgen_latency(struct rte_ring_loadgen_stats *stats,
+      uint64_t latency, unsigned int n)
+{
+  struct rte_ring_sojourn *l = &stats->latency;
+
+  /* served on a core whose TSC is slightly behind */
+  if ((int64_t)latency < 0)
+    latency = 0;
+  l->hist[latency == 0 ? 0 : 64 - __builtin_clzll(latency)] += n;
+  l->count += n;
+  l->sum += latency * n;
+  if (latency > l->max)
+    l->max = latency;
+}
+
+/**
+ * Add the statistics of a thread to the statistics of a run. The duration
+ * of the run is the longest.
+ *
+ * @param dst
+ *   Statistics of the run.
+ * @param src
+ *   Statistics of a thread.
+ */
+void rte_ring_loadgen_stats_add(struct rte_ring_loadgen_stats *dst,
+    const struct rte_ring_loadgen_stats *src);
+
+/**
+ * Write a traffic description in the syntax of rte_ring_loadgen_parse().
+ *
+ * @param f
+ *   A pointer to a file for output.
+ * @param cfg
+ *   The traffic.
+ */
+void rte_ring_loadgen_print(FILE *f, const struct rte_ring_loadgen_config *cfg);
+
+#endif /* _RTE_RING_LOADGEN_H_ */
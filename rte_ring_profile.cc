@@ -0,0 +1,282 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <my_global.h>
+#include <my_sys.h>
+#include <mysqld_error.h>
+
+#include "rte_ring.h"
+#include "rte_ring_profile.h"
+
+#define PROFILE_SLOTS 64          /* ring sides per thread, a power of 2 */
+#define PROFILE_REPORT_THREADS 8  /* threads listed per ring side */
+
+/* what a thread recorded about one ring side */
+struct profile_entry {
+  const struct rte_ring_headtail *ht;   /* key, NULL if the slot is free */
+  unsigned int enqueue;
+  uint64_t calls;
+  uint64_t cas_failures;
+  uint64_t cas_cycles;
+  uint64_t waits;
+  uint64_t wait_cycles;
+  uint64_t wait_max;
+  uint64_t wait_hist[RTE_RING_PROFILE_HIST];
+};
+
+/* the table of a thread, only written by that thread */
+struct profile_thread {
+  struct profile_thread *next;
+  long tid;
+  volatile unsigned int generation;  /* of the data, see profile_generation */
+  uint64_t dropped;          /* events lost because the table was full */
+  struct profile_entry entries[PROFILE_SLOTS];
+};
+
+/* a ring side in the report, summed over the threads */
+struct profile_sum {
+  struct profile_entry e;
+  uint64_t wasted;
+  unsigned int nb_threads;
+  long tids[PROFILE_REPORT_THREADS];
+  uint64_t tid_wasted[PROFILE_REPORT_THREADS];
+};
+
+unsigned int __rte_ring_profile_period_mask =
+  RTE_RING_PROFILE_DEFAULT_PERIOD - 1;
+__thread unsigned int __rte_ring_profile_calls;
+
+/* all the thread tables, pushed locklessly and never removed */
+static struct profile_thread *volatile profile_threads;
+static __thread struct profile_thread *profile_self;
+/* bumped by rte_ring_profile_reset(); tables of an older generation are
+ * cleared by their owner at its next record, and not reported until then */
+static volatile unsigned int profile_generation;
+
+static struct profile_thread *profile_thread_get(void)
+{
+  struct profile_thread *t = profile_self;
+
+  if (likely(t != NULL))
+    return t;
+
+  t = (struct profile_thread *)my_malloc(sizeof(*t), MYF(MY_ZEROFILL));
+  if (t == NULL)
+    return NULL;
+  t->tid = syscall(SYS_gettid);
+  t->generation = __atomic_load_n(&profile_generation, __ATOMIC_ACQUIRE);
+  do {
+    t->next = profile_threads;
+  } while (!__sync_bool_compare_and_swap(&profile_threads, t->next, t));
+  profile_self = t;
+  return t;
+}
+
+/* empty the table of the calling thread, keys included, so that rings freed
+ * since the last reset give their slots back */
+static void profile_thread_clear(struct profile_thread *t,
+    unsigned int generation)
+{
+  memset(t->entries, 0, sizeof(t->entries));
+  t->dropped = 0;
+  __atomic_store_n(&t->generation, generation, __ATOMIC_RELEASE);
+}
+
+static unsigned int profile_log2(uint64_t v)
+{
+  unsigned int b = 63 - __builtin_clzll(v | 1);
+
+  return b < RTE_RING_PROFILE_HIST ? b : RTE_RING_PROFILE_HIST - 1;
+}
+
+void __rte_ring_profile_record(const struct rte_ring_headtail *ht,
+    unsigned int enqueue, unsigned int calls, unsigned int cas_failures,
+    uint64_t cas_cycles, uint64_t wait_cycles)
+{
+  struct profile_thread *t = profile_thread_get();
+  struct profile_entry *e;
+  unsigned int i, idx, generation;
+
+  if (t == NULL)
+    return;
+  generation = __atomic_load_n(&profile_generation, __ATOMIC_ACQUIRE);
+  if (unlikely(t->generation != generation))
+    profile_thread_clear(t, generation);
+
+  /* open addressing on the cache line of the head/tail */
+  idx = (unsigned int)((uintptr_t)ht >> 6);
+  for (i = 0; i < PROFILE_SLOTS; i++) {
+    e = &t->entries[(idx + i) & (PROFILE_SLOTS - 1)];
+    if (e->ht == ht)
+      break;
+    if (e->ht == NULL) {
+      e->enqueue = enqueue;
+      /* publish the key last, for rte_ring_profile_dump() */
+      __atomic_store_n(&e->ht, ht, __ATOMIC_RELEASE);
+      break;
+    }
+  }
+  if (unlikely(i == PROFILE_SLOTS)) {
+    t->dropped++;
+    return;
+  }
+
+  e->calls += calls;
+  e->cas_failures += cas_failures;
+  e->cas_cycles += cas_cycles;
+  if (wait_cycles != 0) {
+    e->waits++;
+    e->wait_cycles += wait_cycles;
+    if (wait_cycles > e->wait_max)
+      e->wait_max = wait_cycles;
+    e->wait_hist[profile_log2(wait_cycles)]++;
+  }
+}
+
+int rte_ring_profile_set_period(unsigned int period)
+{
+  if (!POWEROF2(period) || period == 0) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Profile period %u is not a power of 2",
+        MYF(0),
+        period);
+    return -EINVAL;
+  }
+  __rte_ring_profile_period_mask = period - 1;
+  return 0;
+}
+
+void rte_ring_profile_reset(void)
+{
+  /* only the owner of a table writes it, so it clears it itself */
+  __atomic_add_fetch(&profile_generation, 1, __ATOMIC_RELEASE);
+}
+
+static int profile_cmp_wasted(const void *a, const void *b)
+{
+  const struct profile_sum *x = (const struct profile_sum *)a;
+  const struct profile_sum *y = (const struct profile_sum *)b;
+
+  return x->wasted < y->wasted ? 1 : x->wasted > y->wasted ? -1 : 0;
+}
+
+/* upper bound of the bucket holding the given fraction of the waits */
+static uint64_t profile_percentile(const struct profile_entry *e, double q)
+{
+  uint64_t seen = 0;
+  unsigned int b;
+
+  for (b = 0; b < RTE_RING_PROFILE_HIST; b++) {
+    seen += e->wait_hist[b];
+    if (seen >= q * e->waits)
+      break;
+  }
+  return 2ULL << b;
+}
+
+static const struct rte_ring *profile_ring(const struct profile_entry *e)
+{
+  return (const struct rte_ring *)((const char *)e->ht -
+      (e->enqueue ? offsetof(struct rte_ring, prod) :
+       offsetof(struct rte_ring, cons)));
+}
+
+unsigned int rte_ring_profile_dump(FILE *f, unsigned int max_rings)
+{
+  const unsigned int max_sums = 1024;
+  struct profile_sum *sums, *s;
+  struct profile_thread *t;
+  const struct profile_entry *e;
+  const struct rte_ring_headtail *ht;
+  uint64_t wasted, dropped = 0;
+  unsigned int i, j, b, nb = 0, generation;
+
+  sums = (struct profile_sum *)my_malloc(max_sums * sizeof(*sums),
+      MYF(MY_ZEROFILL));
+  if (sums == NULL) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot reserve memory",
+        MYF(0));
+    return 0;
+  }
+
+  generation = __atomic_load_n(&profile_generation, __ATOMIC_ACQUIRE);
+  for (t = profile_threads; t != NULL; t = t->next) {
+    /* recorded before the last reset */
+    if (__atomic_load_n(&t->generation, __ATOMIC_ACQUIRE) != generation)
+      continue;
+    dropped += t->dropped;
+    for (i = 0; i < PROFILE_SLOTS; i++) {
+      e = &t->entries[i];
+      ht = __atomic_load_n(&e->ht, __ATOMIC_ACQUIRE);
+      if (ht == NULL || (e->calls == 0 && e->cas_failures == 0 &&
+            e->waits == 0))
+        continue;
+      for (j = 0; j < nb && sums[j].e.ht != ht; j++)
+        ;
+      if (j == nb) {
+        if (nb == max_sums)
+          continue;
+        sums[nb].e.ht = ht;
+        sums[nb].e.enqueue = e->enqueue;
+        nb++;
+      }
+      s = &sums[j];
+      s->e.calls += e->calls;
+      s->e.cas_failures += e->cas_failures;
+      s->e.cas_cycles += e->cas_cycles;
+      s->e.waits += e->waits;
+      s->e.wait_cycles += e->wait_cycles;
+      if (e->wait_max > s->e.wait_max)
+        s->e.wait_max = e->wait_max;
+      for (b = 0; b < RTE_RING_PROFILE_HIST; b++)
+        s->e.wait_hist[b] += e->wait_hist[b];
+      wasted = e->cas_cycles + e->wait_cycles;
+      s->wasted += wasted;
+      if (s->nb_threads < PROFILE_REPORT_THREADS) {
+        s->tids[s->nb_threads] = t->tid;
+        s->tid_wasted[s->nb_threads] = wasted;
+      }
+      s->nb_threads++;
+    }
+  }
+
+  qsort(sums, nb, sizeof(*sums), profile_cmp_wasted);
+
+  fprintf(f, "ring contention profile: %u ring sides, sampling 1/%u calls",
+      nb, __rte_ring_profile_period_mask + 1);
+  if (dropped)
+    fprintf(f, ", %" PRIu64 " events dropped", dropped);
+  fprintf(f, "\n");
+  for (i = 0; i < nb && (max_rings == 0 || i < max_rings); i++) {
+    s = &sums[i];
+    fprintf(f, "ring <%p> %s: wasted %" PRIu64 " cycles\n",
+        (const void *)profile_ring(&s->e), s->e.enqueue ? "prod" : "cons",
+        s->wasted);
+    fprintf(f, "  calls ~%" PRIu64 ", CAS failures %" PRIu64 " (%.2f%%),"
+        " CAS retry cycles %" PRIu64 "\n", s->e.calls, s->e.cas_failures,
+        s->e.calls ? 100.0 * s->e.cas_failures / s->e.calls : 0.0,
+        s->e.cas_cycles);
+    if (s->e.waits)
+      fprintf(f, "  tail waits %" PRIu64 ", cycles %" PRIu64 ", p50 <%"
+          PRIu64 ", p99 <%" PRIu64 ", max %" PRIu64 "\n", s->e.waits,
+          s->e.wait_cycles, profile_percentile(&s->e, 0.5),
+          profile_percentile(&s->e, 0.99), s->e.wait_max);
+    fprintf(f, "  threads %u:", s->nb_threads);
+    for (j = 0; j < s->nb_threads && j < PROFILE_REPORT_THREADS; j++)
+      fprintf(f, " %ld (%" PRIu64 ")", s->tids[j], s->tid_wasted[j]);
+    fprintf(f, "%s\n", s->nb_threads > PROFILE_REPORT_THREADS ? " ..." : "");
+  }
+
+  my_free(sums);
+  return nb;
+}
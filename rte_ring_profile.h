@@ -0,0 +1,160 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _RTE_RING_PROFILE_H_
+#define _RTE_RING_PROFILE_H_
+
+/**
+ * @file
+ * RTE Ring contention profiler
+ *
+ * When built with RTE_RING_PROFILE defined, the ring records where threads
+ * lose time to each other:
+ *
+ * - CAS failures in the multi-producer and multi-consumer head moves, and
+ *   the cycles from the first failure until the head is moved;
+ * - waits in update_tail() for preceding enqueues or dequeues to publish
+ *   their tail, as a log2 histogram of cycles;
+ * - the threads doing them.
+ *
+ * Calls are sampled: every rte_ring_profile_set_period() calls of a thread,
+ * the ring being used is credited with that many calls, so that failure
+ * rates can be estimated without touching shared state on every operation.
+ * Contention events are always recorded.
+ *
+ * Each thread records into its own table of rings, allocated on its first
+ * event and never freed, so the report also covers threads that exited.
+ * rte_ring_profile_dump() reads the tables of all the threads without
+ * stopping them, and ranks the rings by wasted cycles.
+ *
+ * Without RTE_RING_PROFILE, the hooks expand to nothing.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <rte_common.h>
+
+struct rte_ring_headtail;
+
+#define RTE_RING_PROFILE_HIST 32  /**< log2 buckets of tail wait cycles. */
+
+/** Default number of calls between two samples, a power of 2. */
+#define RTE_RING_PROFILE_DEFAULT_PERIOD 64
+
+/** @internal mask of the sampling period */
+extern unsigned int __rte_ring_profile_period_mask;
+/** @internal calls of the thread since its last sample */
+extern __thread unsigned int __rte_ring_profile_calls;
+
+/**
+ * @internal Record the outcome of a head move or a tail wait.
+ *
+ * @param ht
+ *   The head/tail of the ring side being updated.
+ * @param enqueue
+ *   1 for the producer side, 0 for the consumer side.
+ * @param calls
+ *   Number of calls to credit to the ring.
+ * @param cas_failures
+ *   Number of failed compare-and-set of the head.
+ * @param cas_cycles
+ *   Cycles from the first failure until the head was moved.
+ * @param wait_cycles
+ *   Cycles waited for the tail, 0 if it did not wait.
+ */
+void __rte_ring_profile_record(const struct rte_ring_headtail *ht,
+    unsigned int enqueue, unsigned int calls, unsigned int cas_failures,
+    uint64_t cas_cycles, uint64_t wait_cycles);
+
+/**
+ * @internal Account for a head move: sample the call, and record the CAS
+ * failures if any.
+ */
+static __rte_always_inline void
+  __rte_ring_profile_head(const struct rte_ring_headtail *ht,
+      unsigned int enqueue, unsigned int cas_failures, uint64_t first_failure)
+{
+  const unsigned int sampled =
+    (++__rte_ring_profile_calls & __rte_ring_profile_period_mask) == 0;
+
+  if (likely(cas_failures == 0 && !sampled))
+    return;
+  __rte_ring_profile_record(ht, enqueue,
+      sampled ? __rte_ring_profile_period_mask + 1 : 0, cas_failures,
+      cas_failures ? rte_rdtsc() - first_failure : 0, 0);
+}
+
+#ifdef RTE_RING_PROFILE
+
+/* locals of a head move loop */
+#define __RTE_RING_PROFILE_HEAD_DECL \
+  uint64_t __prof_first_failure = 0; \
+  unsigned int __prof_cas_failures = 0
+
+/* a compare-and-set of the head failed */
+#define __RTE_RING_PROFILE_CAS_FAIL() do {               \
+    if (__prof_cas_failures++ == 0)                     \
+      __prof_first_failure = rte_rdtsc();               \
+  } while (0)
+
+/* the head move is over, moved or not */
+#define __RTE_RING_PROFILE_HEAD_DONE(ht, enqueue)       \
+  __rte_ring_profile_head(ht, enqueue, __prof_cas_failures, \
+      __prof_first_failure)
+
+/* wait for the tail with cond, timing the wait if there is one */
+#define __RTE_RING_PROFILE_TAIL_WAIT(ht, enqueue, cond, wait) do { \
+    if (unlikely(cond)) {                                \
+      const uint64_t __prof_t0 = rte_rdtsc();            \
+      while (cond)                                       \
+        wait;                                            \
+      __rte_ring_profile_record(ht, enqueue, 0, 0, 0,    \
+          rte_rdtsc() - __prof_t0);                      \
+    }                                                    \
+  } while (0)
+
+#else
+
+#define __RTE_RING_PROFILE_HEAD_DECL do { } while (0)
+#define __RTE_RING_PROFILE_CAS_FAIL() do { } while (0)
+#define __RTE_RING_PROFILE_HEAD_DONE(ht, enqueue) do { } while (0)
+#define __RTE_RING_PROFILE_TAIL_WAIT(ht, enqueue, cond, wait) do { \
+    while (unlikely(cond))                               \
+      wait;                                              \
+  } while (0)
+
+#endif /* RTE_RING_PROFILE */
+
+/**
+ * Set the number of calls of a thread between two samples.
+ *
+ * @param period
+ *   A power of 2. 1 counts every call.
+ * @return
+ *   0 on success, -EINVAL if period is not a power of 2.
+ */
+int rte_ring_profile_set_period(unsigned int period);
+
+/**
+ * Clear the data recorded so far. Each thread empties its table, ring sides
+ * included, at its next recorded event, so that the slots of rings freed
+ * since are reused; tables not cleared yet are left out of reports. Events
+ * recorded while it runs may be partially lost.
+ */
+void rte_ring_profile_reset(void);
+
+/**
+ * Write a report of the recorded contention, one entry per ring side,
+ * ranked by wasted cycles: CAS retries plus tail waits.
+ *
+ * @param f
+ *   A pointer to a file for output.
+ * @param max_rings
+ *   Maximum number of ring sides reported, 0 for all.
+ * @return
+ *   The number of ring sides with recorded data.
+ */
+unsigned int rte_ring_profile_dump(FILE *f, unsigned int max_rings);
+
+#endif /* _RTE_RING_PROFILE_H_ */
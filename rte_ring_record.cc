@@ -0,0 +1,257 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <my_global.h>
+#include <my_sys.h>
+#include <mysqld_error.h>
+
+#include "rte_ring.h"
+#include "rte_ring_record.h"
+
+/* an event as recorded, tsc is written last and 0 until then */
+struct record_slot {
+  volatile uint64_t tsc;
+  uint32_t n;
+  uint32_t done;
+};
+
+/* the events of one side */
+struct record_side {
+  volatile uint64_t claimed __rte_cache_aligned;
+  struct record_slot *slots;
+};
+
+struct rte_ring_recorder {
+  struct rte_ring *r;
+  unsigned int max_events;
+  uint64_t start;
+  struct record_side sides[2];
+};
+
+void __rte_ring_record(struct rte_ring_recorder *rec, unsigned int enqueue,
+    unsigned int n, unsigned int done)
+{
+  struct record_side *side = &rec->sides[enqueue];
+  struct record_slot *slot;
+  uint64_t i;
+
+  i = __sync_fetch_and_add(&side->claimed, 1);
+  if (unlikely(i >= rec->max_events))
+    return;
+  slot = &side->slots[i];
+  slot->n = n;
+  slot->done = done;
+  rte_smp_wmb();
+  slot->tsc = rte_rdtsc();
+}
+
+struct rte_ring_recorder *rte_ring_record_start(struct rte_ring *r,
+    unsigned int max_events)
+{
+  struct rte_ring_recorder *rec;
+  unsigned int i;
+
+  if (max_events == 0) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "A recording needs room for events",
+        MYF(0));
+    return NULL;
+  }
+  rec = (struct rte_ring_recorder *)my_malloc(sizeof(*rec),
+      MYF(MY_ZEROFILL));
+  if (rec == NULL)
+    goto nomem;
+  for (i = 0; i < 2; i++) {
+    rec->sides[i].slots = (struct record_slot *)my_malloc(
+        (size_t)max_events * sizeof(struct record_slot), MYF(MY_ZEROFILL));
+    if (rec->sides[i].slots == NULL)
+      goto nomem;
+  }
+  rec->r = r;
+  rec->max_events = max_events;
+  rec->start = rte_rdtsc();
+
+  rte_smp_wmb();
+  if (!__sync_bool_compare_and_swap(&r->recorder,
+        (struct rte_ring_recorder *)NULL, rec)) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Ring %p is already recorded",
+        MYF(0),
+        (void *)r);
+    rte_ring_record_free(rec);
+    return NULL;
+  }
+  return rec;
+
+nomem:
+  my_printf_error(ER_UNKNOWN_ERROR,
+      "Cannot reserve memory",
+      MYF(0));
+  rte_ring_record_free(rec);
+  return NULL;
+}
+
+static int cmp_slot_tsc(const void *a, const void *b)
+{
+  const struct record_slot *x = (const struct record_slot *)a;
+  const struct record_slot *y = (const struct record_slot *)b;
+
+  return x->tsc < y->tsc ? -1 : x->tsc > y->tsc;
+}
+
+/* write the events of a side as deltas, in TSC order */
+static void record_write_side(struct rte_ring_recorder *rec,
+    struct record_side *side, uint64_t nb, FILE *f)
+{
+  struct rte_ring_record_event ev;
+  uint64_t prev = rec->start, i, d;
+
+  /* claims are taken in call order, but written by racing threads */
+  qsort(side->slots, nb, sizeof(struct record_slot), cmp_slot_tsc);
+  for (i = 0; i < nb; i++) {
+    d = side->slots[i].tsc - prev;
+    prev = side->slots[i].tsc;
+    ev.delta = d > UINT32_MAX ? UINT32_MAX : (uint32_t)d;
+    ev.n = side->slots[i].n > UINT16_MAX ? UINT16_MAX : side->slots[i].n;
+    ev.done = side->slots[i].done > UINT16_MAX ?
+      UINT16_MAX : side->slots[i].done;
+    fwrite(&ev, sizeof(ev), 1, f);
+  }
+}
+
+int rte_ring_record_stop(struct rte_ring_recorder *rec, const char *path)
+{
+  struct rte_ring_record_header hdr;
+  uint64_t claimed, i;
+  unsigned int s;
+  FILE *f;
+  int err;
+
+  if (rec->r != NULL) {
+    rec->r->recorder = NULL;
+    rte_smp_mb();
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, RTE_RING_RECORD_MAGIC, sizeof(hdr.magic));
+  hdr.version = RTE_RING_RECORD_VERSION;
+  hdr.capacity = rec->r != NULL ? rec->r->capacity : 0;
+  hdr.flags = rec->r != NULL ? rec->r->flags : 0;
+  hdr.tsc_hz = rte_get_tsc_hz();
+  hdr.cycles = rte_rdtsc() - rec->start;
+  rec->r = NULL;
+
+  /* let the calls that claimed a slot before the detach fill it */
+  for (s = 0; s < 2; s++) {
+    claimed = rec->sides[s].claimed;
+    hdr.nb_events[s] = claimed < rec->max_events ? claimed : rec->max_events;
+    hdr.lost[s] = claimed - hdr.nb_events[s];
+    for (i = 0; i < hdr.nb_events[s]; i++)
+      while (rec->sides[s].slots[i].tsc == 0)
+        rte_pause();
+  }
+
+  f = fopen(path, "wb");
+  if (f == NULL) {
+    err = errno;
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot create recording file %s: %s",
+        MYF(0),
+        path, strerror(err));
+    return -err;
+  }
+  fwrite(&hdr, sizeof(hdr), 1, f);
+  record_write_side(rec, &rec->sides[1], hdr.nb_events[1], f);
+  record_write_side(rec, &rec->sides[0], hdr.nb_events[0], f);
+  if (fclose(f) != 0) {
+    err = errno;
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot write recording file %s: %s",
+        MYF(0),
+        path, strerror(err));
+    return -err;
+  }
+  return 0;
+}
+
+void rte_ring_record_free(struct rte_ring_recorder *rec)
+{
+  if (rec == NULL)
+    return;
+
+  if (rec->r != NULL && rec->r->recorder == rec)
+    rec->r->recorder = NULL;
+  my_free(rec->sides[0].slots);
+  my_free(rec->sides[1].slots);
+  my_free(rec);
+}
+
+int rte_ring_record_load(const char *path, struct rte_ring_recording *rec)
+{
+  static const unsigned int sides[2] = { 1, 0 };   /* file order */
+  unsigned int i, s;
+  FILE *f;
+  int err;
+
+  memset(rec, 0, sizeof(*rec));
+  f = fopen(path, "rb");
+  if (f == NULL) {
+    err = errno;
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot open recording file %s: %s",
+        MYF(0),
+        path, strerror(err));
+    return -err;
+  }
+  if (fread(&rec->hdr, sizeof(rec->hdr), 1, f) != 1 ||
+      memcmp(rec->hdr.magic, RTE_RING_RECORD_MAGIC,
+        sizeof(rec->hdr.magic)) != 0 ||
+      rec->hdr.version != RTE_RING_RECORD_VERSION) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "%s is not a ring recording of version %u",
+        MYF(0),
+        path, (unsigned)RTE_RING_RECORD_VERSION);
+    fclose(f);
+    return -EINVAL;
+  }
+
+  for (i = 0; i < 2; i++) {
+    s = sides[i];
+    rec->events[s] = (struct rte_ring_record_event *)my_malloc(
+        (rec->hdr.nb_events[s] + 1) * sizeof(struct rte_ring_record_event),
+        MYF(0));
+    if (rec->events[s] == NULL) {
+      my_printf_error(ER_UNKNOWN_ERROR,
+          "Cannot reserve memory",
+          MYF(0));
+      fclose(f);
+      rte_ring_record_unload(rec);
+      return -ENOMEM;
+    }
+    if (fread(rec->events[s], sizeof(struct rte_ring_record_event),
+          rec->hdr.nb_events[s], f) != rec->hdr.nb_events[s]) {
+      my_printf_error(ER_UNKNOWN_ERROR,
+          "Truncated recording file %s",
+          MYF(0),
+          path);
+      fclose(f);
+      rte_ring_record_unload(rec);
+      return -EINVAL;
+    }
+  }
+  fclose(f);
+  return 0;
+}
+
+void rte_ring_record_unload(struct rte_ring_recording *rec)
+{
+  my_free(rec->events[0]);
+  my_free(rec->events[1]);
+  rec->events[0] = rec->events[1] = NULL;
+}
@@ -0,0 +1,145 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _RTE_RING_RECORD_H_
+#define _RTE_RING_RECORD_H_
+
+/**
+ * @file
+ * RTE Ring traffic recorder
+ *
+ * Records the shape of the traffic through a ring, to replay it later in
+ * benchmarks (ring_perf -R): for each enqueue, and each dequeue that got
+ * objects, the TSC, the number of objects asked for and the number moved.
+ * Dequeues of an empty ring are not recorded, so that polling consumers do
+ * not fill the recording.
+ *
+ * Only the enqueue and dequeue paths built with RTE_RING_RECORD defined
+ * record anything, but all of them do: the bulk, burst and single object
+ * functions, and the prefetching, apply, classify, scatter-gather, handle
+ * and zero-copy ones. A zero-copy enqueue is recorded when it is committed,
+ * and a transfer as a dequeue of its source, then an enqueue of its
+ * destination. Without it, the hook expands to nothing. When built with it, a ring without a recorder
+ * pays one test of a pointer of its header cache line.
+ *
+ * Events are kept in memory, one slot per event claimed with an atomic
+ * add, until rte_ring_record_stop() writes them to a file: a struct
+ * rte_ring_record_header, then the enqueue events, then the dequeue events,
+ * each a struct rte_ring_record_event holding the TSC cycles elapsed since
+ * the previous event of its side. Events past the size of the recording
+ * are counted as lost.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <rte_common.h>
+
+struct rte_ring;
+struct rte_ring_recorder;
+
+#define RTE_RING_RECORD_MAGIC "RTERINGR"  /**< First bytes of a recording. */
+#define RTE_RING_RECORD_VERSION 1         /**< Version of the file format. */
+
+/** Header of a recording file. Arrays are indexed by side: 1 enqueue. */
+struct rte_ring_record_header {
+  char magic[8];           /**< RTE_RING_RECORD_MAGIC, not terminated. */
+  uint32_t version;        /**< RTE_RING_RECORD_VERSION. */
+  uint32_t capacity;       /**< Capacity of the recorded ring. */
+  uint32_t flags;          /**< Flags of the recorded ring. */
+  uint32_t reserved;
+  uint64_t tsc_hz;         /**< TSC frequency of the recording host. */
+  uint64_t cycles;         /**< Duration of the recording. */
+  uint64_t nb_events[2];   /**< Events of each side in the file. */
+  uint64_t lost[2];        /**< Events of each side that did not fit. */
+};
+
+/** An enqueue or dequeue call, as stored in a recording file. */
+struct rte_ring_record_event {
+  uint32_t delta;          /**< TSC cycles since the previous event of the
+                                side, or the start; saturated. */
+  uint16_t n;              /**< Objects asked for, saturated. */
+  uint16_t done;           /**< Objects moved, saturated. */
+};
+
+/** A recording loaded in memory. */
+struct rte_ring_recording {
+  struct rte_ring_record_header hdr;   /**< The file header. */
+  struct rte_ring_record_event *events[2]; /**< Events of each side. */
+};
+
+/** @internal Record an enqueue or a dequeue call. */
+void __rte_ring_record(struct rte_ring_recorder *rec, unsigned int enqueue,
+    unsigned int n, unsigned int done);
+
+#ifdef RTE_RING_RECORD
+/* the recorder is loaded once, as rte_ring_record_stop() may detach it */
+#define __RTE_RING_RECORD(r, enqueue, n, done) do {                 \
+    struct rte_ring_recorder *__rec =                               \
+      __atomic_load_n(&(r)->recorder, __ATOMIC_ACQUIRE);            \
+    if (unlikely(__rec != NULL))                                    \
+      __rte_ring_record(__rec, enqueue, n, done);                   \
+  } while (0)
+#else
+#define __RTE_RING_RECORD(r, enqueue, n, done) do { } while (0)
+#endif
+
+/**
+ * Start recording the traffic of a ring.
+ *
+ * @param r
+ *   The ring to record, without a recorder attached.
+ * @param max_events
+ *   Number of events kept per side.
+ * @return
+ *   The recorder attached to the ring, or NULL on error.
+ */
+struct rte_ring_recorder *rte_ring_record_start(struct rte_ring *r,
+    unsigned int max_events);
+
+/**
+ * Detach a recorder from its ring and write what it recorded to a file.
+ *
+ * Threads still inside an enqueue or dequeue of the ring may record a last
+ * event after the call: it is not written, but the recorder memory must
+ * stay valid until they are out, so it is only freed by
+ * rte_ring_record_free().
+ *
+ * @param rec
+ *   The recorder.
+ * @param path
+ *   File to create.
+ * @return
+ *   0 on success, a negative value on error.
+ */
+int rte_ring_record_stop(struct rte_ring_recorder *rec, const char *path);
+
+/**
+ * Free a stopped recorder, once no thread can be using its former ring.
+ *
+ * @param rec
+ *   The recorder.
+ */
+void rte_ring_record_free(struct rte_ring_recorder *rec);
+
+/**
+ * Load a recording file.
+ *
+ * @param path
+ *   The file.
+ * @param rec
+ *   Filled with the recording, to free with rte_ring_record_unload().
+ * @return
+ *   0 on success, a negative value on error.
+ */
+int rte_ring_record_load(const char *path, struct rte_ring_recording *rec);
+
+/**
+ * Free the events of a loaded recording.
+ *
+ * @param rec
+ *   The recording.
+ */
+void rte_ring_record_unload(struct rte_ring_recording *rec);
+
+#endif /* _RTE_RING_RECORD_H_ */
@@ -0,0 +1,261 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <my_global.h>
+#include <my_sys.h>
+#include <mysqld_error.h>
+
+#include "rte_ring_sampler.h"
+
+#define SAMPLER_READ_TRIES 16 /* reads of a ring before skipping a sample */
+
+/* a registered ring */
+struct sampler_ring {
+  const struct rte_ring *r;
+  char name[RTE_RING_SAMPLER_NAMESIZE];
+  struct rte_ring_sampler_stats stats;
+};
+
+struct rte_ring_sampler {
+  pthread_mutex_t lock;    /* protects the rings against the thread */
+  pthread_t thread;
+  volatile int running;
+  unsigned interval_us;
+  unsigned nb_rings;
+  struct sampler_ring rings[RTE_RING_SAMPLER_MAX_RINGS];
+};
+
+struct rte_ring_sampler *rte_ring_sampler_create(unsigned interval_us)
+{
+  struct rte_ring_sampler *s;
+
+  s = (struct rte_ring_sampler *)my_malloc(sizeof(*s), MYF(MY_ZEROFILL));
+  if (s == NULL) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot reserve memory",
+        MYF(0));
+    return NULL;
+  }
+  pthread_mutex_init(&s->lock, NULL);
+  s->interval_us = interval_us;
+  return s;
+}
+
+void rte_ring_sampler_free(struct rte_ring_sampler *s)
+{
+  if (s == NULL)
+    return;
+
+  rte_ring_sampler_stop(s);
+  pthread_mutex_destroy(&s->lock);
+  my_free(s);
+}
+
+/* find a registered ring, with the lock held */
+static struct sampler_ring *sampler_lookup(struct rte_ring_sampler *s,
+    const struct rte_ring *r)
+{
+  unsigned i;
+
+  for (i = 0; i < s->nb_rings; i++)
+    if (s->rings[i].r == r)
+      return &s->rings[i];
+  return NULL;
+}
+
+int rte_ring_sampler_register(struct rte_ring_sampler *s,
+    const struct rte_ring *r, const char *name)
+{
+  struct sampler_ring *sr;
+  int ret = 0;
+
+  pthread_mutex_lock(&s->lock);
+  if (sampler_lookup(s, r) != NULL) {
+    ret = -EEXIST;
+  } else if (s->nb_rings == RTE_RING_SAMPLER_MAX_RINGS) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot sample more than %u rings",
+        MYF(0),
+        (unsigned)RTE_RING_SAMPLER_MAX_RINGS);
+    ret = -ENOSPC;
+  } else {
+    sr = &s->rings[s->nb_rings++];
+    memset(sr, 0, sizeof(*sr));
+    sr->r = r;
+    snprintf(sr->name, sizeof(sr->name), "%s", name);
+    sr->stats.capacity = r->capacity;
+  }
+  pthread_mutex_unlock(&s->lock);
+  return ret;
+}
+
+int rte_ring_sampler_unregister(struct rte_ring_sampler *s,
+    const struct rte_ring *r)
+{
+  struct sampler_ring *sr;
+  int ret = 0;
+
+  pthread_mutex_lock(&s->lock);
+  sr = sampler_lookup(s, r);
+  if (sr == NULL)
+    ret = -ENOENT;
+  else
+    *sr = s->rings[--s->nb_rings];
+  pthread_mutex_unlock(&s->lock);
+  return ret;
+}
+
+void rte_ring_sampler_sample(struct rte_ring_sampler *s)
+{
+  struct rte_ring_sampler_stats *st;
+  const struct rte_ring *r;
+  uint32_t prod_tail, cons_tail, depth;
+  unsigned i, b, tries;
+
+  pthread_mutex_lock(&s->lock);
+  for (i = 0; i < s->nb_rings; i++) {
+    r = s->rings[i].r;
+    st = &s->rings[i].stats;
+
+    /* only read the tails, both published by their owners. cons.tail may
+     * move on, and the producers fill the room it frees, before prod.tail
+     * is read: the difference is then no depth the ring ever had, and can
+     * exceed the capacity. Read cons.tail again, and keep the pair only if
+     * it did not move, the depth the ring had when prod.tail was read. */
+    for (tries = 0; tries < SAMPLER_READ_TRIES; tries++) {
+      cons_tail = r->cons.tail;
+      rte_smp_rmb();
+      prod_tail = r->prod.tail;
+      rte_smp_rmb();
+      if (r->cons.tail == cons_tail)
+        break;
+    }
+    /* the ring moves too fast to be read: skip this sample */
+    if (tries == SAMPLER_READ_TRIES)
+      continue;
+    depth = prod_tail - cons_tail;
+
+    st->samples++;
+    st->depth_sum += depth;
+    if (depth == 0)
+      st->empty++;
+    else if (depth == st->capacity)
+      st->full++;
+    if (depth > st->peak)
+      st->peak = depth;
+    b = depth == 0 ? 0 : 32 - __builtin_clz(depth);
+    st->hist[b]++;
+  }
+  pthread_mutex_unlock(&s->lock);
+}
+
+static void *sampler_thread_loop(void *arg)
+{
+  struct rte_ring_sampler *s = (struct rte_ring_sampler *)arg;
+  struct timespec ts;
+
+  ts.tv_sec = s->interval_us / 1000000;
+  ts.tv_nsec = (s->interval_us % 1000000) * 1000L;
+  while (s->running) {
+    rte_ring_sampler_sample(s);
+    nanosleep(&ts, NULL);
+  }
+  return NULL;
+}
+
+int rte_ring_sampler_start(struct rte_ring_sampler *s)
+{
+  if (s->running)
+    return -EBUSY;
+
+  s->running = 1;
+  if (pthread_create(&s->thread, NULL, sampler_thread_loop, s) != 0) {
+    s->running = 0;
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot create sampler thread",
+        MYF(0));
+    return -EAGAIN;
+  }
+  return 0;
+}
+
+void rte_ring_sampler_stop(struct rte_ring_sampler *s)
+{
+  if (!s->running)
+    return;
+
+  s->running = 0;
+  pthread_join(s->thread, NULL);
+}
+
+int rte_ring_sampler_get_stats(struct rte_ring_sampler *s,
+    const struct rte_ring *r, struct rte_ring_sampler_stats *stats)
+{
+  struct sampler_ring *sr;
+  int ret = 0;
+
+  pthread_mutex_lock(&s->lock);
+  sr = sampler_lookup(s, r);
+  if (sr == NULL)
+    ret = -ENOENT;
+  else
+    *stats = sr->stats;
+  pthread_mutex_unlock(&s->lock);
+  return ret;
+}
+
+unsigned rte_ring_sampler_recommend(const struct rte_ring *r,
+    const struct rte_ring_sampler_stats *stats)
+{
+  uint32_t peak = stats->peak ? stats->peak : 1;
+
+  if (stats->full != 0)
+    return 0;
+
+  /* same rules as rte_ring_init(): exact size, or a power of 2 minus one */
+  if (r->flags & RING_F_EXACT_SZ)
+    return peak;
+  return rte_align32pow2(peak + 1);
+}
+
+void rte_ring_sampler_dump(struct rte_ring_sampler *s, FILE *f)
+{
+  const struct rte_ring_sampler_stats *st;
+  const struct sampler_ring *sr;
+  unsigned i, b, count;
+
+  pthread_mutex_lock(&s->lock);
+  for (i = 0; i < s->nb_rings; i++) {
+    sr = &s->rings[i];
+    st = &sr->stats;
+    fprintf(f, "ring %s <%p>: capacity %u, %" PRIu64 " samples\n", sr->name,
+        (const void *)sr->r, st->capacity, st->samples);
+    if (st->samples == 0)
+      continue;
+    fprintf(f, "  depth mean %.1f, peak %u, full %.2f%%, empty %.2f%%\n",
+        (double)st->depth_sum / st->samples, st->peak,
+        100.0 * st->full / st->samples, 100.0 * st->empty / st->samples);
+    fprintf(f, "  histogram:");
+    for (b = 0; b < RTE_RING_SAMPLER_HIST; b++)
+      if (st->hist[b])
+        fprintf(f, " [%u,%u]: %.2f%%", b ? 1u << (b - 1) : 0,
+            b ? (uint32_t)((1ULL << b) - 1) : 0,
+            100.0 * st->hist[b] / st->samples);
+    fprintf(f, "\n");
+    count = rte_ring_sampler_recommend(sr->r, st);
+    if (count == 0)
+      fprintf(f, "  saturated: seen full, the needed capacity is unknown\n");
+    else
+      fprintf(f, "  recommended count %u for a sampled peak of %u\n", count,
+          st->peak);
+  }
+  pthread_mutex_unlock(&s->lock);
+}
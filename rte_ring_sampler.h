@@ -0,0 +1,169 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _RTE_RING_SAMPLER_H_
+#define _RTE_RING_SAMPLER_H_
+
+/**
+ * @file
+ * RTE Ring occupancy sampler
+ *
+ * A background thread that periodically samples the depth of registered
+ * rings, to size them from data rather than guesses. Each sample only reads
+ * prod.tail and cons.tail: the sampler never writes to a ring cache line,
+ * though its reads still make the owners of those lines share them once per
+ * interval, so the interval should stay well above the enqueue rate.
+ *
+ * For each ring it keeps a log2 histogram of the depth, the fractions of
+ * samples where the ring was full or empty, the mean and the peak depth.
+ * rte_ring_sampler_dump() turns them into a recommended ring size: the
+ * smallest count given to rte_ring_create() with the same flags whose
+ * capacity holds the peak depth. A ring seen full may have dropped objects
+ * and its real peak is unknown, so it is reported as saturated instead.
+ * Peaks shorter than the interval are missed: the recommendation is a lower
+ * bound.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <rte_common.h>
+#include "rte_ring.h"
+
+#define RTE_RING_SAMPLER_MAX_RINGS 64 /**< Rings per sampler. */
+#define RTE_RING_SAMPLER_NAMESIZE 32  /**< Length of a ring name. */
+#define RTE_RING_SAMPLER_HIST 33      /**< Depth buckets: 0, then log2. */
+
+/** Occupancy of a ring, as sampled so far. */
+struct rte_ring_sampler_stats {
+  uint64_t samples;        /**< Number of samples. */
+  uint64_t full;           /**< Samples where the ring was full. */
+  uint64_t empty;          /**< Samples where the ring was empty. */
+  uint64_t depth_sum;      /**< Sum of the sampled depths. */
+  uint32_t peak;           /**< Largest sampled depth. */
+  uint32_t capacity;       /**< Capacity of the ring. */
+  /** Samples per depth: bucket 0 is empty, bucket b in [2^(b-1), 2^b). */
+  uint64_t hist[RTE_RING_SAMPLER_HIST];
+};
+
+struct rte_ring_sampler;
+
+/**
+ * Create a sampler. It samples nothing until rings are registered and
+ * rte_ring_sampler_start() is called, or rte_ring_sampler_sample() is.
+ *
+ * @param interval_us
+ *   Time between two samples of the background thread, in microseconds.
+ * @return
+ *   The sampler, or NULL on error.
+ */
+struct rte_ring_sampler *rte_ring_sampler_create(unsigned interval_us);
+
+/**
+ * Stop the sampler if it is running, and free it.
+ *
+ * @param s
+ *   Sampler to free.
+ */
+void rte_ring_sampler_free(struct rte_ring_sampler *s);
+
+/**
+ * Start sampling the registered rings, and the rings registered later, in a
+ * background thread.
+ *
+ * @param s
+ *   A pointer to the sampler.
+ * @return
+ *   0 on success, a negative value on error.
+ */
+int rte_ring_sampler_start(struct rte_ring_sampler *s);
+
+/**
+ * Stop the background thread. The statistics are kept.
+ *
+ * @param s
+ *   A pointer to the sampler.
+ */
+void rte_ring_sampler_stop(struct rte_ring_sampler *s);
+
+/**
+ * Register a ring. It must stay valid until it is unregistered or the
+ * sampler is freed.
+ *
+ * @param s
+ *   A pointer to the sampler.
+ * @param r
+ *   The ring to sample.
+ * @param name
+ *   Name of the ring in the reports, truncated to RTE_RING_SAMPLER_NAMESIZE.
+ * @return
+ *   0 on success, -ENOSPC if the sampler is full, -EEXIST if the ring is
+ *   already registered.
+ */
+int rte_ring_sampler_register(struct rte_ring_sampler *s,
+    const struct rte_ring *r, const char *name);
+
+/**
+ * Unregister a ring and drop its statistics.
+ *
+ * @param s
+ *   A pointer to the sampler.
+ * @param r
+ *   A registered ring.
+ * @return
+ *   0 on success, -ENOENT if the ring is not registered.
+ */
+int rte_ring_sampler_unregister(struct rte_ring_sampler *s,
+    const struct rte_ring *r);
+
+/**
+ * Take one sample of every registered ring from the calling thread, as the
+ * background thread does every interval. The consumer tail is read again
+ * after the producer tail, and both again while it moves; a ring still
+ * moving after a few reads is not sampled this time.
+ *
+ * @param s
+ *   A pointer to the sampler.
+ */
+void rte_ring_sampler_sample(struct rte_ring_sampler *s);
+
+/**
+ * Get the statistics of a ring.
+ *
+ * @param s
+ *   A pointer to the sampler.
+ * @param r
+ *   A registered ring.
+ * @param stats
+ *   Filled with a copy of the statistics.
+ * @return
+ *   0 on success, -ENOENT if the ring is not registered.
+ */
+int rte_ring_sampler_get_stats(struct rte_ring_sampler *s,
+    const struct rte_ring *r, struct rte_ring_sampler_stats *stats);
+
+/**
+ * Return the smallest count to give to rte_ring_create(), with the flags of
+ * the given ring, for a ring able to hold the sampled peak depth.
+ *
+ * @param r
+ *   The sampled ring.
+ * @param stats
+ *   Its statistics.
+ * @return
+ *   The count, or 0 if the ring was seen full: it may have needed more.
+ */
+unsigned rte_ring_sampler_recommend(const struct rte_ring *r,
+    const struct rte_ring_sampler_stats *stats);
+
+/**
+ * Write the statistics of every registered ring with a recommended size.
+ *
+ * @param s
+ *   A pointer to the sampler.
+ * @param f
+ *   A pointer to a file for output.
+ */
+void rte_ring_sampler_dump(struct rte_ring_sampler *s, FILE *f);
+
+#endif /* _RTE_RING_SAMPLER_H_ */
@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <my_global.h>
+#include <my_sys.h>
+#include <mysqld_error.h>
+
+#include "rte_ring_token.h"
+
+/* create the pool and fill its ring with all the tokens */
+struct rte_ring_token_pool *rte_ring_token_pool_create(unsigned count,
+    unsigned flags)
+{
+  const struct rte_ring_alloc_ops *ops = &RTE_RING_DEFAULT_ALLOC_OPS;
+  struct rte_ring_token_pool *pool;
+  size_t size;
+  unsigned i;
+
+  size = sizeof(*pool) + (size_t)count * sizeof(struct rte_ring_token);
+  pool = (struct rte_ring_token_pool *)ops->alloc(size, RTE_CACHE_LINE_SIZE,
+      ops->ctx);
+  if (pool == NULL) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot reserve memory",
+        MYF(0));
+    return NULL;
+  }
+
+  pool->free = rte_ring_create(count, flags | RING_F_EXACT_SZ);
+  if (pool->free == NULL) {
+    ops->free(pool, size, ops->ctx);
+    return NULL;
+  }
+  pool->count = count;
+  pool->alloc = *ops;
+  pool->memsize = size;
+
+  for (i = 0; i < count; i++) {
+    pool->tokens[i].state = RTE_RING_TOKEN_DONE;
+    rte_ring_enqueue(pool->free, &pool->tokens[i]);
+  }
+
+  return pool;
+}
+
+void rte_ring_token_pool_free(struct rte_ring_token_pool *pool)
+{
+  if (pool == NULL)
+    return;
+
+  rte_ring_free(pool->free);
+  pool->alloc.free(pool, pool->memsize, pool->alloc.ctx);
+}
+
+static long futex(volatile uint32_t *uaddr, int op, uint32_t val)
+{
+  return syscall(SYS_futex, uaddr, op, val, NULL, NULL, 0);
+}
+
+void __rte_ring_token_sleep(struct rte_ring_token *tok)
+{
+  uint32_t expected = RTE_RING_TOKEN_PENDING;
+
+  /* announce the sleep, unless the token completed meanwhile */
+  if (!__atomic_compare_exchange_n(&tok->state, &expected,
+        RTE_RING_TOKEN_WAITING, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE) &&
+      expected == RTE_RING_TOKEN_DONE)
+    return;
+
+  while (__atomic_load_n(&tok->state, __ATOMIC_ACQUIRE) ==
+      RTE_RING_TOKEN_WAITING)
+    futex(&tok->state, FUTEX_WAIT_PRIVATE, RTE_RING_TOKEN_WAITING);
+}
+
+void __rte_ring_token_wake(struct rte_ring_token *tok)
+{
+  futex(&tok->state, FUTEX_WAKE_PRIVATE, INT_MAX);
+}
@@ -0,0 +1,231 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _RTE_RING_TOKEN_H_
+#define _RTE_RING_TOKEN_H_
+
+/**
+ * @file
+ * RTE Ring completion tokens
+ *
+ * A lightweight request/response layer over rte_ring. A producer takes a
+ * completion token from a pool, attaches its request to it and enqueues the
+ * token. The consumer dequeues tokens like any other object, serves the
+ * request and completes the token by storing a result and flipping its
+ * state. The producer polls, spins or sleeps on a futex until the token is
+ * complete, reads the result and returns the token to the pool. The pool
+ * keeps its free tokens in a ring, so getting and recycling tokens is
+ * lockless.
+ */
+
+#include <stdint.h>
+#include <errno.h>
+
+#include <rte_common.h>
+#include "rte_ring.h"
+
+#define RTE_RING_TOKEN_PENDING 0 /**< Not completed, nobody sleeping on it. */
+#define RTE_RING_TOKEN_WAITING 1 /**< Not completed, the owner is sleeping. */
+#define RTE_RING_TOKEN_DONE    2 /**< Completed, result available. */
+
+/**
+ * A completion token. Each token has its own cache line so that completing
+ * one does not disturb the owners of the others.
+ */
+struct rte_ring_token {
+  volatile uint32_t state; /**< One of the RTE_RING_TOKEN_* states. */
+  uint64_t result;         /**< Result stored by the completer. */
+  void *request;           /**< Request carried to the consumer. */
+} __rte_cache_aligned;
+
+/** A pool of completion tokens. */
+struct rte_ring_token_pool {
+  struct rte_ring *free;   /**< Ring of the free tokens. */
+  unsigned int count;      /**< Number of tokens in the pool. */
+  struct rte_ring_alloc_ops alloc; /**< Allocator owning the pool memory. */
+  size_t memsize;          /**< Bytes obtained from the allocator. */
+  struct rte_ring_token tokens[] __rte_cache_aligned; /**< The tokens. */
+};
+
+/**
+ * Create a pool of completion tokens.
+ *
+ * @param count
+ *   The number of tokens.
+ * @param flags
+ *   Flags of the ring holding the free tokens: RING_F_SP_ENQ if only one
+ *   thread returns tokens, RING_F_SC_DEQ if only one thread takes them.
+ * @return
+ *   The new pool, NULL on error.
+ */
+struct rte_ring_token_pool *rte_ring_token_pool_create(unsigned count,
+    unsigned flags);
+
+/**
+ * Free a pool of completion tokens. All tokens must have been returned.
+ *
+ * @param pool
+ *   The pool to free.
+ */
+void rte_ring_token_pool_free(struct rte_ring_token_pool *pool);
+
+/**
+ * @internal Sleep until a token is completed. Called by rte_ring_token_wait()
+ * once spinning has not been enough.
+ */
+void __rte_ring_token_sleep(struct rte_ring_token *tok);
+
+/**
+ * @internal Wake the owner sleeping on a token.
+ */
+void __rte_ring_token_wake(struct rte_ring_token *tok);
+
+/**
+ * Take a token from the pool.
+ *
+ * @param pool
+ *   The pool.
+ * @return
+ *   A pending token, NULL if the pool is exhausted.
+ */
+  static inline struct rte_ring_token *
+rte_ring_token_get(struct rte_ring_token_pool *pool)
+{
+  void *tok;
+
+  if (rte_ring_dequeue(pool->free, &tok) != 0)
+    return NULL;
+
+  ((struct rte_ring_token *)tok)->state = RTE_RING_TOKEN_PENDING;
+  return (struct rte_ring_token *)tok;
+}
+
+/**
+ * Return a token to its pool.
+ *
+ * @param pool
+ *   The pool the token was taken from.
+ * @param tok
+ *   The token. It must not be used after this call.
+ */
+  static inline void
+rte_ring_token_put(struct rte_ring_token_pool *pool,
+    struct rte_ring_token *tok)
+{
+  rte_ring_enqueue(pool->free, tok);
+}
+
+/**
+ * Enqueue a request on a ring and return its completion token.
+ *
+ * @param r
+ *   The ring the consumer serves.
+ * @param pool
+ *   The pool to take the token from.
+ * @param request
+ *   The request, given back to the consumer by rte_ring_token_request().
+ * @return
+ *   The token to wait on, NULL if the pool is exhausted or the ring is full.
+ */
+  static inline struct rte_ring_token *
+rte_ring_request_enqueue(struct rte_ring *r, struct rte_ring_token_pool *pool,
+    void *request)
+{
+  struct rte_ring_token *tok = rte_ring_token_get(pool);
+
+  if (tok == NULL)
+    return NULL;
+
+  tok->request = request;
+  if (rte_ring_enqueue(r, tok) != 0) {
+    rte_ring_token_put(pool, tok);
+    return NULL;
+  }
+  return tok;
+}
+
+/**
+ * Return the request attached to a dequeued token.
+ *
+ * @param tok
+ *   A token dequeued from the request ring.
+ * @return
+ *   The request.
+ */
+  static inline void *
+rte_ring_token_request(const struct rte_ring_token *tok)
+{
+  return tok->request;
+}
+
+/**
+ * Complete a token.
+ *
+ * The result is published before the state flips, and the owner is woken up
+ * if it sleeps on the token. The completer must not touch the token after
+ * this call.
+ *
+ * @param tok
+ *   A token dequeued from the request ring.
+ * @param result
+ *   The result handed to the owner.
+ */
+  static inline void
+rte_ring_token_complete(struct rte_ring_token *tok, uint64_t result)
+{
+  tok->result = result;
+  if (__atomic_exchange_n(&tok->state, RTE_RING_TOKEN_DONE,
+        __ATOMIC_RELEASE) == RTE_RING_TOKEN_WAITING)
+    __rte_ring_token_wake(tok);
+}
+
+/**
+ * Check whether a token is complete.
+ *
+ * @param tok
+ *   The token returned by rte_ring_request_enqueue().
+ * @param result
+ *   If the token is complete, returns its result.
+ * @return
+ *   - 0: The token is complete.
+ *   - -EAGAIN: The token is still pending.
+ */
+  static inline int
+rte_ring_token_poll(const struct rte_ring_token *tok, uint64_t *result)
+{
+  if (__atomic_load_n(&tok->state, __ATOMIC_ACQUIRE) != RTE_RING_TOKEN_DONE)
+    return -EAGAIN;
+
+  *result = tok->result;
+  return 0;
+}
+
+/**
+ * Wait until a token is complete.
+ *
+ * @param tok
+ *   The token returned by rte_ring_request_enqueue().
+ * @param spins
+ *   Number of polls, separated by rte_pause(), before sleeping on a futex.
+ *   Use 0 to sleep right away, or UINT_MAX to spin only.
+ * @return
+ *   The result of the token.
+ */
+  static inline uint64_t
+rte_ring_token_wait(struct rte_ring_token *tok, unsigned int spins)
+{
+  uint64_t result;
+
+  while (rte_ring_token_poll(tok, &result) != 0) {
+    if (spins == 0) {
+      __rte_ring_token_sleep(tok);
+      continue;
+    }
+    if (spins != UINT_MAX)
+      spins--;
+    rte_pause();
+  }
+  return result;
+}
+
+#endif /* _RTE_RING_TOKEN_H_ */
@@ -0,0 +1,245 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include <my_global.h>
+#include <my_sys.h>
+#include <mysqld_error.h>
+
+#include "rte_trace.h"
+
+/* a named event */
+struct trace_name {
+  uint32_t id;
+  char name[RTE_TRACE_NAMESIZE];
+};
+
+volatile int __rte_trace_enabled;
+__thread struct rte_trace_buf *__rte_trace_self;
+
+/* all the trace rings, pushed locklessly and never removed */
+static struct rte_trace_buf *volatile trace_bufs;
+static unsigned trace_records = RTE_TRACE_DEFAULT_RECORDS;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_name trace_names[RTE_TRACE_MAX_NAMES];
+static unsigned trace_nb_names;
+static unsigned trace_names_written;
+
+static pthread_t trace_thread;
+static volatile int trace_running;
+static unsigned trace_interval_us;
+static FILE *trace_file;
+static struct rte_trace_record *trace_scratch;
+static unsigned trace_scratch_size;
+
+struct rte_trace_buf *__rte_trace_attach(void)
+{
+  const unsigned count = trace_records;
+  struct rte_trace_buf *b;
+  void *raw;
+
+  if (posix_memalign(&raw, RTE_CACHE_LINE_SIZE,
+        sizeof(*b) + count * sizeof(struct rte_trace_record)) != 0)
+    return NULL;
+  b = (struct rte_trace_buf *)raw;
+  memset(b, 0, sizeof(*b));
+  b->mask = count - 1;
+  b->tid = (uint32_t)syscall(SYS_gettid);
+  b->prod.single = b->cons.single = 1;
+  do {
+    b->next = trace_bufs;
+  } while (!__sync_bool_compare_and_swap(&trace_bufs, b->next, b));
+  __rte_trace_self = b;
+  return b;
+}
+
+int rte_trace_event_name(uint32_t id, const char *name)
+{
+  unsigned i;
+  int ret = 0;
+
+  pthread_mutex_lock(&trace_lock);
+  if (trace_nb_names == RTE_TRACE_MAX_NAMES) {
+    ret = -ENOSPC;
+  } else {
+    /* append, the collector writes the names it has not written yet */
+    i = trace_nb_names++;
+    trace_names[i].id = id;
+    snprintf(trace_names[i].name, sizeof(trace_names[i].name), "%s", name);
+  }
+  pthread_mutex_unlock(&trace_lock);
+  return ret;
+}
+
+static void trace_write_names(void)
+{
+  struct rte_trace_chunk chunk;
+
+  pthread_mutex_lock(&trace_lock);
+  for (; trace_names_written < trace_nb_names; trace_names_written++) {
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.type = RTE_TRACE_CHUNK_NAME;
+    chunk.id = trace_names[trace_names_written].id;
+    fwrite(&chunk, sizeof(chunk), 1, trace_file);
+    fwrite(trace_names[trace_names_written].name, RTE_TRACE_NAMESIZE, 1,
+        trace_file);
+  }
+  pthread_mutex_unlock(&trace_lock);
+}
+
+/* write the new records of a trace ring as a chunk */
+static void trace_drain(struct rte_trace_buf *b)
+{
+  const uint32_t size = b->mask + 1;
+  struct rte_trace_chunk chunk;
+  uint32_t copied, start, tail, head, i;
+  uint32_t lost = 0;
+
+  tail = b->prod.tail;
+  rte_smp_rmb();
+  start = b->cons.tail;
+  if (tail - start > size) {
+    lost = tail - size - start;
+    start = tail - size;
+  }
+  if (tail == start)
+    return;
+
+  if (trace_scratch_size < size) {
+    my_free(trace_scratch);
+    trace_scratch = (struct rte_trace_record *)my_malloc(
+        size * sizeof(*trace_scratch), MYF(0));
+    if (trace_scratch == NULL) {
+      trace_scratch_size = 0;
+      return;
+    }
+    trace_scratch_size = size;
+  }
+  copied = start;
+  for (i = start; i != tail; i++)
+    trace_scratch[i - copied] = b->recs[i & b->mask];
+
+  /* drop the records the thread may have overwritten while we copied */
+  rte_smp_rmb();
+  head = b->prod.head;
+  if (head - start > size) {
+    lost += head - size - start;
+    start = head - size;
+    if (start - copied > tail - copied)    /* all of them */
+      start = tail;
+  }
+
+  memset(&chunk, 0, sizeof(chunk));
+  chunk.type = RTE_TRACE_CHUNK_RECORDS;
+  chunk.id = b->tid;
+  chunk.count = tail - start;
+  chunk.lost = lost;
+  fwrite(&chunk, sizeof(chunk), 1, trace_file);
+  fwrite(trace_scratch + (start - copied), sizeof(struct rte_trace_record),
+      chunk.count, trace_file);
+  b->cons.tail = tail;
+}
+
+static void trace_drain_all(void)
+{
+  struct rte_trace_buf *b;
+
+  trace_write_names();
+  for (b = trace_bufs; b != NULL; b = b->next)
+    trace_drain(b);
+  fflush(trace_file);
+}
+
+static void *trace_thread_loop(void *arg)
+{
+  struct timespec ts;
+
+  (void)arg;
+  ts.tv_sec = trace_interval_us / 1000000;
+  ts.tv_nsec = (trace_interval_us % 1000000) * 1000L;
+  while (trace_running) {
+    trace_drain_all();
+    nanosleep(&ts, NULL);
+  }
+  return NULL;
+}
+
+int rte_trace_start(const char *path, unsigned records, unsigned interval_us)
+{
+  struct rte_trace_file_header hdr;
+  struct rte_trace_buf *b;
+  int err;
+
+  if (!POWEROF2(records) || records == 0) {
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Trace ring size %u is not a power of 2",
+        MYF(0),
+        records);
+    return -EINVAL;
+  }
+  if (trace_running)
+    return -EBUSY;
+
+  trace_file = fopen(path, "wb");
+  if (trace_file == NULL) {
+    err = errno;
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot create trace file %s: %s",
+        MYF(0),
+        path, strerror(err));
+    return -err;
+  }
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, RTE_TRACE_MAGIC, sizeof(hdr.magic));
+  hdr.version = RTE_TRACE_VERSION;
+  hdr.record_size = sizeof(struct rte_trace_record);
+  hdr.tsc_hz = rte_get_tsc_hz();
+  fwrite(&hdr, sizeof(hdr), 1, trace_file);
+
+  /* skip what was recorded before a previous stop, write all the names */
+  for (b = trace_bufs; b != NULL; b = b->next)
+    b->cons.tail = b->prod.tail;
+  trace_names_written = 0;
+  trace_records = records;
+  trace_interval_us = interval_us;
+
+  trace_running = 1;
+  if (pthread_create(&trace_thread, NULL, trace_thread_loop, NULL) != 0) {
+    trace_running = 0;
+    fclose(trace_file);
+    trace_file = NULL;
+    my_printf_error(ER_UNKNOWN_ERROR,
+        "Cannot create trace collector thread",
+        MYF(0));
+    return -EAGAIN;
+  }
+  __rte_trace_enabled = 1;
+  return 0;
+}
+
+void rte_trace_stop(void)
+{
+  if (!trace_running)
+    return;
+
+  __rte_trace_enabled = 0;
+  trace_running = 0;
+  pthread_join(trace_thread, NULL);
+
+  trace_drain_all();
+  fclose(trace_file);
+  trace_file = NULL;
+  my_free(trace_scratch);
+  trace_scratch = NULL;
+  trace_scratch_size = 0;
+}
@@ -0,0 +1,171 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _RTE_TRACE_H_
+#define _RTE_TRACE_H_
+
+/**
+ * @file
+ * RTE binary event trace
+ *
+ * An in-process tracer for latency outliers. Each thread records events
+ * into its own trace ring: a single-producer single-consumer ring of
+ * fixed-size binary records (TSC, event id, three arguments) indexed by
+ * rte_ring head/tail pairs. The ring never blocks its thread: when the
+ * collector falls behind, the oldest records are overwritten and counted as
+ * lost. Recording an event is a TSC read and a few stores to memory owned
+ * by the thread, with no atomic operation.
+ *
+ * A collector thread started by rte_trace_start() drains the trace rings
+ * every interval into a binary file, decoded offline into a timeline by
+ * app/trace_decode.cc. The file starts with a struct rte_trace_file_header,
+ * followed by chunks, each a struct rte_trace_chunk then either records or
+ * an event name.
+ *
+ * Trace rings are allocated on the first event of each thread and kept
+ * until the process exits, so that threads never see them go away.
+ */
+
+#include <stdint.h>
+
+#include <rte_common.h>
+#include "rte_ring.h"
+
+#define RTE_TRACE_MAGIC "RTETRACE"  /**< First bytes of a trace file. */
+#define RTE_TRACE_VERSION 1         /**< Version of the trace file format. */
+#define RTE_TRACE_NAMESIZE 32       /**< Length of an event name. */
+#define RTE_TRACE_MAX_NAMES 256     /**< Named events. */
+#define RTE_TRACE_DEFAULT_RECORDS 8192 /**< Records per thread, default. */
+
+/** A trace record. */
+struct rte_trace_record {
+  uint64_t tsc;            /**< TSC when the event was recorded. */
+  uint32_t id;             /**< Event id. */
+  uint32_t arg0;           /**< Event arguments. */
+  uint64_t arg1;
+  uint64_t arg2;
+};
+
+/** Header of a trace file. */
+struct rte_trace_file_header {
+  char magic[8];           /**< RTE_TRACE_MAGIC, not terminated. */
+  uint32_t version;        /**< RTE_TRACE_VERSION. */
+  uint32_t record_size;    /**< sizeof(struct rte_trace_record). */
+  uint64_t tsc_hz;         /**< TSC frequency, to convert to time. */
+};
+
+/** Type of a trace file chunk. */
+enum rte_trace_chunk_type {
+  RTE_TRACE_CHUNK_RECORDS, /**< count records of thread tid follow. */
+  RTE_TRACE_CHUNK_NAME,    /**< The RTE_TRACE_NAMESIZE name of event id. */
+};
+
+/** Header of a trace file chunk. */
+struct rte_trace_chunk {
+  uint32_t type;           /**< One of enum rte_trace_chunk_type. */
+  uint32_t id;             /**< Thread id of records, event id of a name. */
+  uint32_t count;          /**< Number of records. */
+  uint32_t lost;           /**< Records of the thread overwritten since the
+                                previous chunk. */
+};
+
+/** @internal The trace ring of a thread. */
+struct rte_trace_buf {
+  struct rte_trace_buf *next;          /**< Next in the list of threads. */
+  uint32_t mask;                       /**< Records - 1. */
+  uint32_t tid;                        /**< Thread id. */
+  /** Written by the thread: head before, tail after each record. */
+  struct rte_ring_headtail prod __rte_cache_aligned;
+  /** Collector position. */
+  struct rte_ring_headtail cons __rte_cache_aligned;
+  struct rte_trace_record recs[] __rte_cache_aligned; /**< The records. */
+};
+
+/** @internal set while the tracer runs */
+extern volatile int __rte_trace_enabled;
+/** @internal trace ring of the calling thread */
+extern __thread struct rte_trace_buf *__rte_trace_self;
+
+/** @internal Allocate and register the trace ring of the calling thread. */
+struct rte_trace_buf *__rte_trace_attach(void);
+
+/**
+ * Record an event in the trace ring of the calling thread. Does nothing
+ * while the tracer is stopped.
+ *
+ * @param id
+ *   Event id, named with rte_trace_event_name().
+ * @param arg0
+ *   First argument.
+ * @param arg1
+ *   Second argument.
+ * @param arg2
+ *   Third argument.
+ */
+static __rte_always_inline void
+  rte_trace_emit(uint32_t id, uint32_t arg0, uint64_t arg1, uint64_t arg2)
+{
+  struct rte_trace_buf *b = __rte_trace_self;
+  struct rte_trace_record *rec;
+  uint32_t head;
+
+  if (unlikely(!__rte_trace_enabled))
+    return;
+  if (unlikely(b == NULL)) {
+    b = __rte_trace_attach();
+    if (b == NULL)
+      return;
+  }
+
+  /* move the head first, so the collector can tell a slot is being
+   * overwritten */
+  head = b->prod.head;
+  b->prod.head = head + 1;
+  rte_smp_wmb();
+
+  rec = &b->recs[head & b->mask];
+  rec->tsc = rte_rdtsc();
+  rec->id = id;
+  rec->arg0 = arg0;
+  rec->arg1 = arg1;
+  rec->arg2 = arg2;
+
+  rte_smp_wmb();
+  b->prod.tail = head + 1;
+}
+
+/**
+ * Name an event in the trace file. Names are written by the collector with
+ * its next chunks, the last name given to an id wins.
+ *
+ * @param id
+ *   Event id.
+ * @param name
+ *   Name, truncated to RTE_TRACE_NAMESIZE - 1 characters.
+ * @return
+ *   0 on success, -ENOSPC if RTE_TRACE_MAX_NAMES events are already named.
+ */
+int rte_trace_event_name(uint32_t id, const char *name);
+
+/**
+ * Start tracing into a file, with a collector thread.
+ *
+ * @param path
+ *   File to create.
+ * @param records
+ *   Size of the trace ring of each thread, a power of 2. Takes effect for
+ *   the threads recording their first event after the call.
+ * @param interval_us
+ *   Time between two drains of the trace rings by the collector.
+ * @return
+ *   0 on success, a negative value on error.
+ */
+int rte_trace_start(const char *path, unsigned records, unsigned interval_us);
+
+/**
+ * Stop tracing: stop the collector, drain the trace rings a last time and
+ * close the file.
+ */
+void rte_trace_stop(void);
+
+#endif /* _RTE_TRACE_H_ */